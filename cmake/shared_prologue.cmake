@@ -78,6 +78,15 @@ if(CMAKE_CXX_COMPILER_ID MATCHES "Clang|GNU")
 
 endif()
 
+if (${CLAP_WRAPPER_ENABLE_AUDIOTHREAD_CHECKS})
+    message(STATUS "clap-wrapper: enabling audio thread allocation and lock checks")
+    target_compile_definitions(clap-wrapper-compile-options INTERFACE CLAP_WRAPPER_AUDIOTHREAD_CHECKS=1)
+    if (UNIX AND NOT APPLE)
+        # calls inside the plugin module have to reach its own operator new, not the one from the host
+        target_link_options(clap-wrapper-compile-options INTERFACE -Wl,-Bsymbolic-functions)
+    endif()
+endif()
+
 if(CMAKE_CXX_COMPILER_ID MATCHES "MSVC")
     if (${CMAKE_CXX_STANDARD} GREATER_EQUAL 20)
         message(STATUS "clap-wrapper: Turning off char8_t c++20 changes")
@@ -138,6 +147,9 @@ function(guarantee_clap_wrapper_shared)
             src/clap_proxy.cpp
             src/detail/shared/sha1.h
             src/detail/shared/sha1.cpp
+            src/detail/shared/audiothread_guard.h
+            src/detail/shared/audiothread_guard.cpp
+            src/detail/shared/denormals.h
             src/detail/clap/fsutil.h
             src/detail/clap/fsutil.cpp
             src/detail/clap/automation.h
@@ -0,0 +1,41 @@
+# target_add_batch_renderer turns an executable target into clap-batch-render, a command line
+# tool which renders a batch of WAV files through a .clap with one plugin instance per worker
+# thread. The .clap is loaded at runtime, so the tool isn't tied to a single plugin.
+function(target_add_batch_renderer)
+    set(oneValueArgs
+            TARGET
+            OUTPUT_NAME
+            )
+    cmake_parse_arguments(BR "" "${oneValueArgs}" "" ${ARGN} )
+
+    if (NOT DEFINED BR_TARGET)
+        message(FATAL_ERROR "clap-wrapper: target_add_batch_renderer requires a target")
+    endif()
+
+    if (NOT TARGET ${BR_TARGET})
+        message(FATAL_ERROR "clap-wrapper: batch-renderer-target must be a target")
+    endif()
+
+    if (NOT DEFINED BR_OUTPUT_NAME)
+        set(BR_OUTPUT_NAME ${BR_TARGET})
+    endif()
+
+    find_package(Threads REQUIRED)
+
+    target_sources(${BR_TARGET} PRIVATE
+            ${CLAP_WRAPPER_CMAKE_CURRENT_SOURCE_DIR}/src/clapbatchrender.cpp
+            ${CLAP_WRAPPER_CMAKE_CURRENT_SOURCE_DIR}/src/detail/batchrender/batch_host.cpp
+            ${CLAP_WRAPPER_CMAKE_CURRENT_SOURCE_DIR}/src/detail/batchrender/batch_render.cpp
+            ${CLAP_WRAPPER_CMAKE_CURRENT_SOURCE_DIR}/src/detail/batchrender/wav_stream_writer.cpp
+            ${CLAP_WRAPPER_CMAKE_CURRENT_SOURCE_DIR}/src/detail/standalone/wavfile.cpp
+            )
+
+    target_link_libraries(${BR_TARGET} PRIVATE
+            clap-wrapper-compile-options
+            clap-wrapper-shared-detail
+            Threads::Threads
+            ${CMAKE_DL_LIBS}
+            )
+
+    set_target_properties(${BR_TARGET} PROPERTIES OUTPUT_NAME ${BR_OUTPUT_NAME})
+endfunction(target_add_batch_renderer)
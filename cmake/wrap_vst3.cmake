@@ -10,7 +10,11 @@ function(private_add_vst3_wrapper_sources)
     elseif (APPLE)
         target_sources(${tg} PRIVATE ${sd}/src/detail/os/macos.mm)
     elseif(UNIX)
-        target_sources(${tg} PRIVATE ${sd}/src/detail/os/linux.cpp)
+        target_sources(${tg} PRIVATE
+                ${sd}/src/detail/os/linux.cpp
+                ${sd}/src/detail/vst3/runloop_dispatcher.h
+                ${sd}/src/detail/vst3/runloop_dispatcher.cpp
+                )
     endif()
 
     target_sources(${tg} PRIVATE
@@ -27,12 +31,72 @@ function(private_add_vst3_wrapper_sources)
             ${sd}/src/detail/vst3/process.cpp
             ${sd}/src/detail/vst3/categories.h
             ${sd}/src/detail/vst3/categories.cpp
+            ${sd}/src/detail/vst3/classinfo.h
+            ${sd}/src/detail/vst3/classinfo.cpp
             ${sd}/src/detail/vst3/aravst3.h
             )
 
     target_include_directories(${V3_TARGET}-clap-wrapper-vst3-lib PRIVATE "${sd}/include")
 endfunction(private_add_vst3_wrapper_sources)
 
+# A host which finds Contents/Resources/moduleinfo.json in a bundle lists the classes from it
+# without loading the binary. The classes of the wrapper are those of the CLAP, so with the CLAP
+# target at hand a helper loads it after the build and writes the file into the bundle.
+function(private_add_vst3_moduleinfo)
+    set(oneValueArgs TARGET OUTPUT_NAME BUNDLE_VERSION SINGLE_PLUGIN_TUID WINDOWS_FOLDER_VST3 CLAP_TARGET_FOR_CONFIG)
+    cmake_parse_arguments(MI "" "${oneValueArgs}" "" ${ARGN})
+
+    if (WIN32 AND NOT ${MI_WINDOWS_FOLDER_VST3})
+        message(STATUS "clap-wrapper: a single file VST3 has no bundle to hold a moduleinfo.json")
+        return()
+    endif()
+    if (CMAKE_CROSSCOMPILING)
+        message(STATUS "clap-wrapper: no VST3 moduleinfo.json when cross compiling, the CLAP can't be loaded")
+        return()
+    endif()
+
+    set(bhtg clap-wrapper-vst3-build-helper)
+    if (NOT TARGET ${bhtg})
+        set(sd ${CLAP_WRAPPER_CMAKE_CURRENT_SOURCE_DIR})
+        add_executable(${bhtg}
+                ${sd}/src/detail/vst3/build-helper/build-helper.cpp
+                ${sd}/src/detail/vst3/classinfo.cpp
+                ${sd}/src/detail/vst3/categories.cpp
+                )
+        target_link_libraries(${bhtg} PRIVATE clap-wrapper-shared-detail base-sdk-vst3)
+        if (APPLE)
+            target_link_libraries(${bhtg} PRIVATE
+                    macos_filesystem_support
+                    "-framework Foundation"
+                    "-framework CoreFoundation"
+                    )
+        elseif (UNIX)
+            target_link_libraries(${bhtg} PRIVATE "-ldl")
+        endif()
+    endif()
+
+    set(clpt ${MI_CLAP_TARGET_FOR_CONFIG})
+    message(STATUS "clap-wrapper: generating VST3 moduleinfo.json for ${MI_TARGET} from target ${clpt}")
+    if (APPLE)
+        set(clapfile "$<TARGET_BUNDLE_DIR:${clpt}>")
+    else()
+        set(clapfile "$<TARGET_FILE:${clpt}>")
+    endif()
+    set(version "${MI_BUNDLE_VERSION}")
+    if ("${version}" STREQUAL "")
+        set(version "1.0")
+    endif()
+
+    add_dependencies(${MI_TARGET} ${clpt} ${bhtg})
+    # every bundle layout has the binary in a folder next to Contents/Resources
+    add_custom_command(TARGET ${MI_TARGET} POST_BUILD
+            COMMAND $<TARGET_FILE:${bhtg}> "${clapfile}"
+            "$<TARGET_FILE_DIR:${MI_TARGET}>/../Resources/moduleinfo.json"
+            "${MI_OUTPUT_NAME}" "${version}" ${MI_SINGLE_PLUGIN_TUID}
+            VERBATIM
+            )
+endfunction(private_add_vst3_moduleinfo)
+
 # define libraries
 function(target_add_vst3_wrapper)
     set(oneValueArgs
@@ -47,6 +111,8 @@ function(target_add_vst3_wrapper)
             WINDOWS_FOLDER_VST3
 
             MACOS_EMBEDDED_CLAP_LOCATION
+
+            CLAP_TARGET_FOR_CONFIG
             )
     cmake_parse_arguments(V3 "" "${oneValueArgs}" "" ${ARGN} )
 
@@ -165,6 +231,15 @@ function(target_add_vst3_wrapper)
         endif()
     endif()
 
+    if (DEFINED V3_CLAP_TARGET_FOR_CONFIG)
+        private_add_vst3_moduleinfo(TARGET ${V3_TARGET}
+                OUTPUT_NAME ${V3_OUTPUT_NAME}
+                BUNDLE_VERSION "${V3_BUNDLE_VERSION}"
+                SINGLE_PLUGIN_TUID "${V3_SINGLE_PLUGIN_TUID}"
+                WINDOWS_FOLDER_VST3 ${V3_WINDOWS_FOLDER_VST3}
+                CLAP_TARGET_FOR_CONFIG ${V3_CLAP_TARGET_FOR_CONFIG})
+    endif()
+
     if (${CLAP_WRAPPER_COPY_AFTER_BUILD})
         target_copy_after_build(TARGET ${V3_TARGET} FLAVOR vst3)
     endif()
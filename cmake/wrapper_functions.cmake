@@ -27,3 +27,4 @@ guarantee_clap_wrapper_shared()
 include(cmake/wrap_auv2.cmake)
 include(cmake/wrap_vst3.cmake)
 include(cmake/wrap_standalone.cmake)
+include(cmake/wrap_batchrender.cmake)
@@ -21,6 +21,9 @@ static const CLAP_CONSTEXPR char CLAP_PLUGIN_FACTORY_INFO_VST3[] = "clap.plugin-
 // the plugin extension
 static const CLAP_CONSTEXPR char CLAP_PLUGIN_AS_VST3[] = "clap.plugin-info-as-vst3/0";
 
+// the plugin extension for the process context requirements
+static const CLAP_CONSTEXPR char CLAP_PLUGIN_PROCESS_CONTEXT_AS_VST3[] = "clap.plugin-process-context-as-vst3/0";
+
 typedef uint8_t array_of_16_bytes[16];
 
 // clang-format off
@@ -135,3 +138,36 @@ typedef struct clap_plugin_as_vst3
   uint32_t(CLAP_ABI* supportedNoteExpressions)(
       const clap_plugin* plugin);  // returns a bitmap of clap_supported_note_expressions
 } clap_plugin_as_vst3_t;
+
+/*
+  the values match Steinberg::Vst::IProcessContextRequirements::Flags
+*/
+enum clap_process_context_requirements
+{
+  AS_VST3_CONTEXT_NEED_SYSTEM_TIME = 1 << 0,
+  AS_VST3_CONTEXT_NEED_CONTINUOUS_TIME_SAMPLES = 1 << 1,
+  AS_VST3_CONTEXT_NEED_PROJECT_TIME_MUSIC = 1 << 2,
+  AS_VST3_CONTEXT_NEED_BAR_POSITION_MUSIC = 1 << 3,
+  AS_VST3_CONTEXT_NEED_CYCLE_MUSIC = 1 << 4,
+  AS_VST3_CONTEXT_NEED_SAMPLES_TO_NEXT_CLOCK = 1 << 5,
+  AS_VST3_CONTEXT_NEED_TEMPO = 1 << 6,
+  AS_VST3_CONTEXT_NEED_TIME_SIGNATURE = 1 << 7,
+  AS_VST3_CONTEXT_NEED_CHORD = 1 << 8,
+  AS_VST3_CONTEXT_NEED_FRAME_RATE = 1 << 9,
+  AS_VST3_CONTEXT_NEED_TRANSPORT_STATE = 1 << 10
+};
+
+/*
+  tell the VST3 host which parts of the ProcessContext are actually being used by the plugin, so the
+  host does not need to compute the others for each block.
+
+  If the plugin does not provide this extension, the wrapper requests everything that is being
+  translated into the clap_event_transport.
+
+  This extension is optionally returned by the plugin when asked for extension CLAP_PLUGIN_PROCESS_CONTEXT_AS_VST3
+*/
+typedef struct clap_plugin_process_context_as_vst3
+{
+  uint32_t(CLAP_ABI* getProcessContextRequirements)(
+      const clap_plugin* plugin);  // returns a bitmap of clap_process_context_requirements
+} clap_plugin_process_context_as_vst3_t;
@@ -206,6 +206,11 @@ void Plugin::connectClap(const clap_plugin_t* clap)
   getExtension(_plugin, _ext._state, CLAP_EXT_STATE);
   getExtension(_plugin, _ext._params, CLAP_EXT_PARAMS);
   getExtension(_plugin, _ext._audioports, CLAP_EXT_AUDIO_PORTS);
+  getExtension(_plugin, _ext._audioportsactivation, CLAP_EXT_AUDIO_PORTS_ACTIVATION);
+  if (_ext._audioportsactivation == nullptr)
+  {
+    getExtension(_plugin, _ext._audioportsactivation, CLAP_EXT_AUDIO_PORTS_ACTIVATION_COMPAT);
+  }
   getExtension(_plugin, _ext._noteports, CLAP_EXT_NOTE_PORTS);
   getExtension(_plugin, _ext._latency, CLAP_EXT_LATENCY);
   getExtension(_plugin, _ext._render, CLAP_EXT_RENDER);
@@ -356,6 +361,30 @@ const clap_plugin_gui_t* Plugin::getUI() const
   return nullptr;
 }
 
+// Returns true if the plugin supports activation/deactivation of audio ports while processing.
+// [main-thread]
+bool Plugin::canActivateAudioPortsWhileProcessing() const
+{
+  if (_ext._audioportsactivation)
+  {
+    return _ext._audioportsactivation->can_activate_while_processing(_plugin);
+  }
+  return false;
+}
+
+// Activates or deactivates an audio port. sample_size is 32, 64 or 0 if unspecified.
+// [active ? audio-thread : main-thread]
+bool Plugin::setAudioPortActive(bool is_input, uint32_t port_index, bool is_active,
+                                uint32_t sample_size) const
+{
+  if (_ext._audioportsactivation)
+  {
+    return _ext._audioportsactivation->set_active(_plugin, is_input, port_index, is_active,
+                                                  sample_size);
+  }
+  return false;
+}
+
 void Plugin::mark_dirty()
 {
   _parentHost->mark_dirty();
@@ -105,6 +105,7 @@ struct ClapPluginExtensions
   const clap_plugin_state_t* _state = nullptr;
   const clap_plugin_params_t* _params = nullptr;
   const clap_plugin_audio_ports_t* _audioports = nullptr;
+  const clap_plugin_audio_ports_activation_t* _audioportsactivation = nullptr;
   const clap_plugin_gui_t* _gui = nullptr;
   const clap_plugin_note_ports_t* _noteports = nullptr;
   const clap_plugin_latency_t* _latency = nullptr;
@@ -181,6 +182,11 @@ class Plugin
   // void process(const clap_process_t* data);
   const clap_plugin_gui_t* getUI() const;
 
+  // audio-ports-activation
+  bool canActivateAudioPortsWhileProcessing() const;
+  bool setAudioPortActive(bool is_input, uint32_t port_index, bool is_active,
+                          uint32_t sample_size = 32) const;
+
   ClapPluginExtensions _ext;
   const clap_plugin_t* _plugin = nullptr;
   void log(clap_log_severity severity, const char* msg);
@@ -0,0 +1,13 @@
+#include "detail/batchrender/batch_render.h"
+
+// clap-batch-render PLUGIN.clap [options] INPUT.wav|DIRECTORY...
+int main(int argc, char **argv)
+{
+  freeaudio::clap_wrapper::batchrender::BatchSettings settings;
+  if (!freeaudio::clap_wrapper::batchrender::parseCommandLine(argc, argv, settings))
+  {
+    freeaudio::clap_wrapper::batchrender::printUsage(argv[0]);
+    return 1;
+  }
+  return freeaudio::clap_wrapper::batchrender::runBatch(settings);
+}
@@ -0,0 +1,331 @@
+#define NOMINMAX 1
+#include "batch_host.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "wav_stream_writer.h"
+#include "detail/shared/audiothread_guard.h"
+#include "detail/standalone/wavfile.h"
+
+namespace freeaudio::clap_wrapper::batchrender
+{
+using freeaudio::clap_wrapper::standalone::AudioFileData;
+using freeaudio::clap_wrapper::standalone::readWavFile;
+
+bool BatchHost::create(const clap_plugin_factory *factory, const std::string &pluginId,
+                       std::string &error)
+{
+  plugin = Clap::Plugin::createInstance(factory, pluginId, this);
+  if (!plugin || !plugin->_plugin)
+  {
+    error = "unable to create the plugin '" + pluginId + "'";
+    plugin.reset();
+    return false;
+  }
+  if (!plugin->initialize())
+  {
+    error = "unable to initialize the plugin '" + pluginId + "'";
+    plugin.reset();
+    return false;
+  }
+  return true;
+}
+
+void BatchHost::setupAudioBusses(const clap_plugin_t *p, const clap_plugin_audio_ports_t *audioports)
+{
+  clap_audio_port_info_t info;
+  for (auto i = 0U; i < audioports->count(p, true); ++i)
+  {
+    audioports->get(p, i, true, &info);
+    inputChannelByPort.push_back(info.channel_count);
+    totalInputChannels += info.channel_count;
+    if (info.flags & CLAP_AUDIO_PORT_IS_MAIN) mainInput = i;
+  }
+  for (auto i = 0U; i < audioports->count(p, false); ++i)
+  {
+    audioports->get(p, i, false, &info);
+    outputChannelByPort.push_back(info.channel_count);
+    totalOutputChannels += info.channel_count;
+  }
+}
+
+bool BatchHost::applyParams(const std::vector<ParamOverride> &params, std::string &error)
+{
+  if (params.empty())
+  {
+    return true;
+  }
+  auto *p = plugin->_plugin;
+  auto ext = plugin->_ext._params;
+  if (!ext)
+  {
+    error = "the plugin has no parameters";
+    return false;
+  }
+
+  std::vector<clap_event_param_value> events;
+  for (const auto &o : params)
+  {
+    // by id, or else by name
+    clap_param_info info{};
+    bool found{false};
+    for (auto i = 0U; i < ext->count(p) && !found; ++i)
+    {
+      found = ext->get_info(p, i, &info) && (std::to_string(info.id) == o.param || o.param == info.name);
+    }
+    if (!found)
+    {
+      error = "the plugin has no parameter '" + o.param + "'";
+      return false;
+    }
+    clap_event_param_value ev{};
+    ev.header = {sizeof(ev), 0, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_PARAM_VALUE, 0};
+    ev.param_id = info.id;
+    ev.cookie = info.cookie;
+    ev.note_id = -1;
+    ev.port_index = -1;
+    ev.channel = -1;
+    ev.key = -1;
+    ev.value = std::clamp(o.value, info.min_value, info.max_value);
+    events.push_back(ev);
+  }
+
+  // the plugin is not active yet, so the values go in with a flush on the main thread
+  clap_input_events in{};
+  in.ctx = &events;
+  in.size = [](const clap_input_events *list)
+  { return (uint32_t)static_cast<std::vector<clap_event_param_value> *>(list->ctx)->size(); };
+  in.get = [](const clap_input_events *list, uint32_t index)
+  {
+    auto &evs = *static_cast<std::vector<clap_event_param_value> *>(list->ctx);
+    return (const clap_event_header_t *)&(evs[index].header);
+  };
+  clap_output_events out{};
+  out.try_push = [](const clap_output_events *, const clap_event_header_t *) { return true; };
+  ext->flush(p, &in, &out);
+  return true;
+}
+
+bool BatchHost::prepare(const RenderSetup &s, std::string &error)
+{
+  setup = s;
+  auto *p = plugin->_plugin;
+
+  if (totalOutputChannels == 0)
+  {
+    error = "the plugin has no audio outputs";
+    return false;
+  }
+  if (!setup.state.empty())
+  {
+    Clap::StateMemento state;
+    state.setData(setup.state.data(), setup.state.size());
+    if (!plugin->load(state))
+    {
+      error = "the plugin did not accept the state";
+      return false;
+    }
+  }
+  if (!applyParams(setup.params, error))
+  {
+    return false;
+  }
+  auto render = plugin->_ext._render;
+  if (render && !render->has_hard_realtime_requirement(p))
+  {
+    render->set(p, CLAP_RENDER_OFFLINE);
+  }
+
+  auto block = setup.blockSize;
+  inputMemory.assign((size_t)totalInputChannels * block, 0.f);
+  outputMemory.assign((size_t)totalOutputChannels * block, 0.f);
+  inputChannelPtr.resize(totalInputChannels);
+  outputChannelPtr.resize(totalOutputChannels);
+  for (auto i = 0U; i < totalInputChannels; ++i) inputChannelPtr[i] = inputMemory.data() + i * block;
+  for (auto i = 0U; i < totalOutputChannels; ++i) outputChannelPtr[i] = outputMemory.data() + i * block;
+
+  auto buildPorts = [](const std::vector<uint32_t> &channelByPort, std::vector<float *> &channelPtr,
+                       std::vector<clap_audio_buffer> &ports)
+  {
+    ports.clear();
+    uint32_t offset{0};
+    for (auto n : channelByPort)
+    {
+      clap_audio_buffer b{};
+      b.data32 = channelPtr.data() + offset;
+      b.channel_count = n;
+      ports.push_back(b);
+      offset += n;
+    }
+  };
+  buildPorts(inputChannelByPort, inputChannelPtr, inputPorts);
+  buildPorts(outputChannelByPort, outputChannelPtr, outputPorts);
+
+  plugin->setSampleRate(setup.sampleRate);
+  plugin->setBlockSizes(1, block);
+  if (!plugin->activate())
+  {
+    error = "the plugin failed to activate";
+    return false;
+  }
+  active = true;
+
+  auto tail = setup.tailSeconds;
+  if (tail < 0)
+  {
+    tail = 0;
+    if (plugin->_ext._tail)
+    {
+      auto frames = plugin->_ext._tail->get(p);
+      tail = (frames == UINT32_MAX) ? maxTailSeconds
+                                    : std::min((double)frames / setup.sampleRate, maxTailSeconds);
+    }
+  }
+  tailFrames = (int64_t)std::ceil(tail * setup.sampleRate);
+
+  transport.header = {sizeof(transport), 0, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_TRANSPORT, 0};
+  transport.flags = CLAP_TRANSPORT_HAS_TEMPO | CLAP_TRANSPORT_HAS_BEATS_TIMELINE |
+                    CLAP_TRANSPORT_HAS_SECONDS_TIMELINE | CLAP_TRANSPORT_HAS_TIME_SIGNATURE |
+                    CLAP_TRANSPORT_IS_PLAYING;
+  transport.tempo = setup.tempo;
+  transport.tsig_num = 4;
+  transport.tsig_denom = 4;
+
+  inputEvents.ctx = this;
+  inputEvents.size = [](const clap_input_events *) { return 0U; };
+  inputEvents.get = [](const clap_input_events *, uint32_t) -> const clap_event_header_t *
+  { return nullptr; };
+  outputEvents.ctx = this;
+  outputEvents.try_push = [](const clap_output_events *, const clap_event_header_t *) { return true; };
+  return true;
+}
+
+void BatchHost::runCallbackIfRequested()
+{
+  if (plugin && callbackRequested.exchange(false))
+  {
+    plugin->_plugin->on_main_thread(plugin->_plugin);
+  }
+}
+
+void BatchHost::finish()
+{
+  if (plugin && active)
+  {
+    plugin->deactivate();
+    active = false;
+  }
+  plugin.reset();
+}
+
+void BatchHost::startProcessing()
+{
+  plugin->start_processing();
+}
+
+void BatchHost::stopProcessing()
+{
+  plugin->stop_processing();
+}
+
+void BatchHost::updateTransport(int64_t position)
+{
+  auto seconds = (double)position / setup.sampleRate;
+  auto beats = seconds * setup.tempo / 60.0;
+  auto bar = std::floor(beats / 4);
+  transport.song_pos_beats = std::llround(beats * CLAP_BEATTIME_FACTOR);
+  transport.song_pos_seconds = std::llround(seconds * CLAP_SECTIME_FACTOR);
+  transport.bar_start = std::llround(bar * 4 * CLAP_BEATTIME_FACTOR);
+  transport.bar_number = (int32_t)bar;
+}
+
+bool BatchHost::renderFile(const fs::path &input, WavStreamWriter &writer, const fs::path &output,
+                           double &seconds, std::string &error)
+{
+  AudioFileData in;
+  if (!readWavFile(input, in, error))
+  {
+    return false;
+  }
+  if (in.sampleRate != setup.sampleRate)
+  {
+    error = "the file is at " + std::to_string(in.sampleRate) + "Hz, the batch renders at " +
+            std::to_string(setup.sampleRate) + "Hz";
+    return false;
+  }
+
+  // the file feeds the main input port, a mono file all of its channels
+  std::vector<const std::vector<float> *> source(totalInputChannels, nullptr);
+  if (!in.channels.empty() && mainInput < inputChannelByPort.size())
+  {
+    uint32_t first{0};
+    for (auto i = 0U; i < mainInput; ++i) first += inputChannelByPort[i];
+    for (auto c = 0U; c < inputChannelByPort[mainInput]; ++c)
+    {
+      auto fc = in.channels.size() == 1 ? 0U : c;
+      if (fc < in.channels.size()) source[first + c] = &in.channels[fc];
+    }
+  }
+
+  if (!writer.open(output, totalOutputChannels, setup.sampleRate, error))
+  {
+    return false;
+  }
+
+  auto *p = plugin->_plugin;
+  p->reset(p);
+
+  clap_process process{};
+  process.transport = &transport;
+  process.in_events = &inputEvents;
+  process.out_events = &outputEvents;
+  process.audio_inputs_count = (uint32_t)inputPorts.size();
+  process.audio_outputs_count = (uint32_t)outputPorts.size();
+  process.audio_inputs = inputPorts.data();
+  process.audio_outputs = outputPorts.data();
+
+  auto fileFrames = (int64_t)in.frames();
+  auto totalFrames = fileFrames + tailFrames;
+  bool ok{true};
+  for (int64_t pos = 0; pos < totalFrames && ok; pos += setup.blockSize)
+  {
+    auto frames = (uint32_t)std::min<int64_t>(setup.blockSize, totalFrames - pos);
+    for (auto c = 0U; c < totalInputChannels; ++c)
+    {
+      auto *dst = inputChannelPtr[c];
+      auto n = source[c] ? (uint32_t)std::clamp<int64_t>(fileFrames - pos, 0, frames) : 0U;
+      if (n > 0)
+      {
+        memcpy(dst, source[c]->data() + pos, n * sizeof(float));
+      }
+      memset(dst + n, 0, (frames - n) * sizeof(float));
+    }
+    updateTransport(pos);
+    process.frames_count = frames;
+    process.steady_time = steadyTime;
+
+    {
+      ClapWrapper::detail::shared::AudioThreadSection audiothread("BatchHost::renderFile");
+      ok = p->process(p, &process) != CLAP_PROCESS_ERROR;
+    }
+    steadyTime += frames;
+    writer.write(outputChannelPtr.data(), frames);
+  }
+
+  std::string closeError;
+  if (!writer.close(closeError))
+  {
+    error = closeError;
+    return false;
+  }
+  if (!ok)
+  {
+    error = "the plugin returned a processing error";
+    return false;
+  }
+  seconds = (double)totalFrames / setup.sampleRate;
+  return true;
+}
+}  // namespace freeaudio::clap_wrapper::batchrender
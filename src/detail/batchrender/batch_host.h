@@ -0,0 +1,190 @@
+#pragma once
+
+/*
+ * The host of one plugin instance in the batch renderer. Every worker thread owns one
+ * BatchHost and renders the files it takes from the queue through it, one after the other.
+ *
+ * The instance is created, set up and activated on the main thread. The worker only calls
+ * start_processing, reset, process and stop_processing, so for the plugin it is the audio
+ * thread. Callbacks the plugin requests are run by the main thread while the workers render.
+ */
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <clap/clap.h>
+#include "clap_proxy.h"
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::batchrender
+{
+class WavStreamWriter;
+
+struct ParamOverride
+{
+  // a parameter id or name
+  std::string param;
+  double value{0};
+};
+
+struct RenderSetup
+{
+  int32_t sampleRate{48000};
+  uint32_t blockSize{512};
+  // a negative tail takes the tail the plugin reports
+  double tailSeconds{-1};
+  double tempo{120};
+  std::vector<uint8_t> state;
+  std::vector<ParamOverride> params;
+};
+
+class BatchHost : public Clap::IHost
+{
+ public:
+  BatchHost() = default;
+  ~BatchHost() override = default;
+
+  // all on the main thread. create also initializes the plugin, prepare applies the state and
+  // the parameter overrides and activates it
+  bool create(const clap_plugin_factory *factory, const std::string &pluginId, std::string &error);
+  bool prepare(const RenderSetup &setup, std::string &error);
+  void runCallbackIfRequested();
+  void finish();
+
+  // on the worker thread
+  void startProcessing();
+  bool renderFile(const fs::path &input, WavStreamWriter &writer, const fs::path &output,
+                  double &seconds, std::string &error);
+  void stopProcessing();
+
+  // Clap::IHost
+  void mark_dirty() override
+  {
+  }
+  void restartPlugin() override
+  {
+  }
+  void request_callback() override
+  {
+    callbackRequested = true;
+  }
+  void setupWrapperSpecifics(const clap_plugin_t *plugin) override
+  {
+  }
+  void setupAudioBusses(const clap_plugin_t *plugin,
+                        const clap_plugin_audio_ports_t *audioports) override;
+  void setupMIDIBusses(const clap_plugin_t *plugin, const clap_plugin_note_ports_t *noteports) override
+  {
+  }
+  void setupParameters(const clap_plugin_t *plugin, const clap_plugin_params_t *params) override
+  {
+  }
+  void param_rescan(clap_param_rescan_flags flags) override
+  {
+  }
+  void param_clear(clap_id param, clap_param_clear_flags flags) override
+  {
+  }
+  void param_request_flush() override
+  {
+  }
+  void latency_changed() override
+  {
+  }
+  void tail_changed() override
+  {
+  }
+  bool gui_can_resize() override
+  {
+    return false;
+  }
+  bool gui_request_resize(uint32_t width, uint32_t height) override
+  {
+    return false;
+  }
+  bool gui_request_show() override
+  {
+    return false;
+  }
+  bool gui_request_hide() override
+  {
+    return false;
+  }
+  bool register_timer(uint32_t period_ms, clap_id *timer_id) override
+  {
+    return false;
+  }
+  bool unregister_timer(clap_id timer_id) override
+  {
+    return false;
+  }
+  const char *host_get_name() override
+  {
+    return "CLAP-Wrapper-Batch-Render";
+  }
+  bool supportsContextMenu() const override
+  {
+    return false;
+  }
+  bool context_menu_populate(const clap_context_menu_target_t *target,
+                             const clap_context_menu_builder_t *builder) override
+  {
+    return false;
+  }
+  bool context_menu_perform(const clap_context_menu_target_t *target, clap_id action_id) override
+  {
+    return false;
+  }
+  bool context_menu_can_popup() override
+  {
+    return false;
+  }
+  bool context_menu_popup(const clap_context_menu_target_t *target, int32_t screen_index, int32_t x,
+                          int32_t y) override
+  {
+    return false;
+  }
+#if LIN
+  bool register_fd(int fd, clap_posix_fd_flags_t flags) override
+  {
+    return false;
+  }
+  bool modify_fd(int fd, clap_posix_fd_flags_t flags) override
+  {
+    return false;
+  }
+  bool unregister_fd(int fd) override
+  {
+    return false;
+  }
+#endif
+
+ private:
+  bool applyParams(const std::vector<ParamOverride> &params, std::string &error);
+  void updateTransport(int64_t position);
+
+  // a plugin which reports an infinite tail rings out for this long
+  static constexpr double maxTailSeconds{30};
+
+  std::shared_ptr<Clap::Plugin> plugin;
+  std::atomic<bool> callbackRequested{false};
+  bool active{false};
+  RenderSetup setup;
+  int64_t tailFrames{0};
+
+  std::vector<uint32_t> inputChannelByPort, outputChannelByPort;
+  uint32_t mainInput{0}, totalInputChannels{0}, totalOutputChannels{0};
+
+  // one row of blockSize frames per plugin channel
+  std::vector<float> inputMemory, outputMemory;
+  std::vector<float *> inputChannelPtr, outputChannelPtr;
+  std::vector<clap_audio_buffer> inputPorts, outputPorts;
+
+  clap_event_transport transport{};
+  int64_t steadyTime{0};
+  clap_input_events inputEvents{};
+  clap_output_events outputEvents{};
+};
+}  // namespace freeaudio::clap_wrapper::batchrender
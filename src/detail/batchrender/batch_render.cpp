@@ -0,0 +1,372 @@
+#if WIN
+#define NOMINMAX 1
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "batch_render.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "wav_stream_writer.h"
+#include "detail/shared/denormals.h"
+
+namespace freeaudio::clap_wrapper::batchrender
+{
+
+void printUsage(const char *argv0)
+{
+  std::cout << "Usage: " << argv0 << " PLUGIN.clap [options] INPUT.wav|DIRECTORY...\n"
+            << "  --plugin-id ID        the plugin in the .clap, the first one by default\n"
+            << "  --plugin-index N      the plugin in the .clap by index\n"
+            << "  --state FILE          a saved plugin state loaded into every instance\n"
+            << "  --param ID=VALUE      a parameter by id or name, may be repeated\n"
+            << "  --jobs N              worker threads, one per core by default\n"
+            << "  --no-pin              don't pin the workers to cores\n"
+            << "  --buffer-size N       the block size, 512 by default\n"
+            << "  --sample-rate SR      the rate of all inputs, 48000 by default\n"
+            << "  --tail SECONDS        rendered after each input, the plugin's tail by default\n"
+            << "  --tempo BPM           the transport tempo, 120 by default\n"
+            << "  --output-dir DIR      where the results go, next to the inputs by default\n"
+            << "  --suffix S            appended to the input name, '-render' by default\n";
+}
+
+static bool parseNumber(const std::string &value, double &result)
+{
+  try
+  {
+    size_t used{0};
+    auto v = std::stod(value, &used);
+    if (used == value.size())
+    {
+      result = v;
+      return true;
+    }
+  }
+  catch (const std::exception &)
+  {
+  }
+  return false;
+}
+
+static bool addInput(const fs::path &path, std::vector<fs::path> &inputs)
+{
+  std::error_code ec;
+  if (fs::is_directory(path, ec))
+  {
+    // the .wav files directly in the directory, in a stable order
+    std::vector<fs::path> found;
+    for (const auto &e : fs::directory_iterator(path, ec))
+    {
+      auto ext = e.path().extension().u8string();
+      std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+      if (e.is_regular_file(ec) && ext == ".wav")
+      {
+        found.push_back(e.path());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    inputs.insert(inputs.end(), found.begin(), found.end());
+    return !ec;
+  }
+  if (!fs::exists(path, ec))
+  {
+    return false;
+  }
+  inputs.push_back(path);
+  return true;
+}
+
+bool parseCommandLine(int argc, char **argv, BatchSettings &settings)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if (arg.rfind("--", 0) != 0)
+    {
+      if (settings.clapPath.empty())
+      {
+        settings.clapPath = fs::u8path(arg);
+      }
+      else if (!addInput(fs::u8path(arg), settings.inputs))
+      {
+        std::cerr << "No such input: " << arg << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (arg == "--no-pin")
+    {
+      settings.pinWorkers = false;
+      continue;
+    }
+    if (arg == "--help")
+    {
+      return false;
+    }
+    if (i + 1 >= argc)
+    {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return false;
+    }
+    std::string value{argv[++i]};
+
+    double number{0};
+    bool ok{true};
+    if (arg == "--plugin-id")
+    {
+      settings.pluginId = value;
+    }
+    else if (arg == "--plugin-index")
+    {
+      ok = parseNumber(value, number) && number >= 0;
+      settings.pluginIndex = (uint32_t)number;
+    }
+    else if (arg == "--state")
+    {
+      settings.statePath = fs::u8path(value);
+    }
+    else if (arg == "--param")
+    {
+      auto eq = value.rfind('=');
+      ok = eq != std::string::npos && eq > 0 && parseNumber(value.substr(eq + 1), number);
+      settings.setup.params.push_back({value.substr(0, eq), number});
+    }
+    else if (arg == "--jobs")
+    {
+      ok = parseNumber(value, number) && number >= 1 && number <= 1024;
+      settings.jobs = (uint32_t)number;
+    }
+    else if (arg == "--buffer-size")
+    {
+      ok = parseNumber(value, number) && number >= 1 && number <= 65536;
+      settings.setup.blockSize = (uint32_t)number;
+    }
+    else if (arg == "--sample-rate")
+    {
+      ok = parseNumber(value, number) && number >= 8000 && number <= 768000;
+      settings.setup.sampleRate = (int32_t)number;
+    }
+    else if (arg == "--tail")
+    {
+      ok = parseNumber(value, number) && number >= 0;
+      settings.setup.tailSeconds = number;
+    }
+    else if (arg == "--tempo")
+    {
+      ok = parseNumber(value, number) && number >= 20 && number <= 999;
+      settings.setup.tempo = number;
+    }
+    else if (arg == "--output-dir")
+    {
+      settings.outputDir = fs::u8path(value);
+    }
+    else if (arg == "--suffix")
+    {
+      settings.suffix = value;
+    }
+    else
+    {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return false;
+    }
+    if (!ok)
+    {
+      std::cerr << "Invalid value for " << arg << ": '" << value << "'" << std::endl;
+      return false;
+    }
+  }
+
+  if (settings.clapPath.empty() || settings.inputs.empty())
+  {
+    std::cerr << "A .clap and at least one input are needed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static void pinToCpu(uint32_t cpu)
+{
+#if WIN
+  if (cpu < 64)
+  {
+    SetThreadAffinityMask(GetCurrentThread(), 1ULL << cpu);
+  }
+#elif LIN
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+  // macOS has no hard affinity, the scheduler spreads the workers
+  (void)cpu;
+#endif
+}
+
+static fs::path outputPath(const BatchSettings &settings, const fs::path &input)
+{
+  auto dir = settings.outputDir.empty() ? input.parent_path() : settings.outputDir;
+  return dir / fs::u8path(input.stem().u8string() + settings.suffix + ".wav");
+}
+
+int runBatch(const BatchSettings &settings)
+{
+  Clap::Library library;
+  if (!library.load(settings.clapPath) || !library._pluginFactory)
+  {
+    std::cerr << "Unable to load " << settings.clapPath.u8string() << std::endl;
+    return 3;
+  }
+  auto pluginId = settings.pluginId;
+  if (pluginId.empty())
+  {
+    if (settings.pluginIndex >= library.plugins.size())
+    {
+      std::cerr << settings.clapPath.u8string() << " has no plugin " << settings.pluginIndex
+                << std::endl;
+      return 3;
+    }
+    pluginId = library.plugins[settings.pluginIndex]->id;
+  }
+
+  auto setup = settings.setup;
+  if (!settings.statePath.empty())
+  {
+    std::ifstream ifs(settings.statePath, std::ios::in | std::ios::binary);
+    if (!ifs.is_open())
+    {
+      std::cerr << "Unable to open " << settings.statePath.u8string() << std::endl;
+      return 2;
+    }
+    setup.state.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  }
+
+  for (const auto &input : settings.inputs)
+  {
+    if (outputPath(settings, input) == input)
+    {
+      std::cerr << "The output for " << input.u8string() << " would overwrite it, use a --suffix"
+                << std::endl;
+      return 2;
+    }
+  }
+  std::error_code ec;
+  if (!settings.outputDir.empty() && !fs::create_directories(settings.outputDir, ec) && ec)
+  {
+    std::cerr << "Unable to create " << settings.outputDir.u8string() << std::endl;
+    return 2;
+  }
+
+  auto cores = std::max(1U, std::thread::hardware_concurrency());
+  auto jobs = settings.jobs ? settings.jobs : cores;
+  jobs = std::min(jobs, (uint32_t)settings.inputs.size());
+
+  // every instance is created and activated on the main thread
+  std::vector<std::unique_ptr<BatchHost>> hosts;
+  for (auto j = 0U; j < jobs; ++j)
+  {
+    auto host = std::make_unique<BatchHost>();
+    std::string error;
+    if (!host->create(library._pluginFactory, pluginId, error) || !host->prepare(setup, error))
+    {
+      std::cerr << "Instance " << j << ": " << error << std::endl;
+      host->finish();
+      for (auto &h : hosts) h->finish();
+      return 3;
+    }
+    hosts.push_back(std::move(host));
+  }
+
+  std::cout << "Rendering " << settings.inputs.size() << " files with " << jobs << " instances of "
+            << pluginId << std::endl;
+
+  struct Result
+  {
+    bool ok{false};
+    double seconds{0};
+    std::string error;
+  };
+  std::vector<Result> results(settings.inputs.size());
+  std::atomic<size_t> nextInput{0}, done{0};
+  std::atomic<uint32_t> runningWorkers{jobs};
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (auto j = 0U; j < jobs; ++j)
+  {
+    workers.emplace_back(
+        [&, j]()
+        {
+          if (settings.pinWorkers)
+          {
+            pinToCpu(j % cores);
+          }
+          ClapWrapper::detail::shared::flushDenormals();
+
+          auto &host = *hosts[j];
+          WavStreamWriter writer;
+          host.startProcessing();
+          size_t i;
+          while ((i = nextInput++) < settings.inputs.size())
+          {
+            auto &r = results[i];
+            const auto &input = settings.inputs[i];
+            r.ok = host.renderFile(input, writer, outputPath(settings, input), r.seconds, r.error);
+            done++;
+          }
+          host.stopProcessing();
+          runningWorkers--;
+        });
+  }
+
+  // the main thread serves the callbacks the instances request and reports the progress
+  size_t reported{0};
+  auto lastReport = start;
+  while (runningWorkers > 0)
+  {
+    for (auto &h : hosts) h->runCallbackIfRequested();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    auto now = std::chrono::steady_clock::now();
+    if (done != reported && now - lastReport > std::chrono::seconds(1))
+    {
+      reported = done;
+      lastReport = now;
+      std::cout << "  " << reported << " / " << settings.inputs.size() << std::endl;
+    }
+  }
+  for (auto &w : workers) w.join();
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (auto &h : hosts) h->finish();
+  hosts.clear();
+
+  size_t failed{0};
+  double audioSeconds{0};
+  for (auto i = 0U; i < results.size(); ++i)
+  {
+    audioSeconds += results[i].seconds;
+    if (!results[i].ok)
+    {
+      failed++;
+      std::cerr << "[ERROR] " << settings.inputs[i].u8string() << ": " << results[i].error << std::endl;
+    }
+  }
+  std::cout << "Rendered " << results.size() - failed << " of " << results.size() << " files, "
+            << audioSeconds << "s of audio in " << elapsed << "s, "
+            << (elapsed > 0 ? audioSeconds / elapsed : 0) << "x realtime" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
+}  // namespace freeaudio::clap_wrapper::batchrender
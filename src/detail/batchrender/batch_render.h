@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+ * clap-batch-render renders a batch of WAV files through a .clap. It runs one plugin instance
+ * per worker thread, each pinned to its own core, and the workers take the files from a shared
+ * queue, so a long file on one core doesn't hold up the others. All instances get the same
+ * state and parameter overrides.
+ */
+
+#include <string>
+#include <vector>
+
+#include "batch_host.h"
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::batchrender
+{
+struct BatchSettings
+{
+  fs::path clapPath;
+  // empty takes the plugin at pluginIndex
+  std::string pluginId;
+  uint32_t pluginIndex{0};
+  fs::path statePath;
+  // 0 uses a worker per core
+  uint32_t jobs{0};
+  bool pinWorkers{true};
+  // empty writes next to the input file
+  fs::path outputDir;
+  std::string suffix{"-render"};
+  RenderSetup setup;
+  std::vector<fs::path> inputs;
+};
+
+bool parseCommandLine(int argc, char **argv, BatchSettings &settings);
+void printUsage(const char *argv0);
+
+// returns the process exit code, 0 if every file rendered
+int runBatch(const BatchSettings &settings);
+}  // namespace freeaudio::clap_wrapper::batchrender
@@ -0,0 +1,141 @@
+#define NOMINMAX 1
+#include "wav_stream_writer.h"
+
+#include <algorithm>
+
+#include "detail/standalone/wavfile.h"
+
+namespace freeaudio::clap_wrapper::batchrender
+{
+using freeaudio::clap_wrapper::standalone::wavHeaderBytes;
+using freeaudio::clap_wrapper::standalone::writeWavHeader;
+
+WavStreamWriter::WavStreamWriter(uint32_t chunkFrames) : chunkFrames(chunkFrames)
+{
+  thread = std::thread([this]() { run(); });
+}
+
+WavStreamWriter::~WavStreamWriter()
+{
+  {
+    std::lock_guard<std::mutex> g(mutex);
+    quit = true;
+  }
+  cv.notify_all();
+  thread.join();
+}
+
+bool WavStreamWriter::open(const fs::path &to, uint32_t channels, int32_t sr, std::string &error)
+{
+  waitForWriter();
+  path = to;
+  ofs.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open())
+  {
+    error = "unable to open " + path.u8string() + " for writing";
+    return false;
+  }
+  numChannels = channels;
+  sampleRate = sr;
+  dataBytes = 0;
+  failed = false;
+  current = 0;
+  currentFrames = 0;
+  for (auto &c : chunks)
+  {
+    c.resize((size_t)chunkFrames * numChannels);
+  }
+  // the sizes are filled in on close
+  writeWavHeader(ofs, (uint16_t)numChannels, sampleRate, 0);
+  return true;
+}
+
+void WavStreamWriter::write(const float *const *channels, uint32_t frames)
+{
+  uint32_t done{0};
+  while (done < frames)
+  {
+    auto n = std::min(frames - done, chunkFrames - currentFrames);
+    auto *out = chunks[current].data() + (size_t)currentFrames * numChannels;
+    for (auto i = 0U; i < n; ++i)
+    {
+      for (auto c = 0U; c < numChannels; ++c)
+      {
+        *out++ = channels[c][done + i];
+      }
+    }
+    done += n;
+    currentFrames += n;
+    if (currentFrames == chunkFrames)
+    {
+      submit();
+    }
+  }
+}
+
+bool WavStreamWriter::close(std::string &error)
+{
+  if (currentFrames > 0)
+  {
+    submit();
+  }
+  waitForWriter();
+
+  // a float WAV is limited to 4GB like any other
+  auto size = (uint32_t)std::min<uint64_t>(dataBytes, UINT32_MAX - wavHeaderBytes);
+  ofs.seekp(0);
+  writeWavHeader(ofs, (uint16_t)numChannels, sampleRate, size);
+  ofs.close();
+  if (failed || ofs.fail())
+  {
+    error = "write to " + path.u8string() + " failed";
+    return false;
+  }
+  return true;
+}
+
+void WavStreamWriter::submit()
+{
+  // the previous chunk has to be on disk before its buffer is filled again
+  waitForWriter();
+  {
+    std::lock_guard<std::mutex> g(mutex);
+    pendingChunk = current;
+    pendingFrames = currentFrames;
+    pending = true;
+  }
+  cv.notify_all();
+  current ^= 1;
+  currentFrames = 0;
+}
+
+void WavStreamWriter::waitForWriter()
+{
+  std::unique_lock<std::mutex> g(mutex);
+  cv.wait(g, [this]() { return !pending; });
+}
+
+void WavStreamWriter::run()
+{
+  std::unique_lock<std::mutex> g(mutex);
+  while (true)
+  {
+    cv.wait(g, [this]() { return pending || quit; });
+    if (!pending)
+    {
+      return;
+    }
+    auto bytes = (size_t)pendingFrames * numChannels * sizeof(float);
+    const auto *data = chunks[pendingChunk].data();
+    g.unlock();
+    // the floats are stored little endian, like on all platforms the wrapper runs on
+    ofs.write((const char *)data, bytes);
+    auto ok = ofs.good();
+    g.lock();
+    dataBytes += bytes;
+    failed = failed || !ok;
+    pending = false;
+    cv.notify_all();
+  }
+}
+}  // namespace freeaudio::clap_wrapper::batchrender
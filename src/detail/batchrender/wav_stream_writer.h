@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+ * Streams a 32 bit float WAV to disk while the render goes on. Frames are interleaved into
+ * one of two chunk buffers, a full chunk is handed to the writer thread and the render
+ * continues in the other one, so it only waits for the disk if that is slower than the
+ * plugin. The writer thread lives as long as the object and serves one file after the other.
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::batchrender
+{
+class WavStreamWriter
+{
+ public:
+  explicit WavStreamWriter(uint32_t chunkFrames = 32 * 1024);
+  ~WavStreamWriter();
+  WavStreamWriter(const WavStreamWriter &) = delete;
+  WavStreamWriter &operator=(const WavStreamWriter &) = delete;
+
+  bool open(const fs::path &path, uint32_t numChannels, int32_t sampleRate, std::string &error);
+  // planar input, one pointer per channel
+  void write(const float *const *channels, uint32_t frames);
+  // writes what is left and the final header
+  bool close(std::string &error);
+
+ private:
+  void submit();
+  void waitForWriter();
+  void run();
+
+  std::ofstream ofs;
+  fs::path path;
+  uint32_t numChannels{0};
+  int32_t sampleRate{0};
+  uint32_t chunkFrames;
+  uint64_t dataBytes{0};
+
+  std::vector<float> chunks[2];
+  uint32_t current{0}, currentFrames{0};
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool pending{false}, failed{false}, quit{false};
+  uint32_t pendingChunk{0}, pendingFrames{0};
+  std::thread thread;
+};
+}  // namespace freeaudio::clap_wrapper::batchrender
@@ -10,10 +10,15 @@
 
 #include "fsutil.h"
 #include <cassert>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <system_error>
 #if WIN
 #include <windows.h>
 #include <shlobj.h>
-#include <sstream>
+#else
+#include <unistd.h>
 #endif
 
 #if MAC
@@ -147,6 +152,153 @@ std::vector<fs::path> getValidCLAPSearchPaths()
   return res;
 }
 
+fs::path getCacheFolder()
+{
+#if WIN
+  auto base{get_known_folder(FOLDERID_LocalAppData)};
+  if (base.empty()) return {};
+  return base / "clap-wrapper";
+#else
+  auto home = getenv("HOME");
+#if MAC
+  if (!home) return {};
+  return fs::path(home) / "Library" / "Caches" / "clap-wrapper";
+#else
+  auto xdg = getenv("XDG_CACHE_HOME");
+  if (xdg && xdg[0] == '/') return fs::path(xdg) / "clap-wrapper";
+  if (!home) return {};
+  return fs::path(home) / ".cache" / "clap-wrapper";
+#endif
+#endif
+}
+
+// A bundle directory keeps its time when the files inside are replaced, so its Info.plist and
+// the binary named like the bundle count as well.
+int64_t getCacheStamp(const fs::path &path)
+{
+  std::error_code ec;
+  auto stamp = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+  if (ec) return 0;
+  if (fs::is_directory(path, ec))
+  {
+    auto contents = path / "Contents";
+    for (const auto &inner : {contents / "Info.plist", contents / "MacOS" / path.stem()})
+    {
+      auto t = (int64_t)fs::last_write_time(inner, ec).time_since_epoch().count();
+      if (!ec) stamp = std::max(stamp, t);
+    }
+  }
+  return stamp;
+}
+
+bool writeCacheFile(const fs::path &file, const std::string &content)
+{
+  // scanners run in parallel, so every process writes its own file and renames it over the cache
+  std::error_code ec;
+  fs::create_directories(file.parent_path(), ec);
+  auto tempFile = file;
+#if WIN
+  tempFile += "." + std::to_string(GetCurrentProcessId());
+#else
+  tempFile += "." + std::to_string(getpid());
+#endif
+  {
+    std::ofstream ofs(tempFile, std::ios::out | std::ios::trunc | std::ios::binary);
+    ofs << content;
+    if (!ofs.good())
+    {
+      ofs.close();
+      fs::remove(tempFile, ec);
+      return false;
+    }
+  }
+  fs::rename(tempFile, file, ec);
+  if (ec)
+  {
+    fs::remove(tempFile, ec);
+    return false;
+  }
+  return true;
+}
+
+static fs::path getDiscoveryCacheFile()
+{
+  auto folder = getCacheFolder();
+  if (folder.empty()) return {};
+  return folder / "discovery.cache";
+}
+
+struct DiscoveryEntry
+{
+  std::string key;
+  int64_t stamp{0};
+  std::string path;
+};
+
+// one line per entry: key, stamp and the utf-8 path, separated by tabs
+static std::vector<DiscoveryEntry> readDiscoveryCache(const fs::path &cacheFile)
+{
+  std::vector<DiscoveryEntry> res;
+  std::ifstream ifs(cacheFile);
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    auto t1 = line.find('\t');
+    auto t2 = t1 == std::string::npos ? t1 : line.find('\t', t1 + 1);
+    if (t2 == std::string::npos) continue;
+    try
+    {
+      auto stamp = std::stoll(line.substr(t1 + 1, t2 - t1 - 1));
+      res.push_back({line.substr(0, t1), stamp, line.substr(t2 + 1)});
+    }
+    catch (const std::exception &e)
+    {
+    }
+  }
+  return res;
+}
+
+std::optional<fs::path> lookupDiscoveryCache(const std::string &key)
+{
+  auto cacheFile = getDiscoveryCacheFile();
+  if (cacheFile.empty()) return std::nullopt;
+
+  for (const auto &e : readDiscoveryCache(cacheFile))
+  {
+    if (e.key != key) continue;
+    auto clapPath = fs::u8path(e.path);
+    if (e.stamp != 0 && getCacheStamp(clapPath) == e.stamp)
+    {
+      return clapPath;
+    }
+    break;
+  }
+  return std::nullopt;
+}
+
+void storeDiscoveryCache(const std::string &key, const fs::path &clapPath)
+{
+  auto cacheFile = getDiscoveryCacheFile();
+  auto stamp = getCacheStamp(clapPath);
+  if (cacheFile.empty() || stamp == 0 || key.find_first_of("\t\n") != std::string::npos) return;
+
+  // the most recent entry goes last, the oldest are dropped beyond maxEntries
+  static constexpr size_t maxEntries{256};
+  auto entries = readDiscoveryCache(cacheFile);
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [&key](const auto &e) { return e.key == key; }),
+                entries.end());
+  entries.push_back({key, stamp, clapPath.u8string()});
+  if (entries.size() > maxEntries) entries.erase(entries.begin(), entries.end() - maxEntries);
+
+  std::ostringstream content;
+  for (const auto &e : entries)
+  {
+    content << e.key << '\t' << e.stamp << '\t' << e.path << '\n';
+  }
+  writeCacheFile(cacheFile, content.str());
+}
+
 bool Library::load(const fs::path &path)
 {
 #if MAC
@@ -25,6 +25,8 @@ namespace fs = std::filesystem;
 
 #include <vector>
 #include <functional>
+#include <optional>
+#include <string>
 #include <clap/clap.h>
 #if WIN
 #include <windows.h>
@@ -42,6 +44,19 @@ namespace Clap
 {
 
 std::vector<fs::path> getValidCLAPSearchPaths();
+
+// The discovery cache remembers where a wrapper found its .clap, so the search paths are only
+// walked on a miss. An entry is used as long as the file it points to has the modification
+// time it had when it was stored. The key is the name the wrapper looks for.
+std::optional<fs::path> lookupDiscoveryCache(const std::string& key);
+void storeDiscoveryCache(const std::string& key, const fs::path& clapPath);
+
+// the folder the wrappers keep their caches in, empty if the platform has none
+fs::path getCacheFolder();
+// the modification time a cache entry about the file or bundle is validated with, 0 if it's gone
+int64_t getCacheStamp(const fs::path& path);
+// replaces the file with the content, so a reader running in parallel sees the old or the new one
+bool writeCacheFile(const fs::path& file, const std::string& content);
 class Plugin;
 class IHost;
 
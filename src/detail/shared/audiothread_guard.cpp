@@ -0,0 +1,253 @@
+#include "audiothread_guard.h"
+
+#if CLAP_WRAPPER_AUDIOTHREAD_CHECKS
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if WIN
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+namespace ClapWrapper::detail::shared
+{
+
+// the name of the innermost section the thread is in, nullptr if not on the audio thread
+static thread_local const char* tl_section = nullptr;
+// set while a violation is being reported or a hook already checked the call
+static thread_local int tl_suppress = 0;
+
+static std::atomic<uint64_t> g_violations{0};
+
+// only the first reports get a stack trace, a plugin allocating in each block would flood the log otherwise
+static constexpr uint64_t kMaxStackTraces = 32;
+
+static void printStackSummary()
+{
+  constexpr int maxframes = 16;
+  void* frames[maxframes];
+#if WIN
+  auto numframes = CaptureStackBackTrace(2, maxframes, frames, nullptr);
+  for (auto i = 0; i < numframes; ++i)
+  {
+    fprintf(stderr, "    #%d %p\n", i, frames[i]);
+  }
+#else
+  auto numframes = backtrace(frames, maxframes);
+  if (numframes > 2)
+  {
+    // skip printStackSummary and checkAudioThread
+    backtrace_symbols_fd(frames + 2, numframes - 2, STDERR_FILENO);
+  }
+#endif
+}
+
+AudioThreadSection::AudioThreadSection(const char* name) : _previous(tl_section)
+{
+  tl_section = name;
+}
+
+AudioThreadSection::~AudioThreadSection()
+{
+  tl_section = _previous;
+}
+
+void checkAudioThread(const char* what)
+{
+  if (!tl_section || tl_suppress > 0)
+  {
+    return;
+  }
+
+  ++tl_suppress;
+  auto count = ++g_violations;
+  fprintf(stderr, "[clap-wrapper] audio thread violation #%llu: %s in %s\n", (unsigned long long)count,
+          what, tl_section);
+  if (count <= kMaxStackTraces)
+  {
+    printStackSummary();
+  }
+  --tl_suppress;
+}
+
+uint64_t audioThreadViolations()
+{
+  return g_violations;
+}
+
+static void* checkedAllocate(std::size_t size, const char* what)
+{
+  checkAudioThread(what);
+
+  // the allocator hooks (if any) would report this allocation a second time
+  ++tl_suppress;
+  auto result = std::malloc(size ? size : 1);
+  --tl_suppress;
+  return result;
+}
+
+static void* checkedAllocateAligned(std::size_t size, std::align_val_t alignment, const char* what)
+{
+  checkAudioThread(what);
+
+  // posix_memalign() requires at least the alignment of a pointer
+  auto align = static_cast<std::size_t>(alignment);
+  if (align < sizeof(void*))
+  {
+    align = sizeof(void*);
+  }
+
+  ++tl_suppress;
+#if WIN
+  auto result = _aligned_malloc(size ? size : 1, align);
+#else
+  void* result = nullptr;
+  if (posix_memalign(&result, align, size ? size : 1) != 0)
+  {
+    result = nullptr;
+  }
+#endif
+  --tl_suppress;
+  return result;
+}
+
+static void freeAligned(void* p)
+{
+#if WIN
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+}  // namespace ClapWrapper::detail::shared
+
+// the replaced global allocation functions. Within a plugin module they catch the allocations of the
+// wrapper (and of a statically linked CLAP), the standalone also hooks malloc for the whole process.
+
+void* operator new(std::size_t size)
+{
+  if (auto p = ClapWrapper::detail::shared::checkedAllocate(size, "operator new"))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  if (auto p = ClapWrapper::detail::shared::checkedAllocate(size, "operator new[]"))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return ClapWrapper::detail::shared::checkedAllocate(size, "operator new");
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return ClapWrapper::detail::shared::checkedAllocate(size, "operator new[]");
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  if (auto p = ClapWrapper::detail::shared::checkedAllocateAligned(size, alignment, "operator new"))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+  if (auto p = ClapWrapper::detail::shared::checkedAllocateAligned(size, alignment, "operator new[]"))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return ClapWrapper::detail::shared::checkedAllocateAligned(size, alignment, "operator new");
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return ClapWrapper::detail::shared::checkedAllocateAligned(size, alignment, "operator new[]");
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+// the aligned allocations come from _aligned_malloc() on Windows and need their own free
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  ClapWrapper::detail::shared::freeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  ClapWrapper::detail::shared::freeAligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  ClapWrapper::detail::shared::freeAligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+  ClapWrapper::detail::shared::freeAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  ClapWrapper::detail::shared::freeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  ClapWrapper::detail::shared::freeAligned(p);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+    audio thread guard
+
+    Marks the sections of the wrapper that run on the realtime audio thread. When the wrapper
+    is built with CLAP_WRAPPER_ENABLE_AUDIOTHREAD_CHECKS, allocations and mutex locks that happen
+    inside such a section - by the wrapper or the wrapped plugin - are reported on stderr
+    together with a short stack trace.
+
+    Without the option the section is an empty object and costs nothing.
+*/
+
+#include <cstdint>
+
+namespace ClapWrapper::detail::shared
+{
+
+#if CLAP_WRAPPER_AUDIOTHREAD_CHECKS
+
+class AudioThreadSection
+{
+ public:
+  explicit AudioThreadSection(const char* name);
+  ~AudioThreadSection();
+
+  AudioThreadSection(const AudioThreadSection&) = delete;
+  AudioThreadSection& operator=(const AudioThreadSection&) = delete;
+
+ private:
+  const char* _previous = nullptr;
+};
+
+// called by the allocation/lock hooks, reports if the calling thread is inside an AudioThreadSection
+void checkAudioThread(const char* what);
+
+// the number of violations reported so far
+uint64_t audioThreadViolations();
+
+#else
+
+class AudioThreadSection
+{
+ public:
+  explicit AudioThreadSection(const char* /*name*/)
+  {
+  }
+};
+
+#endif
+
+}  // namespace ClapWrapper::detail::shared
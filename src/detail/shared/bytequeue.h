@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+
+namespace ClapWrapper::detail::shared
+{
+
+/*
+ * A single producer, single consumer queue of variable sized records in a ring of Q bytes.
+ * Each record is stored as its size followed by the data, wrapping around the end of the
+ * ring, so nothing allocates and the consumer can copy a record straight to where it is
+ * needed.
+ */
+template <uint32_t Q>
+class bytequeue
+{
+ public:
+  // the record is the concatenation of both parts, returns false if it doesn't fit
+  inline bool push(const void* a, uint32_t asize, const void* b = nullptr, uint32_t bsize = 0)
+  {
+    auto size = asize + bsize;
+    auto head = _head.load(std::memory_order_relaxed);
+    auto tail = _tail.load(std::memory_order_acquire);
+    if (Q - (head - tail) < sizeof(uint32_t) + size)
+    {
+      return false;
+    }
+    write(head, &size, sizeof(uint32_t));
+    write(head + sizeof(uint32_t), a, asize);
+    if (bsize > 0)
+    {
+      write(head + sizeof(uint32_t) + asize, b, bsize);
+    }
+    _head.store(head + sizeof(uint32_t) + size, std::memory_order_release);
+    return true;
+  }
+
+  // the size of the front record, 0 if the queue is empty
+  inline uint32_t peekSize() const
+  {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    if (_head.load(std::memory_order_acquire) == tail)
+    {
+      return 0;
+    }
+    uint32_t size;
+    read(tail, &size, sizeof(uint32_t));
+    return size;
+  }
+
+  // copies size bytes from offset within the front record
+  inline void peek(void* out, uint32_t offset, uint32_t size) const
+  {
+    read(_tail.load(std::memory_order_relaxed) + sizeof(uint32_t) + offset, out, size);
+  }
+
+  // drops the front record
+  inline void pop()
+  {
+    auto size = peekSize();
+    auto tail = _tail.load(std::memory_order_relaxed);
+    _tail.store(tail + sizeof(uint32_t) + size, std::memory_order_release);
+  }
+
+  static constexpr uint32_t capacity()
+  {
+    return Q;
+  }
+
+ private:
+  inline void write(uint32_t pos, const void* data, uint32_t size)
+  {
+    auto at = pos & _wrapMask;
+    auto first = (size < Q - at) ? size : Q - at;
+    memcpy(_data + at, data, first);
+    memcpy(_data, (const uint8_t*)data + first, size - first);
+  }
+  inline void read(uint32_t pos, void* out, uint32_t size) const
+  {
+    auto at = pos & _wrapMask;
+    auto first = (size < Q - at) ? size : Q - at;
+    memcpy(out, _data + at, first);
+    memcpy((uint8_t*)out + first, _data, size - first);
+  }
+
+  uint8_t _data[Q] = {};
+  // free running byte counters, the ring position is taken modulo Q
+  std::atomic_uint32_t _head = 0u;
+  std::atomic_uint32_t _tail = 0u;
+
+  static constexpr uint32_t _wrapMask = Q - 1;
+  static_assert((Q & _wrapMask) == 0, "Q needs to be a power of 2");
+};
+}  // namespace ClapWrapper::detail::shared
@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+    denormals
+
+    Denormal numbers are handled in microcode on most CPUs and can make a decaying reverb
+    or filter tail many times more expensive than the signal itself. These helpers switch
+    the floating point unit of the calling thread to flush them to zero (FTZ) and treat
+    denormal inputs as zero (DAZ); on ARM the single FZ bit covers both.
+*/
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLAP_WRAPPER_DENORMALS_SSE 1
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define CLAP_WRAPPER_DENORMALS_AARCH64 1
+#endif
+
+namespace ClapWrapper::detail::shared
+{
+
+#if CLAP_WRAPPER_DENORMALS_SSE
+using fpu_state_t = unsigned int;
+// MXCSR flush to zero (bit 15) and denormals are zero (bit 6)
+static constexpr fpu_state_t kFlushDenormalsBits = 0x8040;
+inline fpu_state_t getFpuState()
+{
+  return _mm_getcsr();
+}
+inline void setFpuState(fpu_state_t state)
+{
+  _mm_setcsr(state);
+}
+#elif CLAP_WRAPPER_DENORMALS_AARCH64
+using fpu_state_t = uint64_t;
+// FPCR FZ (bit 24)
+static constexpr fpu_state_t kFlushDenormalsBits = 1ULL << 24;
+inline fpu_state_t getFpuState()
+{
+  fpu_state_t state;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(state));
+  return state;
+}
+inline void setFpuState(fpu_state_t state)
+{
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(state));
+}
+#else
+using fpu_state_t = unsigned int;
+static constexpr fpu_state_t kFlushDenormalsBits = 0;
+inline fpu_state_t getFpuState()
+{
+  return 0;
+}
+inline void setFpuState(fpu_state_t)
+{
+}
+#endif
+
+// true if the flags can be set on this platform
+inline constexpr bool canFlushDenormals()
+{
+  return kFlushDenormalsBits != 0;
+}
+
+// switches the calling thread to flush denormals for good, returns false if unsupported
+inline bool flushDenormals()
+{
+  if (!canFlushDenormals())
+  {
+    return false;
+  }
+  setFpuState(getFpuState() | kFlushDenormalsBits);
+  return true;
+}
+
+// flushes denormals for the lifetime of the object and then restores what the caller had,
+// for code running on threads the wrapper doesn't own
+class ScopedFlushDenormals
+{
+ public:
+  ScopedFlushDenormals() : _previous(getFpuState())
+  {
+    if ((_previous & kFlushDenormalsBits) != kFlushDenormalsBits)
+    {
+      setFpuState(_previous | kFlushDenormalsBits);
+    }
+  }
+  ~ScopedFlushDenormals()
+  {
+    if ((_previous & kFlushDenormalsBits) != kFlushDenormalsBits)
+    {
+      setFpuState(_previous);
+    }
+  }
+
+  ScopedFlushDenormals(const ScopedFlushDenormals&) = delete;
+  ScopedFlushDenormals& operator=(const ScopedFlushDenormals&) = delete;
+
+ private:
+  fpu_state_t _previous;
+};
+
+}  // namespace ClapWrapper::detail::shared
@@ -19,6 +19,10 @@ class fixedqueue
     _elements[_head] = *val;
     _head = (_head + 1) & _wrapMask;
   }
+  inline bool empty() const
+  {
+    return _head == _tail;
+  }
   inline bool pop(T& out)
   {
     if (_head == _tail)
@@ -0,0 +1,69 @@
+#include "aligned_memory.h"
+
+#include <cstring>
+#include <new>
+
+#if WIN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "standalone_details.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+bool AlignedMemory::allocate(size_t bytes, bool lock)
+{
+  release();
+  if (bytes == 0)
+  {
+    return true;
+  }
+
+  bytes = alignedCount<unsigned char>(bytes);
+  _data = ::operator new(bytes, std::align_val_t{alignment}, std::nothrow);
+  if (!_data)
+  {
+    LOG << "[ERROR] Unable to allocate " << bytes << " bytes" << std::endl;
+    return false;
+  }
+  _bytes = bytes;
+  // this also touches every page, so they are resident before the audio thread starts
+  memset(_data, 0, _bytes);
+
+  if (lock)
+  {
+#if WIN
+    _locked = VirtualLock(_data, _bytes) != 0;
+#else
+    _locked = mlock(_data, _bytes) == 0;
+#endif
+    if (!_locked)
+    {
+      LOG << "[WARNING] Unable to lock " << _bytes << " bytes in memory" << std::endl;
+    }
+  }
+  return true;
+}
+
+void AlignedMemory::release()
+{
+  if (!_data)
+  {
+    return;
+  }
+  if (_locked)
+  {
+#if WIN
+    VirtualUnlock(_data, _bytes);
+#else
+    munlock(_data, _bytes);
+#endif
+    _locked = false;
+  }
+  ::operator delete(_data, std::align_val_t{alignment}, std::nothrow);
+  _data = nullptr;
+  _bytes = 0;
+}
+}  // namespace freeaudio::clap_wrapper::standalone
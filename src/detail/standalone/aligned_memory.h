@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+ * A zeroed block of cache line aligned memory which can optionally be locked into
+ * physical memory, so the audio thread never takes a page fault on it.
+ */
+
+#include <cstddef>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+class AlignedMemory
+{
+ public:
+  static constexpr size_t alignment{64};
+
+  AlignedMemory() = default;
+  ~AlignedMemory()
+  {
+    release();
+  }
+  AlignedMemory(const AlignedMemory &) = delete;
+  AlignedMemory &operator=(const AlignedMemory &) = delete;
+
+  // replaces the current block, returns false if the allocation failed. A failed lock is
+  // only logged since the memory is still usable.
+  bool allocate(size_t bytes, bool lock);
+  void release();
+
+  template <typename T>
+  T *as() const
+  {
+    return static_cast<T *>(_data);
+  }
+  size_t size() const
+  {
+    return _bytes;
+  }
+  bool isLocked() const
+  {
+    return _locked;
+  }
+
+  // rounds a number of elements up so consecutive rows stay cache line aligned
+  template <typename T>
+  static constexpr size_t alignedCount(size_t count)
+  {
+    constexpr auto perLine = alignment / sizeof(T);
+    return (count + perLine - 1) / perLine * perLine;
+  }
+
+ private:
+  void *_data{nullptr};
+  size_t _bytes{0};
+  bool _locked{false};
+};
+}  // namespace freeaudio::clap_wrapper::standalone
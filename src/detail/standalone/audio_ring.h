@@ -0,0 +1,154 @@
+#pragma once
+
+/*
+ * A lock-free single producer, single consumer ring of planar audio. Each channel is a row of
+ * capacity frames, the read and write positions count frames since the ring was allocated and
+ * only their difference matters. A ring without channels still counts the frames, which keeps
+ * the plugin block clock running for a stream without inputs.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "aligned_memory.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+class AudioRing
+{
+ public:
+  // only while neither side uses the ring, the capacity is rounded up to a power of two
+  bool allocate(uint32_t channels, uint32_t minFrames, bool lock)
+  {
+    _capacity = 1;
+    while (_capacity < minFrames) _capacity <<= 1;
+    _channels = channels;
+    _stride = (uint32_t)AlignedMemory::alignedCount<float>(_capacity);
+    _readPos.store(0, std::memory_order_relaxed);
+    _writePos.store(0, std::memory_order_relaxed);
+    return _channels == 0 || _memory.allocate(sizeof(float) * _channels * _stride, lock);
+  }
+
+  uint32_t channels() const
+  {
+    return _channels;
+  }
+  uint32_t readable() const
+  {
+    return (uint32_t)(_writePos.load(std::memory_order_acquire) -
+                      _readPos.load(std::memory_order_relaxed));
+  }
+  uint32_t writable() const
+  {
+    return _capacity - (uint32_t)(_writePos.load(std::memory_order_relaxed) -
+                                  _readPos.load(std::memory_order_acquire));
+  }
+
+  // producer side, frames has to be at most writable()
+  void write(const float *const *src, uint32_t frames)
+  {
+    auto pos = _writePos.load(std::memory_order_relaxed);
+    segments(pos, frames,
+             [&](uint32_t at, uint32_t offset, uint32_t n)
+             {
+               for (auto c = 0U; c < _channels; ++c)
+               {
+                 memcpy(row(c) + at, src[c] + offset, n * sizeof(float));
+               }
+             });
+    _writePos.store(pos + frames, std::memory_order_release);
+  }
+  void writeInterleaved(const float *src, uint32_t frames)
+  {
+    auto pos = _writePos.load(std::memory_order_relaxed);
+    segments(pos, frames,
+             [&](uint32_t at, uint32_t offset, uint32_t n)
+             {
+               for (auto c = 0U; c < _channels; ++c)
+               {
+                 auto *dst = row(c) + at;
+                 const auto *s = src + offset * _channels + c;
+                 for (auto i = 0U; i < n; ++i) dst[i] = s[i * _channels];
+               }
+             });
+    _writePos.store(pos + frames, std::memory_order_release);
+  }
+  void writeSilence(uint32_t frames)
+  {
+    auto pos = _writePos.load(std::memory_order_relaxed);
+    segments(pos, frames,
+             [&](uint32_t at, uint32_t, uint32_t n)
+             {
+               for (auto c = 0U; c < _channels; ++c)
+               {
+                 memset(row(c) + at, 0, n * sizeof(float));
+               }
+             });
+    _writePos.store(pos + frames, std::memory_order_release);
+  }
+
+  // consumer side, frames has to be at most readable()
+  void read(float *const *dst, uint32_t frames)
+  {
+    auto pos = _readPos.load(std::memory_order_relaxed);
+    segments(pos, frames,
+             [&](uint32_t at, uint32_t offset, uint32_t n)
+             {
+               for (auto c = 0U; c < _channels; ++c)
+               {
+                 memcpy(dst[c] + offset, row(c) + at, n * sizeof(float));
+               }
+             });
+    _readPos.store(pos + frames, std::memory_order_release);
+  }
+  void readInterleaved(float *dst, uint32_t frames)
+  {
+    auto pos = _readPos.load(std::memory_order_relaxed);
+    segments(pos, frames,
+             [&](uint32_t at, uint32_t offset, uint32_t n)
+             {
+               for (auto c = 0U; c < _channels; ++c)
+               {
+                 const auto *src = row(c) + at;
+                 auto *d = dst + offset * _channels + c;
+                 for (auto i = 0U; i < n; ++i) d[i * _channels] = src[i];
+               }
+             });
+    _readPos.store(pos + frames, std::memory_order_release);
+  }
+  void skip(uint32_t frames)
+  {
+    _readPos.store(_readPos.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+  }
+
+ private:
+  float *row(uint32_t channel) const
+  {
+    return _memory.as<float>() + channel * _stride;
+  }
+  // calls f(ring index, offset in the block, frames) for the parts before and after the wrap
+  template <typename F>
+  void segments(uint64_t pos, uint32_t frames, F &&f) const
+  {
+    if (_channels == 0 || frames == 0)
+    {
+      return;
+    }
+    auto at = (uint32_t)(pos & (_capacity - 1));
+    auto first = std::min(frames, _capacity - at);
+    f(at, 0, first);
+    if (first < frames)
+    {
+      f(0, first, frames - first);
+    }
+  }
+
+  AlignedMemory _memory;
+  uint32_t _channels{0}, _capacity{1}, _stride{0};
+  // on cache lines of their own, each is written by one side only
+  alignas(AlignedMemory::alignment) std::atomic<uint64_t> _readPos{0};
+  alignas(AlignedMemory::alignment) std::atomic<uint64_t> _writePos{0};
+};
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,152 @@
+#include "audio_stats.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+void AudioStats::reset()
+{
+  blocks = 0;
+  xruns = 0;
+  underflows = 0;
+  overflows = 0;
+  loadSum = 0;
+  loadMin = UINT32_MAX;
+  loadMax = 0;
+  for (auto &b : loadHistogram) b = 0;
+  lastCallbackStart = 0;
+  jitterSamples = 0;
+  jitterSumUs = 0;
+  jitterMaxUs = 0;
+  for (auto &b : jitterHistogram) b = 0;
+}
+
+void AudioStats::recordBlock(int64_t callbackStartNanoseconds, int64_t processNanoseconds,
+                             uint32_t frames, int32_t sampleRate, bool xrun)
+{
+  if (frames == 0 || sampleRate <= 0)
+  {
+    return;
+  }
+  auto periodNanoseconds = (int64_t)frames * 1000000000LL / sampleRate;
+
+  auto load =
+      (uint32_t)std::min<int64_t>(processNanoseconds * 1000000LL / periodNanoseconds, UINT32_MAX);
+  bump(loadSum, (uint64_t)load);
+  if (load < loadMin.load(std::memory_order_relaxed)) loadMin.store(load, std::memory_order_relaxed);
+  if (load > loadMax.load(std::memory_order_relaxed)) loadMax.store(load, std::memory_order_relaxed);
+  bump(loadHistogram[std::min(load / 10000, loadBins - 1)]);
+
+  if (lastCallbackStart != 0)
+  {
+    auto jitterUs =
+        (uint64_t)std::llabs(callbackStartNanoseconds - lastCallbackStart - periodNanoseconds) / 1000;
+    bump(jitterSamples);
+    bump(jitterSumUs, jitterUs);
+    if (jitterUs > jitterMaxUs.load(std::memory_order_relaxed))
+    {
+      jitterMaxUs.store(jitterUs, std::memory_order_relaxed);
+    }
+    bump(jitterHistogram[std::min((uint32_t)(jitterUs / jitterBinMicroseconds), jitterBins - 1)]);
+  }
+  lastCallbackStart = callbackStartNanoseconds;
+
+  if (xrun) bump(xruns);
+  // last, so a reader never sees more blocks than histogram entries
+  bump(blocks);
+}
+
+void AudioStats::recordDeviceXrun(bool isUnderflow)
+{
+  (isUnderflow ? underflows : overflows)++;
+}
+
+// the upper edge of the bin which contains the given fraction of all entries
+template <size_t N>
+static double percentile(const std::atomic<uint32_t> (&histogram)[N], double fraction, double binWidth)
+{
+  uint64_t total{0};
+  uint32_t counts[N];
+  for (auto i = 0U; i < N; ++i)
+  {
+    counts[i] = histogram[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0)
+  {
+    return 0;
+  }
+  auto target = (uint64_t)(fraction * total);
+  uint64_t sum{0};
+  for (auto i = 0U; i < N; ++i)
+  {
+    sum += counts[i];
+    if (sum > target)
+    {
+      return (i + 1) * binWidth;
+    }
+  }
+  return N * binWidth;
+}
+
+AudioStats::Summary AudioStats::summary() const
+{
+  Summary s;
+  s.blocks = blocks.load(std::memory_order_relaxed);
+  s.xruns = xruns.load(std::memory_order_relaxed);
+  s.underflows = underflows.load(std::memory_order_relaxed);
+  s.overflows = overflows.load(std::memory_order_relaxed);
+  if (s.blocks > 0)
+  {
+    // load is kept in parts per million and reported in percent
+    s.loadMin = loadMin.load(std::memory_order_relaxed) / 10000.0;
+    s.loadMax = loadMax.load(std::memory_order_relaxed) / 10000.0;
+    s.loadAvg = loadSum.load(std::memory_order_relaxed) / 10000.0 / s.blocks;
+    // a percentile is the upper edge of its bin, which may lie above the actual maximum
+    s.loadP50 = std::min(percentile(loadHistogram, 0.50, 1.0), s.loadMax);
+    s.loadP95 = std::min(percentile(loadHistogram, 0.95, 1.0), s.loadMax);
+    s.loadP99 = std::min(percentile(loadHistogram, 0.99, 1.0), s.loadMax);
+  }
+  auto js = jitterSamples.load(std::memory_order_relaxed);
+  if (js > 0)
+  {
+    s.jitterAvgUs = (double)jitterSumUs.load(std::memory_order_relaxed) / js;
+    s.jitterMaxUs = (double)jitterMaxUs.load(std::memory_order_relaxed);
+    s.jitterP50Us = std::min(percentile(jitterHistogram, 0.50, jitterBinMicroseconds), s.jitterMaxUs);
+    s.jitterP95Us = std::min(percentile(jitterHistogram, 0.95, jitterBinMicroseconds), s.jitterMaxUs);
+    s.jitterP99Us = std::min(percentile(jitterHistogram, 0.99, jitterBinMicroseconds), s.jitterMaxUs);
+  }
+  return s;
+}
+
+std::string AudioStats::toString(const Summary &s)
+{
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(1) << "xruns " << s.xruns << " (underflows " << s.underflows
+      << " overflows " << s.overflows << ") load " << s.loadAvg << "% avg " << s.loadMax
+      << "% max " << s.loadP99 << "% p99, jitter " << s.jitterAvgUs << "us avg " << s.jitterMaxUs
+      << "us max " << s.jitterP99Us << "us p99";
+  return oss.str();
+}
+
+std::string AudioStats::toJSON(const Summary &s)
+{
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(2) << "{\n"
+      << "  \"blocks\": " << s.blocks << ",\n"
+      << "  \"xruns\": " << s.xruns << ",\n"
+      << "  \"underflows\": " << s.underflows << ",\n"
+      << "  \"overflows\": " << s.overflows << ",\n"
+      << "  \"load_percent\": { \"min\": " << s.loadMin << ", \"avg\": " << s.loadAvg
+      << ", \"max\": " << s.loadMax << ", \"p50\": " << s.loadP50 << ", \"p95\": " << s.loadP95
+      << ", \"p99\": " << s.loadP99 << " },\n"
+      << "  \"jitter_us\": { \"avg\": " << s.jitterAvgUs << ", \"max\": " << s.jitterMaxUs
+      << ", \"p50\": " << s.jitterP50Us << ", \"p95\": " << s.jitterP95Us
+      << ", \"p99\": " << s.jitterP99Us << " }\n"
+      << "}\n";
+  return oss.str();
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * Telemetry of the standalone audio callback: xruns, the jitter of the callback period and
+ * the DSP load, which is the time spent in clapProcess relative to the buffer duration.
+ *
+ * The audio thread is the only writer of the block statistics and uses relaxed atomic
+ * stores, the device error callback only increments its own counters. Any other thread can
+ * read a summary at any time without locking, the percentiles come from fixed histograms.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct AudioStats
+{
+  // the load in percent, the last bin collects everything above
+  static constexpr uint32_t loadBins{256};
+  // the deviation from the expected callback period, jitterBinMicroseconds wide
+  static constexpr uint32_t jitterBins{256};
+  static constexpr uint32_t jitterBinMicroseconds{50};
+
+  // only while no stream is running
+  void reset();
+
+  // audio thread: one callback, timed from its start for processNanoseconds
+  void recordBlock(int64_t callbackStartNanoseconds, int64_t processNanoseconds, uint32_t frames,
+                   int32_t sampleRate, bool xrun);
+  // device error callback
+  void recordDeviceXrun(bool isUnderflow);
+
+  struct Summary
+  {
+    uint64_t blocks{0}, xruns{0}, underflows{0}, overflows{0};
+    double loadMin{0}, loadAvg{0}, loadMax{0}, loadP50{0}, loadP95{0}, loadP99{0};
+    double jitterAvgUs{0}, jitterMaxUs{0}, jitterP50Us{0}, jitterP95Us{0}, jitterP99Us{0};
+  };
+  Summary summary() const;
+
+  static std::string toString(const Summary &s);
+  static std::string toJSON(const Summary &s);
+
+ private:
+  template <typename T>
+  static void bump(std::atomic<T> &a, T by = 1)
+  {
+    a.store(a.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> blocks{0}, xruns{0};
+  std::atomic<uint64_t> underflows{0}, overflows{0};
+
+  // in parts per million of the buffer duration
+  std::atomic<uint64_t> loadSum{0};
+  std::atomic<uint32_t> loadMin{UINT32_MAX}, loadMax{0};
+  std::atomic<uint32_t> loadHistogram[loadBins]{};
+
+  int64_t lastCallbackStart{0};
+  std::atomic<uint64_t> jitterSamples{0}, jitterSumUs{0}, jitterMaxUs{0};
+  std::atomic<uint32_t> jitterHistogram[jitterBins]{};
+};
+}  // namespace freeaudio::clap_wrapper::standalone
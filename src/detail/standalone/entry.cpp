@@ -12,7 +12,8 @@ std::shared_ptr<Clap::Plugin> plugin;
 const clap_plugin_entry *entry{nullptr};
 
 std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *ee, const std::string &clapId,
-                                               uint32_t clapIndex, int argc, char **argv)
+                                               uint32_t clapIndex, int argc, char **argv,
+                                               bool loadSettings)
 {
   entry = ee;
   LOG << "Standalone starting : " << argv[0] << std::endl;
@@ -56,7 +57,7 @@ std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *ee, cons
   plugin->initialize();
 
   auto pt = getStandaloneSettingsPath();
-  if (pt.has_value())
+  if (pt.has_value() && loadSettings)
   {
     auto loadPath = *pt / plugin->_plugin->desc->id;
     try
@@ -66,6 +67,10 @@ std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *ee, cons
         LOG << "Trying to load from clap wrapper settings" << std::endl;
         standaloneHost->tryLoadStandaloneAndPluginSettings(loadPath, "settings.clapwrapper");
       }
+      if (fs::exists(loadPath / "standalone.clapwrapper"))
+      {
+        standaloneHost->tryLoadStandaloneSettings(loadPath, "standalone.clapwrapper");
+      }
     }
     catch (const fs::filesystem_error &e)
     {
@@ -78,10 +83,35 @@ std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *ee, cons
 
 void mainStartAudio()
 {
+  if (!standaloneHost->loadGraph())
+  {
+    LOG << "[WARNING] Running the plugin without the graph" << std::endl;
+  }
   standaloneHost->startMIDIThread();
   standaloneHost->startAudioThread();
 }
 
+int mainRender(const RenderSettings &settings)
+{
+  if (!standaloneHost || !plugin)
+  {
+    return 3;
+  }
+  if (!settings.graph.empty())
+  {
+    standaloneHost->setGraphFile(settings.graph);
+    if (!standaloneHost->loadGraph())
+    {
+      return 2;
+    }
+  }
+  if (settings.benchmarkSeconds > 0)
+  {
+    return standaloneHost->runBenchmark(settings);
+  }
+  return standaloneHost->renderOffline(settings);
+}
+
 std::shared_ptr<Clap::Plugin> getMainPlugin()
 {
   return plugin;
@@ -102,11 +132,12 @@ int mainWait()
   {
     using namespace std::chrono_literals;
     std::this_thread::sleep_for(1s);
+    standaloneHost->pollAudioStats();
   }
   return 0;
 }
 
-int mainFinish()
+int mainFinish(bool saveSettings)
 {
   LOG << "Shutting down" << std::endl;
 
@@ -116,7 +147,11 @@ int mainFinish()
     standaloneHost->stopMIDIThread();
 
     auto pt = getStandaloneSettingsPath();
-    if (pt.has_value())
+    if (!saveSettings)
+    {
+      LOG << "Not saving settings" << std::endl;
+    }
+    else if (pt.has_value())
     {
       auto savePath = *pt / plugin->_plugin->desc->id;
       LOG << "Saving settings to '" << savePath << "'" << std::endl;
@@ -124,6 +159,7 @@ int mainFinish()
       {
         fs::create_directories(savePath);
         standaloneHost->saveStandaloneAndPluginSettings(savePath, "settings.clapwrapper");
+        standaloneHost->saveStandaloneSettings(savePath, "standalone.clapwrapper");
       }
       catch (const fs::filesystem_error &e)
       {
@@ -135,6 +171,7 @@ int mainFinish()
       LOG << "No Standalone Settings Path; not streaming" << std::endl;
     }
 
+    standaloneHost->unloadGraph();
     plugin->deactivate();
   }
   plugin.reset();
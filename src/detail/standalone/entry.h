@@ -4,11 +4,17 @@
 #include <clap_proxy.h>
 #include <string>
 
+#include "render.h"
+
 namespace freeaudio::clap_wrapper::standalone
 {
+// without loadSettings the plugin starts from its defaults rather than the saved settings
 std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *entry, const std::string &clapId,
-                                               uint32_t clapIndex, int argc, char **argv);
+                                               uint32_t clapIndex, int argc, char **argv,
+                                               bool loadSettings = true);
 void mainStartAudio();
+// the offline render or the benchmark instead of mainStartAudio, returns the exit code
+int mainRender(const RenderSettings &settings);
 
 std::shared_ptr<Clap::Plugin> getMainPlugin();
 
@@ -16,5 +22,5 @@ struct StandaloneHost;
 StandaloneHost *getStandaloneHost();
 
 int mainWait();
-int mainFinish();
+int mainFinish(bool saveSettings = true);
 }  // namespace freeaudio::clap_wrapper::standalone
\ No newline at end of file
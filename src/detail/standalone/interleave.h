@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+ * Interleave / deinterleave kernels for the standalone. These are only used if the
+ * audio stream could not be opened non interleaved, the stereo case is vectorized.
+ */
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLAP_WRAPPER_INTERLEAVE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CLAP_WRAPPER_INTERLEAVE_NEON 1
+#endif
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+inline void deinterleaveStereo(const float *src, float *left, float *right, uint32_t frames)
+{
+  uint32_t i{0};
+#if CLAP_WRAPPER_INTERLEAVE_SSE2
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto a = _mm_loadu_ps(src + 2 * i);      // L0 R0 L1 R1
+    auto b = _mm_loadu_ps(src + 2 * i + 4);  // L2 R2 L3 R3
+    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#elif CLAP_WRAPPER_INTERLEAVE_NEON
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto lr = vld2q_f32(src + 2 * i);
+    vst1q_f32(left + i, lr.val[0]);
+    vst1q_f32(right + i, lr.val[1]);
+  }
+#endif
+  for (; i < frames; ++i)
+  {
+    left[i] = src[2 * i];
+    right[i] = src[2 * i + 1];
+  }
+}
+
+inline void interleaveStereo(const float *left, const float *right, float *dst, uint32_t frames)
+{
+  uint32_t i{0};
+#if CLAP_WRAPPER_INTERLEAVE_SSE2
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto l = _mm_loadu_ps(left + i);
+    auto r = _mm_loadu_ps(right + i);
+    _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+  }
+#elif CLAP_WRAPPER_INTERLEAVE_NEON
+  for (; i + 4 <= frames; i += 4)
+  {
+    float32x4x2_t lr;
+    lr.val[0] = vld1q_f32(left + i);
+    lr.val[1] = vld1q_f32(right + i);
+    vst2q_f32(dst + 2 * i, lr);
+  }
+#endif
+  for (; i < frames; ++i)
+  {
+    dst[2 * i] = left[i];
+    dst[2 * i + 1] = right[i];
+  }
+}
+
+// copies numChannels channels out of an interleaved buffer with srcChannels channels
+inline void deinterleave(const float *src, uint32_t srcChannels, float *const *dst, uint32_t numChannels,
+                         uint32_t frames)
+{
+  if (srcChannels == 2 && numChannels == 2)
+  {
+    deinterleaveStereo(src, dst[0], dst[1], frames);
+    return;
+  }
+  for (auto c = 0U; c < numChannels && c < srcChannels; ++c)
+  {
+    for (auto i = 0U; i < frames; ++i)
+    {
+      dst[c][i] = src[i * srcChannels + c];
+    }
+  }
+}
+
+// writes numChannels channels into an interleaved buffer with dstChannels channels, the
+// remaining channels are cleared
+inline void interleave(const float *const *src, uint32_t numChannels, float *dst, uint32_t dstChannels,
+                       uint32_t frames)
+{
+  if (numChannels == 2 && dstChannels == 2)
+  {
+    interleaveStereo(src[0], src[1], dst, frames);
+    return;
+  }
+  for (auto i = 0U; i < frames; ++i)
+  {
+    for (auto c = 0U; c < dstChannels; ++c)
+    {
+      dst[i * dstChannels + c] = (c < numChannels) ? src[c][i] : 0.f;
+    }
+  }
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,127 @@
+/*
+    libc hooks for the audio thread checks
+
+    The standalone is an executable, so the symbols defined here take precedence over the
+    ones from libc for the whole process - including the hosted CLAP. Each hook reports if it
+    is called from within an AudioThreadSection and forwards to the real implementation.
+
+    Only built with CLAP_WRAPPER_ENABLE_AUDIOTHREAD_CHECKS on glibc based systems.
+*/
+
+#include "detail/shared/audiothread_guard.h"
+
+#if CLAP_WRAPPER_AUDIOTHREAD_CHECKS && defined(__GLIBC__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+using ClapWrapper::detail::shared::checkAudioThread;
+
+extern "C"
+{
+  // the glibc internal entry points, calling those avoids the dlsym() bootstrapping problem for malloc
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t num, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace
+{
+// dlsym() may allocate, so the real functions are resolved lazily and without static initializer guards
+template <typename F>
+F realFunction(std::atomic<F>& cache, const char* name)
+{
+  auto fn = cache.load(std::memory_order_relaxed);
+  if (!fn)
+  {
+    fn = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+    cache.store(fn, std::memory_order_relaxed);
+  }
+  return fn;
+}
+
+using mutex_lock_fn = int (*)(pthread_mutex_t*);
+using nanosleep_fn = int (*)(const struct timespec*, struct timespec*);
+using usleep_fn = int (*)(useconds_t);
+
+std::atomic<mutex_lock_fn> realMutexLock{nullptr};
+std::atomic<nanosleep_fn> realNanosleep{nullptr};
+std::atomic<usleep_fn> realUsleep{nullptr};
+}  // namespace
+
+extern "C"
+{
+  __attribute__((visibility("default"))) void* malloc(size_t size) noexcept
+  {
+    checkAudioThread("malloc");
+    return __libc_malloc(size);
+  }
+
+  __attribute__((visibility("default"))) void* calloc(size_t num, size_t size) noexcept
+  {
+    checkAudioThread("calloc");
+    return __libc_calloc(num, size);
+  }
+
+  __attribute__((visibility("default"))) void* realloc(void* ptr, size_t size) noexcept
+  {
+    checkAudioThread("realloc");
+    return __libc_realloc(ptr, size);
+  }
+
+  __attribute__((visibility("default"))) void* memalign(size_t alignment, size_t size) noexcept
+  {
+    checkAudioThread("memalign");
+    return __libc_memalign(alignment, size);
+  }
+
+  __attribute__((visibility("default"))) void* aligned_alloc(size_t alignment, size_t size) noexcept
+  {
+    checkAudioThread("aligned_alloc");
+    return __libc_memalign(alignment, size);
+  }
+
+  __attribute__((visibility("default"))) int posix_memalign(void** memptr, size_t alignment,
+                                                            size_t size) noexcept
+  {
+    checkAudioThread("posix_memalign");
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0)
+    {
+      return EINVAL;
+    }
+    auto p = __libc_memalign(alignment, size);
+    if (!p)
+    {
+      return ENOMEM;
+    }
+    *memptr = p;
+    return 0;
+  }
+
+  __attribute__((visibility("default"))) int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+  {
+    checkAudioThread("pthread_mutex_lock");
+    return realFunction(realMutexLock, "pthread_mutex_lock")(mutex);
+  }
+
+  __attribute__((visibility("default"))) int nanosleep(const struct timespec* req, struct timespec* rem)
+  {
+    checkAudioThread("nanosleep");
+    return realFunction(realNanosleep, "nanosleep")(req, rem);
+  }
+
+  __attribute__((visibility("default"))) int usleep(useconds_t usec)
+  {
+    checkAudioThread("usleep");
+    return realFunction(realUsleep, "usleep")(usec);
+  }
+}
+
+#endif
@@ -100,6 +100,12 @@ void GtkGui::setupPlugin(_GtkApplication *app)
     gtk_widget_set_size_request(frame, w, h);
     gtk_box_pack_start(GTK_BOX(vbox), frame, TRUE, TRUE, 0);
 
+    setupTransportControls(vbox);
+
+    statsLabel = gtk_label_new("");
+    gtk_label_set_xalign(GTK_LABEL(statsLabel), 0);
+    gtk_box_pack_start(GTK_BOX(vbox), statsLabel, FALSE, FALSE, 0);
+
     g_signal_connect(window, "configure-event", G_CALLBACK(onResize), this);
 
     gtk_widget_show_all(window);
@@ -113,11 +119,102 @@ void GtkGui::setupPlugin(_GtkApplication *app)
   }
 }
 
+static void onTransportChanged(GtkWidget *, gpointer user_data)
+{
+  auto g = (GtkGui *)user_data;
+  g->transportChanged();
+}
+
+static void onTransportRewind(GtkWidget *, gpointer)
+{
+  freeaudio::clap_wrapper::standalone::getStandaloneHost()->rewindTransport();
+}
+
+void GtkGui::setupTransportControls(GtkWidget *box)
+{
+  const auto &ts = freeaudio::clap_wrapper::standalone::getStandaloneHost()->transportSettings;
+
+  GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+  gtk_box_pack_start(GTK_BOX(box), hbox, FALSE, FALSE, 0);
+
+  auto rewindButton = gtk_button_new_with_label("|<");
+  g_signal_connect(rewindButton, "clicked", G_CALLBACK(onTransportRewind), this);
+  gtk_box_pack_start(GTK_BOX(hbox), rewindButton, FALSE, FALSE, 0);
+
+  playButton = gtk_toggle_button_new_with_label("Play");
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(playButton), ts.playing);
+  gtk_box_pack_start(GTK_BOX(hbox), playButton, FALSE, FALSE, 0);
+
+  auto addSpin = [hbox](const char *label, double min, double max, double step, int digits,
+                        double value)
+  {
+    if (label)
+    {
+      gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new(label), FALSE, FALSE, 0);
+    }
+    auto spin = gtk_spin_button_new_with_range(min, max, step);
+    gtk_spin_button_set_digits(GTK_SPIN_BUTTON(spin), digits);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin), value);
+    gtk_box_pack_start(GTK_BOX(hbox), spin, FALSE, FALSE, 0);
+    return spin;
+  };
+  tempoSpin = addSpin("Tempo", 20, 999, 1, 2, ts.tempo);
+  tsigNumSpin = addSpin("Time Signature", 1, 64, 1, 0, ts.tsigNum);
+  tsigDenomSpin = addSpin("/", 1, 64, 1, 0, ts.tsigDenom);
+
+  loopCheck = gtk_check_button_new_with_label("Loop");
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(loopCheck), ts.loopActive);
+  gtk_box_pack_start(GTK_BOX(hbox), loopCheck, FALSE, FALSE, 0);
+  loopStartSpin = addSpin(nullptr, 0, 100000, 1, 2, ts.loopStartBeats);
+  loopEndSpin = addSpin("to", 0, 100000, 1, 2, ts.loopEndBeats);
+  gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new("beats"), FALSE, FALSE, 0);
+
+  g_signal_connect(playButton, "toggled", G_CALLBACK(onTransportChanged), this);
+  g_signal_connect(loopCheck, "toggled", G_CALLBACK(onTransportChanged), this);
+  for (auto spin : {tempoSpin, tsigNumSpin, tsigDenomSpin, loopStartSpin, loopEndSpin})
+  {
+    g_signal_connect(spin, "value-changed", G_CALLBACK(onTransportChanged), this);
+  }
+}
+
+void GtkGui::transportChanged()
+{
+  auto sah = freeaudio::clap_wrapper::standalone::getStandaloneHost();
+  auto ts = sah->transportSettings;
+  ts.playing = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(playButton));
+  ts.tempo = gtk_spin_button_get_value(GTK_SPIN_BUTTON(tempoSpin));
+  ts.tsigNum = (uint16_t)gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(tsigNumSpin));
+  ts.tsigDenom = (uint16_t)gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(tsigDenomSpin));
+  ts.loopActive = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(loopCheck));
+  ts.loopStartBeats = gtk_spin_button_get_value(GTK_SPIN_BUTTON(loopStartSpin));
+  ts.loopEndBeats = gtk_spin_button_get_value(GTK_SPIN_BUTTON(loopEndSpin));
+  sah->setTransport(ts);
+}
+
+static int gstatscb(void *ud)
+{
+  auto g = (GtkGui *)ud;
+  return g->updateAudioStats();
+}
+
+int GtkGui::updateAudioStats()
+{
+  auto sah = freeaudio::clap_wrapper::standalone::getStandaloneHost();
+  sah->pollAudioStats();
+  if (statsLabel)
+  {
+    auto txt = AudioStats::toString(sah->audioStats.summary());
+    gtk_label_set_text(GTK_LABEL(statsLabel), txt.c_str());
+  }
+  return true;
+}
+
 void GtkGui::initialize(freeaudio::clap_wrapper::standalone::StandaloneHost *sah)
 {
   sah->gtkGui = this;
   app = gtk_application_new("org.gtk.example", G_APPLICATION_FLAGS_NONE);
   g_signal_connect(app, "activate", G_CALLBACK(activate), this);
+  g_timeout_add(1000, gstatscb, this);
 }
 
 void GtkGui::setPlugin(std::shared_ptr<Clap::Plugin> p)
@@ -235,6 +332,19 @@ bool GtkGui::parseCommandLine(int argc, char **argv)
   bool list_devices{false};
   int sampleRate{s};
   unsigned int inId{i}, outId{o};
+  gchar *bufferSize{nullptr}, *pluginBlock{nullptr};
+  gchar *inputRouting{nullptr}, *outputRouting{nullptr};
+  gboolean lockMemory{false};
+  gint rtPriority{sah->audioThreadPriority}, cpu{sah->audioThreadCpu};
+  gboolean keepDenormals{false};
+  gchar *statsFile{nullptr};
+  gchar *midiLatency{nullptr};
+  gchar *midiOutput{nullptr};
+  gchar *nullAudio{nullptr};
+  gchar *graphFile{nullptr};
+  gdouble tempo{sah->transportSettings.tempo};
+  gchar *timeSignature{nullptr}, *loop{nullptr};
+  gboolean stopped{false};
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -247,6 +357,41 @@ bool GtkGui::parseCommandLine(int argc, char **argv)
       {"sample-rate", 's', 0, G_OPTION_ARG_INT, &sampleRate, "Sample Rate", nullptr},
       {"input-device", 'i', 0, G_OPTION_ARG_INT, &inId, "Input Device (0 for no input)", nullptr},
       {"output-device", 'o', 0, G_OPTION_ARG_INT, &outId, "Output Device (0 for no input)", nullptr},
+      {"buffer-size", 'b', 0, G_OPTION_ARG_STRING, &bufferSize,
+       "Buffer Size in samples or 'auto' to pick the smallest one without dropouts", "N|auto"},
+      {"plugin-block", 0, 0, G_OPTION_ARG_STRING, &pluginBlock,
+       "Run the plugin on its own thread in blocks of this size, at the cost of two blocks of latency",
+       "N"},
+      {"input-routing", 0, 0, G_OPTION_ARG_STRING, &inputRouting,
+       "Device input channel of each plugin input channel", "PORT:CHAN=DEVCHAN,..."},
+      {"output-routing", 0, 0, G_OPTION_ARG_STRING, &outputRouting,
+       "Device output channel of each plugin output channel", "PORT:CHAN=DEVCHAN,..."},
+      {"lock-memory", 0, 0, G_OPTION_ARG_NONE, &lockMemory,
+       "Lock the audio buffers in memory so they can't be paged out", nullptr},
+      {"rt-priority", 0, 0, G_OPTION_ARG_INT, &rtPriority,
+       "SCHED_FIFO priority of the audio thread (0 to leave it to the audio device)", "N"},
+      {"cpu", 0, 0, G_OPTION_ARG_INT, &cpu, "Pin the audio thread to this cpu (-1 for any)", "N"},
+      {"keep-denormals", 0, 0, G_OPTION_ARG_NONE, &keepDenormals,
+       "Don't flush denormals to zero on the audio thread", nullptr},
+      {"stats-file", 0, 0, G_OPTION_ARG_FILENAME, &statsFile,
+       "Write the audio stats as JSON to this file once a second", "PATH"},
+      {"midi-latency", 0, 0, G_OPTION_ARG_STRING, &midiLatency,
+       "Fixed MIDI input latency in samples for sample accurate timing, 'block' for one buffer "
+       "or 'off' to deliver at the start of the next block",
+       "N|block|off"},
+      {"midi-output", 0, 0, G_OPTION_ARG_STRING, &midiOutput,
+       "MIDI output port for the plugin's MIDI, 'all' or 'none'", "N|all|none"},
+      {"null-audio", 0, 0, G_OPTION_ARG_STRING, &nullAudio,
+       "Run without an audio device, paced to the clock or as fast as the plugin allows",
+       "paced|fast|off"},
+      {"graph", 0, 0, G_OPTION_ARG_FILENAME, &graphFile,
+       "Run the plugin in a graph with the other plugins and connections of this file", "PATH"},
+      {"tempo", 0, 0, G_OPTION_ARG_DOUBLE, &tempo, "Transport tempo in BPM", "BPM"},
+      {"time-signature", 0, 0, G_OPTION_ARG_STRING, &timeSignature, "Transport time signature",
+       "N/D"},
+      {"loop", 0, 0, G_OPTION_ARG_STRING, &loop, "Loop the transport between two positions in beats",
+       "START:END"},
+      {"stopped", 0, 0, G_OPTION_ARG_NONE, &stopped, "Start with the transport stopped", nullptr},
       {NULL}};
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
@@ -286,8 +431,143 @@ bool GtkGui::parseCommandLine(int argc, char **argv)
     return false;
   }
 
+  if (bufferSize)
+  {
+    auto frames = sah->parseBufferFrames(bufferSize);
+    if (!frames.has_value())
+    {
+      g_print("Invalid buffer size '%s'\n", bufferSize);
+      g_free(bufferSize);
+      return false;
+    }
+    g_free(bufferSize);
+    sah->setStartupBufferFrames(*frames);
+  }
+
+  if (pluginBlock)
+  {
+    auto frames = sah->parseBufferFrames(pluginBlock);
+    if (!frames.has_value() || *frames == sah->autoBufferFrames)
+    {
+      g_print("Invalid plugin block size '%s'\n", pluginBlock);
+      g_free(pluginBlock);
+      return false;
+    }
+    g_free(pluginBlock);
+    sah->setPluginBlockFrames(*frames);
+  }
+
+  if (inputRouting)
+  {
+    auto routing = sah->parseRouting(inputRouting);
+    if (!routing.has_value())
+    {
+      g_print("Invalid input routing '%s'\n", inputRouting);
+      g_free(inputRouting);
+      return false;
+    }
+    g_free(inputRouting);
+    sah->setInputRouting(*routing);
+  }
+
+  if (outputRouting)
+  {
+    auto routing = sah->parseRouting(outputRouting);
+    if (!routing.has_value())
+    {
+      g_print("Invalid output routing '%s'\n", outputRouting);
+      g_free(outputRouting);
+      return false;
+    }
+    g_free(outputRouting);
+    sah->setOutputRouting(*routing);
+  }
+
+  if (lockMemory)
+  {
+    sah->setLockAudioMemory(true);
+  }
+  sah->audioThreadPriority = rtPriority;
+  sah->audioThreadCpu = cpu;
+  sah->audioThreadFlushDenormals = !keepDenormals;
+
+  if (statsFile)
+  {
+    sah->statsFile = statsFile;
+    g_free(statsFile);
+  }
+
+  if (graphFile)
+  {
+    sah->setGraphFile(fs::u8path(graphFile));
+    g_free(graphFile);
+  }
+
+  if (midiLatency)
+  {
+    auto frames = sah->parseMIDILatency(midiLatency);
+    if (!frames.has_value())
+    {
+      g_print("Invalid MIDI latency '%s'\n", midiLatency);
+      g_free(midiLatency);
+      return false;
+    }
+    g_free(midiLatency);
+    sah->setMIDILatency(*frames);
+  }
+
+  if (midiOutput)
+  {
+    sah->setMIDIOutputPorts(midiOutput);
+    g_free(midiOutput);
+  }
+
+  if (nullAudio)
+  {
+    auto mode = sah->parseNullAudio(nullAudio);
+    if (!mode.has_value())
+    {
+      g_print("Invalid null audio mode '%s'\n", nullAudio);
+      g_free(nullAudio);
+      return false;
+    }
+    g_free(nullAudio);
+    sah->setNullAudio(*mode);
+  }
+
+  auto ts = sah->transportSettings;
+  if (tempo < 20 || tempo > 999)
+  {
+    g_print("Invalid tempo %f\n", tempo);
+    return false;
+  }
+  ts.tempo = tempo;
+  ts.playing = !stopped;
+  if (timeSignature)
+  {
+    if (!sah->parseTimeSignature(timeSignature, ts.tsigNum, ts.tsigDenom))
+    {
+      g_print("Invalid time signature '%s'\n", timeSignature);
+      g_free(timeSignature);
+      return false;
+    }
+    g_free(timeSignature);
+  }
+  if (loop)
+  {
+    if (!sah->parseLoop(loop, ts.loopStartBeats, ts.loopEndBeats))
+    {
+      g_print("Invalid loop '%s'\n", loop);
+      g_free(loop);
+      return false;
+    }
+    g_free(loop);
+    ts.loopActive = true;
+  }
+  sah->setTransport(ts);
+
   LOG << "Post Argument Parse: inId=" << inId << " outId=" << outId << " sampleRate=" << sampleRate
-      << std::endl;
+      << " bufferFrames=" << sah->startBufferFrames << std::endl;
   sah->setStartupAudio(inId, outId, sampleRate);
 
   return true;
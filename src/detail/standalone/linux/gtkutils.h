@@ -24,6 +24,16 @@ struct GtkGui
   void setupPlugin(_GtkApplication *app);
   bool resizePlugin(_GtkWidget *wid, uint32_t w, uint32_t h);
 
+  // the transport controls below the plugin
+  _GtkWidget *playButton{nullptr}, *tempoSpin{nullptr}, *tsigNumSpin{nullptr}, *tsigDenomSpin{nullptr};
+  _GtkWidget *loopCheck{nullptr}, *loopStartSpin{nullptr}, *loopEndSpin{nullptr};
+  void setupTransportControls(_GtkWidget *box);
+  void transportChanged();
+
+  // the audio stats line below the plugin, refreshed once a second
+  _GtkWidget *statsLabel{nullptr};
+  int updateAudioStats();
+
   clap_id currTimer{8675309};
   std::mutex cbMutex{};
 
@@ -41,18 +41,29 @@
   std::string clapName{HOSTED_CLAP_NAME};
   LOG << "Loading " << clapName << std::endl;
 
-  auto pts = Clap::getValidCLAPSearchPaths();
-
   auto lib = Clap::Library();
 
-  for (const auto &searchPaths : pts)
+  // the search paths are only walked if the cached location is gone or has changed
+  auto cached = Clap::lookupDiscoveryCache(clapName + ".clap");
+  if (cached && lib.load(*cached))
+  {
+    entry = lib._pluginEntry;
+  }
+
+  if (!entry)
   {
-    auto clapPath = searchPaths / (clapName + ".clap");
+    auto pts = Clap::getValidCLAPSearchPaths();
 
-    if (fs::is_directory(clapPath) && !entry)
+    for (const auto &searchPaths : pts)
     {
-      lib.load(clapPath);
-      entry = lib._pluginEntry;
+      auto clapPath = searchPaths / (clapName + ".clap");
+
+      if (fs::is_directory(clapPath) && !entry)
+      {
+        lib.load(clapPath);
+        entry = lib._pluginEntry;
+        if (entry) Clap::storeDiscoveryCache(clapName + ".clap", clapPath);
+      }
     }
   }
 #endif
@@ -432,7 +443,10 @@
     const auto sr = [[[sampleRateSelection selectedItem] title] integerValue];
 
     auto standaloneHost = freeaudio::clap_wrapper::standalone::getStandaloneHost();
-    standaloneHost->startAudioThreadOn(inId, 2, useIn, outId, 2, useOut, (int32_t)sr);
+    auto inChannels = standaloneHost->requiredDeviceChannels(true);
+    auto outChannels = std::max(2U, standaloneHost->requiredDeviceChannels(false));
+    standaloneHost->startAudioThreadOn(inId, inChannels, useIn && inChannels > 0, outId, outChannels,
+                                       useOut, (int32_t)sr);
 
     [self close];
   }
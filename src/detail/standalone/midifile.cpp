@@ -0,0 +1,232 @@
+#include "midifile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace
+{
+struct TrackEvent
+{
+  uint64_t tick{0};
+  // microseconds per quarter note for tempo events, 0 for messages
+  uint32_t tempo{0};
+  std::vector<uint8_t> bytes;
+};
+
+struct Reader
+{
+  const uint8_t *p, *end;
+
+  bool has(size_t n) const
+  {
+    return (size_t)(end - p) >= n;
+  }
+  uint32_t be(int n)
+  {
+    uint32_t v{0};
+    for (int i = 0; i < n; ++i) v = (v << 8) | *p++;
+    return v;
+  }
+  bool vlq(uint32_t &v)
+  {
+    v = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+      if (!has(1)) return false;
+      auto b = *p++;
+      v = (v << 7) | (b & 0x7F);
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+};
+
+bool readTrack(Reader r, std::vector<TrackEvent> &events, std::string &error)
+{
+  uint64_t tick{0};
+  uint8_t runningStatus{0};
+  while (r.has(1))
+  {
+    uint32_t delta;
+    if (!r.vlq(delta) || !r.has(1))
+    {
+      error = "truncated track";
+      return false;
+    }
+    tick += delta;
+
+    TrackEvent ev;
+    ev.tick = tick;
+
+    auto status = *r.p;
+    if (status == 0xFF)
+    {
+      ++r.p;
+      uint32_t len;
+      if (!r.has(1))
+      {
+        error = "truncated meta event";
+        return false;
+      }
+      auto type = *r.p++;
+      if (!r.vlq(len) || !r.has(len))
+      {
+        error = "truncated meta event";
+        return false;
+      }
+      if (type == 0x51 && len == 3)
+      {
+        ev.tempo = Reader{r.p, r.end}.be(3);
+        if (ev.tempo > 0) events.push_back(std::move(ev));
+      }
+      r.p += len;
+      if (type == 0x2F) break;
+      continue;
+    }
+    if (status == 0xF0 || status == 0xF7)
+    {
+      ++r.p;
+      uint32_t len;
+      if (!r.vlq(len) || !r.has(len))
+      {
+        error = "truncated SysEx";
+        return false;
+      }
+      // an F7 event is an escape which carries its bytes as they are
+      if (status == 0xF0) ev.bytes.push_back(0xF0);
+      ev.bytes.insert(ev.bytes.end(), r.p, r.p + len);
+      r.p += len;
+      runningStatus = 0;
+      if (!ev.bytes.empty()) events.push_back(std::move(ev));
+      continue;
+    }
+
+    if (status & 0x80)
+    {
+      runningStatus = status;
+      ++r.p;
+    }
+    else if (runningStatus == 0)
+    {
+      error = "data byte without status";
+      return false;
+    }
+    auto type = runningStatus & 0xF0;
+    size_t dataBytes = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+    if (!r.has(dataBytes))
+    {
+      error = "truncated message";
+      return false;
+    }
+    ev.bytes.push_back(runningStatus);
+    ev.bytes.insert(ev.bytes.end(), r.p, r.p + dataBytes);
+    r.p += dataBytes;
+    events.push_back(std::move(ev));
+  }
+  return true;
+}
+}  // namespace
+
+bool readMidiFile(const fs::path &path, std::vector<MidiFileEvent> &events, std::string &error)
+{
+  std::ifstream ifs(path, std::ios::in | std::ios::binary);
+  if (!ifs.is_open())
+  {
+    error = "unable to open " + path.u8string();
+    return false;
+  }
+  std::vector<uint8_t> file((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+  Reader r{file.data(), file.data() + file.size()};
+  if (!r.has(14) || std::string(r.p, r.p + 4) != "MThd")
+  {
+    error = "not a standard MIDI file";
+    return false;
+  }
+  r.p += 4;
+  auto headerSize = r.be(4);
+  if (headerSize < 6 || !r.has(headerSize))
+  {
+    error = "broken MThd chunk";
+    return false;
+  }
+  auto format = r.be(2);
+  auto tracks = r.be(2);
+  auto division = r.be(2);
+  r.p += headerSize - 6;
+  if (format > 1)
+  {
+    error = "only format 0 and 1 files are supported";
+    return false;
+  }
+
+  std::vector<TrackEvent> all;
+  for (auto t = 0U; t < tracks && r.has(8); ++t)
+  {
+    auto isTrack = std::string(r.p, r.p + 4) == "MTrk";
+    r.p += 4;
+    auto size = r.be(4);
+    if (!r.has(size))
+    {
+      error = "truncated track chunk";
+      return false;
+    }
+    if (isTrack)
+    {
+      std::vector<TrackEvent> trackEvents;
+      if (!readTrack(Reader{r.p, r.p + size}, trackEvents, error))
+      {
+        return false;
+      }
+      std::move(trackEvents.begin(), trackEvents.end(), std::back_inserter(all));
+    }
+    r.p += size;
+  }
+  // stable, so events at the same tick keep the order of the file
+  std::stable_sort(all.begin(), all.end(),
+                   [](const TrackEvent &a, const TrackEvent &b) { return a.tick < b.tick; });
+
+  // smpte divisions have a fixed tick length, otherwise the tempo map decides
+  double secondsPerTick;
+  bool smpte = division & 0x8000;
+  uint32_t ticksPerQuarter = division & 0x7FFF;
+  if (smpte)
+  {
+    auto framesPerSecond = -(int8_t)(division >> 8);
+    if (framesPerSecond <= 0 || (division & 0xFF) == 0)
+    {
+      error = "broken smpte division";
+      return false;
+    }
+    secondsPerTick = 1.0 / (framesPerSecond * (division & 0xFF));
+  }
+  else if (ticksPerQuarter == 0)
+  {
+    error = "division is 0";
+    return false;
+  }
+  else
+  {
+    secondsPerTick = 0.5 / ticksPerQuarter;  // 120 bpm until the first tempo event
+  }
+
+  events.clear();
+  double seconds{0};
+  uint64_t lastTick{0};
+  for (auto &ev : all)
+  {
+    seconds += (ev.tick - lastTick) * secondsPerTick;
+    lastTick = ev.tick;
+    if (ev.tempo)
+    {
+      if (!smpte) secondsPerTick = ev.tempo / 1000000.0 / ticksPerQuarter;
+      continue;
+    }
+    events.push_back({seconds, std::move(ev.bytes)});
+  }
+  return true;
+}
+}  // namespace freeaudio::clap_wrapper::standalone
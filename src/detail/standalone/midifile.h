@@ -0,0 +1,25 @@
+#pragma once
+
+/*
+ * Reads a standard MIDI file (format 0 and 1) into a list of timed messages, with the tempo
+ * map applied so each message carries its time in seconds.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct MidiFileEvent
+{
+  double seconds{0};
+  // a complete message, SysEx includes the leading 0xF0
+  std::vector<uint8_t> bytes;
+};
+
+// the events of all tracks merged and sorted by time, meta events are dropped
+bool readMidiFile(const fs::path &path, std::vector<MidiFileEvent> &events, std::string &error);
+}  // namespace freeaudio::clap_wrapper::standalone
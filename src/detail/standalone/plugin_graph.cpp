@@ -0,0 +1,889 @@
+#define NOMINMAX 1
+#include "plugin_graph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "standalone_details.h"
+#include "state_file.h"
+#include "detail/shared/audiothread_guard.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+// splits at white space, keeps "quoted strings" together and drops # comments
+static std::vector<std::string> tokenize(const std::string &line)
+{
+  std::vector<std::string> res;
+  size_t i{0};
+  while (i < line.size())
+  {
+    if (isspace((unsigned char)line[i]))
+    {
+      i++;
+      continue;
+    }
+    if (line[i] == '#')
+    {
+      break;
+    }
+    if (line[i] == '"')
+    {
+      auto end = line.find('"', i + 1);
+      end = (end == std::string::npos) ? line.size() : end;
+      res.push_back(line.substr(i + 1, end - i - 1));
+      i = end + 1;
+      continue;
+    }
+    auto start = i;
+    while (i < line.size() && !isspace((unsigned char)line[i])) i++;
+    res.push_back(line.substr(start, i - start));
+  }
+  return res;
+}
+
+// NAME or NAME:PORT
+static bool parseEndpoint(const std::string &value, std::string &node, int32_t &port)
+{
+  auto colon = value.find(':');
+  node = value.substr(0, colon);
+  port = -1;
+  if (colon == std::string::npos)
+  {
+    return !node.empty();
+  }
+  try
+  {
+    size_t used{0};
+    auto p = std::stoi(value.substr(colon + 1), &used);
+    port = p;
+    return !node.empty() && p >= 0 && used == value.size() - colon - 1;
+  }
+  catch (const std::exception &)
+  {
+  }
+  return false;
+}
+
+bool readGraphConfig(const fs::path &path, GraphConfig &config, std::string &error)
+{
+  std::ifstream ifs(path);
+  if (!ifs.is_open())
+  {
+    error = "unable to open " + path.u8string();
+    return false;
+  }
+
+  std::string line;
+  int lineNumber{0};
+  while (std::getline(ifs, line))
+  {
+    lineNumber++;
+    auto where = path.filename().u8string() + ":" + std::to_string(lineNumber) + ": ";
+    auto t = tokenize(line);
+    if (t.empty())
+    {
+      continue;
+    }
+    if (t[0] == "plugin" && (t.size() == 3 || t.size() == 4))
+    {
+      GraphConfig::Plugin p;
+      p.name = t[1];
+      p.path = fs::u8path(t[2]);
+      p.id = t.size() == 4 ? t[3] : std::string();
+      config.plugins.push_back(p);
+    }
+    else if (t[0] == "state" && t.size() == 3)
+    {
+      auto it = std::find_if(config.plugins.begin(), config.plugins.end(),
+                             [&t](const auto &p) { return p.name == t[1]; });
+      if (it == config.plugins.end())
+      {
+        error = where + "no plugin '" + t[1] + "' declared before its state";
+        return false;
+      }
+      it->state = fs::u8path(t[2]);
+    }
+    else if ((t[0] == "audio" || t[0] == "note") && t.size() == 3)
+    {
+      GraphConfig::Connection c;
+      c.audio = t[0] == "audio";
+      if (!parseEndpoint(t[1], c.from, c.fromPort) || !parseEndpoint(t[2], c.to, c.toPort) ||
+          (!c.audio && (c.fromPort >= 0 || c.toPort >= 0)))
+      {
+        error = where + "invalid connection";
+        return false;
+      }
+      config.connections.push_back(c);
+    }
+    else if (t[0] == "threads" && t.size() == 2)
+    {
+      try
+      {
+        config.threads = (uint32_t)std::clamp(std::stoi(t[1]), 1, 64);
+      }
+      catch (const std::exception &)
+      {
+        error = where + "invalid number of threads";
+        return false;
+      }
+    }
+    else
+    {
+      error = where + "unknown statement '" + line + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+PluginGraph::PluginGraph(std::function<void()> setupWorker) : setupWorker(std::move(setupWorker))
+{
+}
+
+PluginGraph::~PluginGraph()
+{
+  deactivate();
+}
+
+uint32_t PluginGraph::findPort(uint32_t node, bool isInput, int32_t port, std::string &error) const
+{
+  const auto &n = *nodes[node];
+  const auto &channelByPort = isInput ? n.inputChannelByPort : n.outputChannelByPort;
+  auto index = port < 0 ? (isInput ? n.mainInput : n.mainOutput) : (uint32_t)port;
+  if (index >= channelByPort.size())
+  {
+    error = "'" + n.name + "' has no audio " + (isInput ? "input " : "output ") +
+            (port < 0 ? std::string("port") : std::to_string(port));
+    return UINT32_MAX;
+  }
+  return index;
+}
+
+bool PluginGraph::load(const GraphConfig &config, const fs::path &baseDir,
+                       std::shared_ptr<Clap::Plugin> main, std::string &error)
+{
+  auto mainNode = std::make_unique<Node>();
+  mainNode->name = "main";
+  mainNode->plugin = main;
+  // the host activates main together with its own buffers
+  mainNode->active = true;
+  nodes.push_back(std::move(mainNode));
+
+  std::vector<fs::path> libraryPaths;
+  for (const auto &p : config.plugins)
+  {
+    auto exists =
+        std::any_of(nodes.begin(), nodes.end(), [&p](const auto &n) { return n->name == p.name; });
+    if (exists || p.name == "in" || p.name == "out")
+    {
+      error = "the node name '" + p.name + "' is taken";
+      return false;
+    }
+    auto path = p.path.is_relative() ? baseDir / p.path : p.path;
+    auto lib = std::find(libraryPaths.begin(), libraryPaths.end(), path);
+    if (lib == libraryPaths.end())
+    {
+      auto library = std::make_unique<Clap::Library>();
+      if (!library->load(path) || !library->_pluginFactory)
+      {
+        error = "unable to load " + path.u8string();
+        return false;
+      }
+      libraries.push_back(std::move(library));
+      libraryPaths.push_back(path);
+      lib = libraryPaths.end() - 1;
+    }
+    auto &library = *libraries[lib - libraryPaths.begin()];
+    if (p.id.empty() && library.plugins.empty())
+    {
+      error = path.u8string() + " has no plugins";
+      return false;
+    }
+    auto id = p.id.empty() ? std::string(library.plugins[0]->id) : p.id;
+
+    auto node = std::make_unique<Node>();
+    node->name = p.name;
+    node->host = std::make_unique<GraphNodeHost>();
+    node->plugin = Clap::Plugin::createInstance(library._pluginFactory, id, node->host.get());
+    if (!node->plugin || !node->plugin->_plugin)
+    {
+      error = "unable to create '" + id + "' from " + path.u8string();
+      return false;
+    }
+    if (!node->plugin->initialize())
+    {
+      error = "unable to initialize '" + p.name + "' (" + id + ")";
+      return false;
+    }
+
+    if (!p.state.empty())
+    {
+      auto statePath = p.state.is_relative() ? baseDir / p.state : p.state;
+      MappedStateFile file;
+      if (!file.open(statePath) || !node->plugin->load(file.stream()))
+      {
+        error = "unable to load the state of '" + p.name + "' from " + statePath.u8string();
+        return false;
+      }
+    }
+    nodes.push_back(std::move(node));
+  }
+
+  for (auto &n : nodes)
+  {
+    auto *p = n->plugin->_plugin;
+    auto ports = n->plugin->_ext._audioports;
+    clap_audio_port_info_t info;
+    for (auto i = 0U; ports && i < ports->count(p, true); ++i)
+    {
+      ports->get(p, i, true, &info);
+      n->inputChannelByPort.push_back(info.channel_count);
+      if (info.flags & CLAP_AUDIO_PORT_IS_MAIN) n->mainInput = i;
+    }
+    for (auto i = 0U; ports && i < ports->count(p, false); ++i)
+    {
+      ports->get(p, i, false, &info);
+      n->outputChannelByPort.push_back(info.channel_count);
+      if (info.flags & CLAP_AUDIO_PORT_IS_MAIN) n->mainOutput = i;
+    }
+    uint32_t inputs{0};
+    for (auto c : n->inputChannelByPort) inputs += c;
+    n->inputSources.resize(inputs);
+  }
+
+  auto nodeIndex = [this](const std::string &name)
+  {
+    for (auto i = 0U; i < nodes.size(); ++i)
+    {
+      if (nodes[i]->name == name) return i;
+    }
+    return (uint32_t)UINT32_MAX;
+  };
+  auto firstChannel = [](const std::vector<uint32_t> &channelByPort, uint32_t port)
+  {
+    uint32_t res{0};
+    for (auto i = 0U; i < port; ++i) res += channelByPort[i];
+    return res;
+  };
+  auto addFeed = [this](uint32_t from, uint32_t to)
+  {
+    auto &feeds = nodes[from]->feeds;
+    if (std::find(feeds.begin(), feeds.end(), to) == feeds.end())
+    {
+      feeds.push_back(to);
+      nodes[to]->dependencies++;
+    }
+  };
+
+  bool anyNotes{false};
+  for (const auto &c : config.connections)
+  {
+    auto describe = std::string(c.audio ? "audio " : "note ") + c.from + " " + c.to + ": ";
+    auto from = c.from == "in" ? deviceNode : nodeIndex(c.from);
+    auto to = c.to == "out" ? deviceNode : nodeIndex(c.to);
+    if ((from == deviceNode && c.from != "in") || (to == deviceNode && c.to != "out") ||
+        (from == deviceNode && to == deviceNode))
+    {
+      error = describe + "unknown node or no node at all";
+      return false;
+    }
+    if (from == to)
+    {
+      error = describe + "a node can't feed itself";
+      return false;
+    }
+
+    if (!c.audio)
+    {
+      anyNotes = true;
+      if (from == deviceNode)
+      {
+        nodes[to]->hostEventsIn = true;
+      }
+      else if (to == deviceNode)
+      {
+        nodes[from]->eventsToHost = true;
+      }
+      else
+      {
+        auto &sources = nodes[to]->noteSources;
+        if (std::find(sources.begin(), sources.end(), from) == sources.end()) sources.push_back(from);
+        addFeed(from, to);
+      }
+      continue;
+    }
+
+    // a device endpoint has as many channels as the port on the other side
+    uint32_t fromFirst{0}, fromChannels{0}, toFirst{0}, toChannels{0};
+    if (from != deviceNode)
+    {
+      auto port = findPort(from, false, c.fromPort, error);
+      if (port == UINT32_MAX)
+      {
+        error = describe + error;
+        return false;
+      }
+      fromFirst = firstChannel(nodes[from]->outputChannelByPort, port);
+      fromChannels = nodes[from]->outputChannelByPort[port];
+    }
+    if (to != deviceNode)
+    {
+      auto port = findPort(to, true, c.toPort, error);
+      if (port == UINT32_MAX)
+      {
+        error = describe + error;
+        return false;
+      }
+      toFirst = firstChannel(nodes[to]->inputChannelByPort, port);
+      toChannels = nodes[to]->inputChannelByPort[port];
+    }
+    if (from == deviceNode)
+    {
+      for (auto ch = 0U; ch < toChannels; ++ch)
+      {
+        nodes[to]->inputSources[toFirst + ch].push_back({deviceNode, ch});
+      }
+    }
+    else if (to == deviceNode)
+    {
+      deviceOutputSources.resize(std::max((uint32_t)deviceOutputSources.size(), fromChannels));
+      for (auto ch = 0U; ch < fromChannels; ++ch)
+      {
+        deviceOutputSources[ch].push_back({from, fromFirst + ch});
+      }
+    }
+    else
+    {
+      for (auto ch = 0U; ch < toChannels; ++ch)
+      {
+        auto sc = fromChannels == 1 ? 0U : ch;
+        if (sc < fromChannels)
+        {
+          nodes[to]->inputSources[toFirst + ch].push_back({from, fromFirst + sc});
+        }
+      }
+      addFeed(from, to);
+    }
+  }
+  if (!anyNotes)
+  {
+    nodes[0]->hostEventsIn = true;
+    nodes[0]->eventsToHost = true;
+  }
+
+  // a topological order, which only exists without cycles
+  std::vector<uint32_t> waiting(nodes.size());
+  for (auto i = 0U; i < nodes.size(); ++i)
+  {
+    waiting[i] = nodes[i]->dependencies;
+    if (waiting[i] == 0) order.push_back(i);
+  }
+  for (auto i = 0U; i < order.size(); ++i)
+  {
+    for (auto f : nodes[order[i]]->feeds)
+    {
+      if (--waiting[f] == 0) order.push_back(f);
+    }
+  }
+  if (order.size() != nodes.size())
+  {
+    error = "the connections form a cycle";
+    return false;
+  }
+  ancestors.assign(nodes.size(), std::vector<bool>(nodes.size(), false));
+  for (auto v : order)
+  {
+    for (auto f : nodes[v]->feeds)
+    {
+      ancestors[v][f] = true;
+      for (auto a = 0U; a < nodes.size(); ++a)
+      {
+        if (ancestors[a][v]) ancestors[a][f] = true;
+      }
+    }
+  }
+
+  for (auto &n : nodes)
+  {
+    n->inputList.reserve(maxEventsPerNode * (n->noteSources.size() + 1));
+    n->eventArena.resize(eventArenaSize);
+    n->eventOffsets.resize(maxEventsPerNode);
+    n->inputEvents.ctx = n.get();
+    n->inputEvents.size = [](const clap_input_events *list)
+    { return (uint32_t)static_cast<Node *>(list->ctx)->inputList.size(); };
+    n->inputEvents.get = [](const clap_input_events *list, uint32_t index)
+    { return static_cast<Node *>(list->ctx)->inputList[index]; };
+    n->outputEvents.ctx = n.get();
+    n->outputEvents.try_push = pushNodeEvent;
+  }
+  ready = std::make_unique<std::atomic<int32_t>[]>(nodes.size());
+
+  // the audio thread is one of the threads, more than the graph has nodes would only wait
+  auto cores = std::max(1U, std::thread::hardware_concurrency());
+  threads = std::min(config.threads ? config.threads : cores, (uint32_t)nodes.size());
+  return true;
+}
+
+uint32_t PluginGraph::deviceChannels(bool isInput) const
+{
+  if (!isInput)
+  {
+    return (uint32_t)deviceOutputSources.size();
+  }
+  uint32_t res{0};
+  for (const auto &n : nodes)
+  {
+    for (const auto &sources : n->inputSources)
+    {
+      for (const auto &s : sources)
+      {
+        if (s.node == deviceNode) res = std::max(res, s.channel + 1);
+      }
+    }
+  }
+  return res;
+}
+
+std::string PluginGraph::describe() const
+{
+  std::ostringstream oss;
+  oss << nodes.size() << " plugins on " << threads << " threads:";
+  for (auto v : order)
+  {
+    oss << " " << nodes[v]->name;
+    if (!nodes[v]->feeds.empty())
+    {
+      oss << " ->";
+      for (auto f : nodes[v]->feeds) oss << " " << nodes[f]->name;
+      oss << ";";
+    }
+  }
+  return oss.str();
+}
+
+void PluginGraph::activate(int32_t sampleRate, uint32_t minFrames, uint32_t maxFrames, bool lockMemory)
+{
+  deactivate();
+  for (auto i = 1U; i < nodes.size(); ++i)
+  {
+    auto &n = *nodes[i];
+    n.plugin->setSampleRate(sampleRate);
+    n.plugin->setBlockSizes(minFrames, maxFrames);
+    n.active = n.plugin->activate();
+    if (!n.active)
+    {
+      LOG << "[ERROR] Graph plugin '" << n.name << "' failed to activate, it stays silent" << std::endl;
+      continue;
+    }
+    n.plugin->start_processing();
+  }
+  planMemory(maxFrames, lockMemory);
+  startWorkers();
+}
+
+void PluginGraph::deactivate()
+{
+  stopWorkers();
+  for (auto i = 1U; i < nodes.size(); ++i)
+  {
+    auto &n = *nodes[i];
+    if (n.active)
+    {
+      n.plugin->stop_processing();
+      n.plugin->deactivate();
+      n.active = false;
+    }
+  }
+}
+
+void PluginGraph::runCallbacks()
+{
+  for (auto i = 1U; i < nodes.size(); ++i)
+  {
+    nodes[i]->host->runCallbackIfRequested(nodes[i]->plugin->_plugin);
+  }
+}
+
+void PluginGraph::planMemory(uint32_t maxFrames, bool lockMemory)
+{
+  /*
+   * Every output channel and every summed input channel is a buffer, written by its node and
+   * read by the nodes it feeds, or by the device output at the very end. Buffer a can hand its
+   * row to buffer b if all of a's readers and its writer are ancestors of b's writer, then no
+   * schedule can have both alive. The buffers are placed in topological order of their writers,
+   * so the occupants of a row form a chain and only the last one has to be checked.
+   */
+  struct Buffer
+  {
+    uint32_t writer{0};
+    std::vector<uint32_t> readers;
+    bool toDevice{false};
+    float **target{nullptr};
+    uint32_t row{0};
+  };
+  std::vector<Buffer> buffers;
+  for (auto v : order)
+  {
+    auto &n = *nodes[v];
+    uint32_t outputs{0};
+    for (auto c : n.outputChannelByPort) outputs += c;
+    n.outputChannelPtr.assign(outputs, nullptr);
+    n.inputChannelPtr.assign(n.inputSources.size(), nullptr);
+    n.mixes.clear();
+
+    for (auto ch = 0U; ch < n.inputSources.size(); ++ch)
+    {
+      const auto &sources = n.inputSources[ch];
+      if (sources.size() == 1)
+      {
+        // read directly from the output row, or from the device in every block
+        if (sources[0].node == deviceNode) n.mixes.push_back({ch, nullptr});
+        continue;
+      }
+      if (sources.size() > 1)
+      {
+        n.mixes.push_back({ch, nullptr});
+        Buffer b;
+        b.writer = v;
+        b.readers.push_back(v);
+        buffers.push_back(b);
+      }
+    }
+    for (auto ch = 0U; ch < outputs; ++ch)
+    {
+      Buffer b;
+      b.writer = v;
+      b.target = &n.outputChannelPtr[ch];
+      for (auto u = 0U; u < nodes.size(); ++u)
+      {
+        for (const auto &sources : nodes[u]->inputSources)
+        {
+          for (const auto &s : sources)
+          {
+            if (s.node == v && s.channel == ch) b.readers.push_back(u);
+          }
+        }
+      }
+      for (const auto &sources : deviceOutputSources)
+      {
+        for (const auto &s : sources)
+        {
+          if (s.node == v && s.channel == ch) b.toDevice = true;
+        }
+      }
+      buffers.push_back(b);
+    }
+  }
+
+  auto before = [this](const Buffer &a, const Buffer &b)
+  {
+    if (a.toDevice || !ancestors[a.writer][b.writer])
+    {
+      return false;
+    }
+    return std::all_of(a.readers.begin(), a.readers.end(),
+                       [&](uint32_t r) { return ancestors[r][b.writer]; });
+  };
+  std::vector<uint32_t> lastInRow;
+  for (auto i = 0U; i < buffers.size(); ++i)
+  {
+    auto row = 0U;
+    while (row < lastInRow.size() && !before(buffers[lastInRow[row]], buffers[i])) row++;
+    if (row == lastInRow.size()) lastInRow.push_back(i);
+    lastInRow[row] = i;
+    buffers[i].row = row;
+  }
+
+  // row 0 is the silence for unconnected inputs
+  rowStride = (uint32_t)AlignedMemory::alignedCount<float>(maxFrames);
+  arenaRows = 1 + (uint32_t)lastInRow.size();
+  if (!arena.allocate(sizeof(float) * arenaRows * rowStride, lockMemory))
+  {
+    std::terminate();
+  }
+  silentRow = arena.as<float>();
+  auto rowAt = [this](uint32_t row) { return arena.as<float>() + (1 + row) * rowStride; };
+  LOG << "Graph arena : " << arenaRows << " rows of " << maxFrames << " frames for " << buffers.size()
+      << " buffers" << std::endl;
+
+  // the buffers were made in the same order, the mix buffers first for each node
+  auto next = buffers.begin();
+  for (auto v : order)
+  {
+    auto &n = *nodes[v];
+    for (auto &m : n.mixes)
+    {
+      if (n.inputSources[m.channel].size() > 1) m.row = rowAt((next++)->row);
+    }
+    for (auto &ptr : n.outputChannelPtr)
+    {
+      ptr = rowAt((next++)->row);
+    }
+  }
+  for (auto &n : nodes)
+  {
+    for (auto ch = 0U; ch < n->inputSources.size(); ++ch)
+    {
+      const auto &sources = n->inputSources[ch];
+      n->inputChannelPtr[ch] = silentRow;
+      if (sources.size() == 1 && sources[0].node != deviceNode)
+      {
+        n->inputChannelPtr[ch] = nodes[sources[0].node]->outputChannelPtr[sources[0].channel];
+      }
+    }
+    for (const auto &m : n->mixes)
+    {
+      if (m.row) n->inputChannelPtr[m.channel] = m.row;
+    }
+
+    auto buildPorts = [](const std::vector<uint32_t> &channelByPort, std::vector<float *> &channelPtr,
+                         std::vector<clap_audio_buffer> &ports)
+    {
+      ports.clear();
+      uint32_t offset{0};
+      for (auto c : channelByPort)
+      {
+        clap_audio_buffer b{};
+        b.data32 = channelPtr.data() + offset;
+        b.channel_count = c;
+        ports.push_back(b);
+        offset += c;
+      }
+    };
+    buildPorts(n->inputChannelByPort, n->inputChannelPtr, n->inputPorts);
+    buildPorts(n->outputChannelByPort, n->outputChannelPtr, n->outputPorts);
+  }
+}
+
+bool PluginGraph::pushNodeEvent(const clap_output_events *list, const clap_event_header_t *event)
+{
+  auto &n = *static_cast<Node *>(list->ctx);
+  // parameter and transport events only make sense to the node's own host
+  auto type = event->type;
+  auto passes = type <= CLAP_EVENT_NOTE_EXPRESSION || type == CLAP_EVENT_MIDI ||
+                type == CLAP_EVENT_MIDI_SYSEX || type == CLAP_EVENT_MIDI2;
+  if (event->space_id != CLAP_CORE_EVENT_SPACE_ID || !passes)
+  {
+    return true;
+  }
+
+  // the sysex data is only valid during process, so it's copied behind the event
+  auto align = [](uint32_t size) { return (size + 7U) & ~7U; };
+  auto sysexSize = type == CLAP_EVENT_MIDI_SYSEX ? ((const clap_event_midi_sysex *)event)->size : 0U;
+  auto size = align(event->size) + align(sysexSize);
+  if (n.eventCount >= maxEventsPerNode || n.eventArenaUsed + size > n.eventArena.size())
+  {
+    return false;
+  }
+  auto *dst = n.eventArena.data() + n.eventArenaUsed;
+  memcpy(dst, event, event->size);
+  if (sysexSize > 0)
+  {
+    auto *data = dst + align(event->size);
+    memcpy(data, ((const clap_event_midi_sysex *)event)->buffer, sysexSize);
+    ((clap_event_midi_sysex *)dst)->buffer = data;
+  }
+  n.eventOffsets[n.eventCount++] = n.eventArenaUsed;
+  n.eventArenaUsed += size;
+  return true;
+}
+
+void PluginGraph::runNode(uint32_t node, uint32_t frames)
+{
+  auto &n = *nodes[node];
+
+  for (const auto &m : n.mixes)
+  {
+    const auto &sources = n.inputSources[m.channel];
+    if (!m.row)
+    {
+      auto ch = sources[0].channel;
+      n.inputChannelPtr[m.channel] = ch < blockDeviceInputs ? blockDeviceIn[ch] : silentRow;
+      continue;
+    }
+    memset(m.row, 0, frames * sizeof(float));
+    for (const auto &s : sources)
+    {
+      const float *src{nullptr};
+      if (s.node != deviceNode)
+      {
+        src = nodes[s.node]->outputChannelPtr[s.channel];
+      }
+      else if (s.channel < blockDeviceInputs)
+      {
+        src = blockDeviceIn[s.channel];
+      }
+      for (auto i = 0U; src && i < frames; ++i) m.row[i] += src[i];
+    }
+  }
+
+  // the sources are each in time order, the merge keeps the order of events at the same time
+  n.inputList.clear();
+  if (n.hostEventsIn)
+  {
+    auto *in = hostProcess->in_events;
+    for (auto i = 0U; i < in->size(in); ++i) n.inputList.push_back(in->get(in, i));
+  }
+  for (auto s : n.noteSources)
+  {
+    const auto &src = *nodes[s];
+    for (auto i = 0U; i < src.eventCount; ++i)
+    {
+      auto *ev = (const clap_event_header_t *)(src.eventArena.data() + src.eventOffsets[i]);
+      n.inputList.push_back(ev);
+      for (auto at = n.inputList.size() - 1; at > 0 && n.inputList[at - 1]->time > ev->time; --at)
+      {
+        std::swap(n.inputList[at - 1], n.inputList[at]);
+      }
+    }
+  }
+  n.eventCount = 0;
+  n.eventArenaUsed = 0;
+
+  if (!n.active)
+  {
+    for (auto *ptr : n.outputChannelPtr) memset(ptr, 0, frames * sizeof(float));
+    return;
+  }
+  clap_process process{};
+  process.steady_time = hostProcess->steady_time;
+  process.frames_count = frames;
+  process.transport = hostProcess->transport;
+  process.audio_inputs = n.inputPorts.data();
+  process.audio_outputs = n.outputPorts.data();
+  process.audio_inputs_count = (uint32_t)n.inputPorts.size();
+  process.audio_outputs_count = (uint32_t)n.outputPorts.size();
+  process.in_events = &n.inputEvents;
+  process.out_events = &n.outputEvents;
+  n.plugin->_plugin->process(n.plugin->_plugin, &process);
+}
+
+bool PluginGraph::runReadyNode()
+{
+  auto slot = readyHead.fetch_add(1, std::memory_order_acq_rel);
+  if (slot >= nodes.size())
+  {
+    return false;
+  }
+  // every node is made ready exactly once per block, so the slot fills once its inputs are done
+  int32_t node;
+  while ((node = ready[slot].load(std::memory_order_acquire)) < 0)
+  {
+    std::this_thread::yield();
+  }
+  runNode((uint32_t)node, blockFrames);
+  for (auto f : nodes[node]->feeds)
+  {
+    if (nodes[f]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      auto at = readyTail.fetch_add(1, std::memory_order_relaxed);
+      ready[at].store((int32_t)f, std::memory_order_release);
+    }
+  }
+  done.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+void PluginGraph::process(const clap_process &host, float *const *deviceIn, uint32_t deviceInputs,
+                          float *const *deviceOut, uint32_t deviceOutputs)
+{
+  auto count = (uint32_t)nodes.size();
+  hostProcess = &host;
+  blockDeviceIn = deviceIn;
+  blockDeviceInputs = deviceInputs;
+  blockFrames = host.frames_count;
+
+  // readyHead is reset last, a worker which claims a slot before that finds none
+  uint32_t roots{0};
+  for (auto i = 0U; i < count; ++i)
+  {
+    nodes[i]->pending.store(nodes[i]->dependencies, std::memory_order_relaxed);
+    ready[i].store(-1, std::memory_order_relaxed);
+  }
+  for (auto i = 0U; i < count; ++i)
+  {
+    if (nodes[i]->dependencies == 0) ready[roots++].store((int32_t)i, std::memory_order_relaxed);
+  }
+  readyTail.store(roots, std::memory_order_relaxed);
+  done.store(0, std::memory_order_relaxed);
+  readyHead.store(0, std::memory_order_release);
+  generation.fetch_add(1, std::memory_order_release);
+  if (!workers.empty())
+  {
+    wake.notify_all();
+  }
+
+  while (runReadyNode())
+  {
+  }
+  while (done.load(std::memory_order_acquire) < count)
+  {
+    std::this_thread::yield();
+  }
+
+  for (auto d = 0U; d < deviceOutputs; ++d)
+  {
+    auto *dst = deviceOut[d];
+    memset(dst, 0, blockFrames * sizeof(float));
+    if (d >= deviceOutputSources.size()) continue;
+    for (const auto &s : deviceOutputSources[d])
+    {
+      const auto *src = nodes[s.node]->outputChannelPtr[s.channel];
+      for (auto i = 0U; i < blockFrames; ++i) dst[i] += src[i];
+    }
+  }
+  for (auto &n : nodes)
+  {
+    for (auto i = 0U; n->eventsToHost && i < n->eventCount; ++i)
+    {
+      auto *ev = (const clap_event_header_t *)(n->eventArena.data() + n->eventOffsets[i]);
+      host.out_events->try_push(host.out_events, ev);
+    }
+  }
+}
+
+void PluginGraph::workerLoop()
+{
+  setupWorker();
+  auto seen = generation.load(std::memory_order_acquire);
+  while (workersRunning)
+  {
+    {
+      // the audio thread doesn't take the mutex, the timeout covers a missed wake up
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wake.wait_for(lock, std::chrono::milliseconds(1), [&]()
+                    { return !workersRunning || generation.load(std::memory_order_acquire) != seen; });
+    }
+    seen = generation.load(std::memory_order_acquire);
+
+    // only draining the nodes is audio work, waiting for the next block is allowed to block
+    ClapWrapper::detail::shared::AudioThreadSection audiothread("PluginGraph::workerLoop");
+    while (runReadyNode())
+    {
+    }
+  }
+}
+
+void PluginGraph::startWorkers()
+{
+  workersRunning = true;
+  readyHead.store((uint32_t)nodes.size(), std::memory_order_release);
+  for (auto i = 1U; i < threads; ++i)
+  {
+    workers.emplace_back([this]() { workerLoop(); });
+  }
+  LOG << "Graph : " << describe() << std::endl;
+}
+
+void PluginGraph::stopWorkers()
+{
+  workersRunning = false;
+  wake.notify_all();
+  for (auto &w : workers) w.join();
+  workers.clear();
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
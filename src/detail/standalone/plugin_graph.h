@@ -0,0 +1,301 @@
+#pragma once
+
+/*
+ * A graph of CLAP plugins around the standalone's own plugin, loaded with --graph from a
+ * small text file, one statement per line:
+ *
+ *   # the standalone's own plugin is always the node 'main'
+ *   plugin verb /usr/lib/clap/verb.clap com.example.verb
+ *   state verb verb.clapstate
+ *   audio in main
+ *   audio main verb
+ *   audio main:1 out
+ *   audio verb out
+ *   note in main
+ *   threads 3
+ *
+ * 'in' and 'out' stand for the device channels and for the MIDI input and output. An audio
+ * connection goes from an output port to an input port, the main ports unless an index is
+ * given. Connections which end on the same port are summed and a mono port feeds every
+ * channel of a wider one. A note connection passes the note and MIDI events. Without any note
+ * line the MIDI input goes to main and the MIDI output of main to the MIDI output. Paths are
+ * relative to the file.
+ *
+ * Each block the nodes whose inputs are complete run in parallel on a pool of realtime workers
+ * and the audio thread, a finished node counts down the dependencies of the nodes it feeds.
+ * The channel rows are planned on activation in one arena, where two rows share memory if
+ * every schedule the graph allows is done with the first before the second is written.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <clap/clap.h>
+#include "clap_proxy.h"
+#include "aligned_memory.h"
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct GraphConfig
+{
+  struct Plugin
+  {
+    std::string name;
+    fs::path path;
+    // empty takes the first plugin of the file
+    std::string id;
+    fs::path state;
+  };
+  struct Connection
+  {
+    bool audio{true};
+    std::string from, to;
+    // -1 is the main port
+    int32_t fromPort{-1}, toPort{-1};
+  };
+  std::vector<Plugin> plugins;
+  std::vector<Connection> connections;
+  // 0 uses a worker per additional core, as far as the graph can use them
+  uint32_t threads{0};
+};
+
+bool readGraphConfig(const fs::path &path, GraphConfig &config, std::string &error);
+
+// The host of a plugin of the graph other than main. The plugins have no GUI, their main thread
+// callbacks run when the standalone polls the graph.
+class GraphNodeHost : public Clap::IHost
+{
+ public:
+  void runCallbackIfRequested(const clap_plugin_t *plugin)
+  {
+    if (callbackRequested.exchange(false))
+    {
+      plugin->on_main_thread(plugin);
+    }
+  }
+
+  void mark_dirty() override
+  {
+  }
+  void restartPlugin() override
+  {
+  }
+  void request_callback() override
+  {
+    callbackRequested = true;
+  }
+  void setupWrapperSpecifics(const clap_plugin_t *plugin) override
+  {
+  }
+  void setupAudioBusses(const clap_plugin_t *plugin,
+                        const clap_plugin_audio_ports_t *audioports) override
+  {
+  }
+  void setupMIDIBusses(const clap_plugin_t *plugin, const clap_plugin_note_ports_t *noteports) override
+  {
+  }
+  void setupParameters(const clap_plugin_t *plugin, const clap_plugin_params_t *params) override
+  {
+  }
+  void param_rescan(clap_param_rescan_flags flags) override
+  {
+  }
+  void param_clear(clap_id param, clap_param_clear_flags flags) override
+  {
+  }
+  void param_request_flush() override
+  {
+  }
+  void latency_changed() override
+  {
+  }
+  void tail_changed() override
+  {
+  }
+  bool gui_can_resize() override
+  {
+    return false;
+  }
+  bool gui_request_resize(uint32_t width, uint32_t height) override
+  {
+    return false;
+  }
+  bool gui_request_show() override
+  {
+    return false;
+  }
+  bool gui_request_hide() override
+  {
+    return false;
+  }
+  bool register_timer(uint32_t period_ms, clap_id *timer_id) override
+  {
+    return false;
+  }
+  bool unregister_timer(clap_id timer_id) override
+  {
+    return false;
+  }
+  const char *host_get_name() override
+  {
+    return "CLAP-Wrapper-Standalone-Graph";
+  }
+  bool supportsContextMenu() const override
+  {
+    return false;
+  }
+  bool context_menu_populate(const clap_context_menu_target_t *target,
+                             const clap_context_menu_builder_t *builder) override
+  {
+    return false;
+  }
+  bool context_menu_perform(const clap_context_menu_target_t *target, clap_id action_id) override
+  {
+    return false;
+  }
+  bool context_menu_can_popup() override
+  {
+    return false;
+  }
+  bool context_menu_popup(const clap_context_menu_target_t *target, int32_t screen_index, int32_t x,
+                          int32_t y) override
+  {
+    return false;
+  }
+#if LIN
+  bool register_fd(int fd, clap_posix_fd_flags_t flags) override
+  {
+    return false;
+  }
+  bool modify_fd(int fd, clap_posix_fd_flags_t flags) override
+  {
+    return false;
+  }
+  bool unregister_fd(int fd) override
+  {
+    return false;
+  }
+#endif
+
+ private:
+  std::atomic<bool> callbackRequested{false};
+};
+
+class PluginGraph
+{
+ public:
+  // setupWorker runs first on every worker thread
+  explicit PluginGraph(std::function<void()> setupWorker);
+  ~PluginGraph();
+  PluginGraph(const PluginGraph &) = delete;
+  PluginGraph &operator=(const PluginGraph &) = delete;
+
+  // main thread, before the audio starts. Creates the plugins next to main and checks that the
+  // connections form a graph without cycles.
+  bool load(const GraphConfig &config, const fs::path &baseDir, std::shared_ptr<Clap::Plugin> main,
+            std::string &error);
+  // the device channels the connections to 'in' and 'out' use
+  uint32_t deviceChannels(bool isInput) const;
+  std::string describe() const;
+
+  // main thread, together with main, which the host activates itself
+  void activate(int32_t sampleRate, uint32_t minFrames, uint32_t maxFrames, bool lockMemory);
+  void deactivate();
+  void runCallbacks();
+
+  // audio thread, in place of main's process. The host's process supplies the block size, the
+  // transport and the MIDI in and out, the device channels are planar rows.
+  void process(const clap_process &host, float *const *deviceIn, uint32_t deviceInputs,
+               float *const *deviceOut, uint32_t deviceOutputs);
+
+ private:
+  // a channel of an output port, or of the device input if node is deviceNode
+  struct Source
+  {
+    uint32_t node{0}, channel{0};
+  };
+  // an input channel which is summed into row, or reads a device channel if row is null
+  struct Mix
+  {
+    uint32_t channel{0};
+    float *row{nullptr};
+  };
+  struct Node
+  {
+    std::string name;
+    std::shared_ptr<Clap::Plugin> plugin;
+    std::unique_ptr<GraphNodeHost> host;
+    bool active{false};
+
+    std::vector<uint32_t> inputChannelByPort, outputChannelByPort;
+    uint32_t mainInput{0}, mainOutput{0};
+    // the sources of every input channel, in the order of the ports
+    std::vector<std::vector<Source>> inputSources;
+    std::vector<uint32_t> feeds;
+    uint32_t dependencies{0};
+    std::atomic<uint32_t> pending{0};
+
+    std::vector<float *> inputChannelPtr, outputChannelPtr;
+    std::vector<clap_audio_buffer> inputPorts, outputPorts;
+    std::vector<Mix> mixes;
+
+    bool hostEventsIn{false}, eventsToHost{false};
+    std::vector<uint32_t> noteSources;
+    std::vector<const clap_event_header_t *> inputList;
+    clap_input_events inputEvents{};
+    // the note and MIDI events the node produced this block, packed like the host's
+    std::vector<uint8_t> eventArena;
+    std::vector<uint32_t> eventOffsets;
+    uint32_t eventCount{0}, eventArenaUsed{0};
+    clap_output_events outputEvents{};
+  };
+
+  static constexpr uint32_t deviceNode{UINT32_MAX};
+  static constexpr uint32_t maxEventsPerNode{1024};
+  static constexpr uint32_t eventArenaSize{64 * 1024};
+
+  static bool pushNodeEvent(const clap_output_events *list, const clap_event_header_t *event);
+  uint32_t findPort(uint32_t node, bool isInput, int32_t port, std::string &error) const;
+  void planMemory(uint32_t maxFrames, bool lockMemory);
+  void runNode(uint32_t node, uint32_t frames);
+  // false once every node of the block is taken
+  bool runReadyNode();
+  void workerLoop();
+  void startWorkers();
+  void stopWorkers();
+
+  std::function<void()> setupWorker;
+  std::vector<std::unique_ptr<Clap::Library>> libraries;
+  std::vector<std::unique_ptr<Node>> nodes;
+  // a topological order, and ancestors[a][b] if a has to finish before b starts
+  std::vector<uint32_t> order;
+  std::vector<std::vector<bool>> ancestors;
+  std::vector<std::vector<Source>> deviceOutputSources;
+  uint32_t threads{0};
+
+  AlignedMemory arena;
+  uint32_t arenaRows{0}, rowStride{0};
+  float *silentRow{nullptr};
+
+  // the state of the current block, shared by the audio thread and the workers
+  const clap_process *hostProcess{nullptr};
+  float *const *blockDeviceIn{nullptr};
+  uint32_t blockDeviceInputs{0};
+  std::unique_ptr<std::atomic<int32_t>[]> ready;
+  std::atomic<uint32_t> readyHead{0}, readyTail{0}, done{0};
+  uint32_t blockFrames{0};
+
+  std::vector<std::thread> workers;
+  std::atomic<bool> workersRunning{false};
+  std::atomic<uint64_t> generation{0};
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+};
+}  // namespace freeaudio::clap_wrapper::standalone
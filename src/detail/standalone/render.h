@@ -0,0 +1,46 @@
+#pragma once
+
+/*
+ * The headless offline render of the standalone. With --render the standalone opens no audio
+ * or MIDI device and no window, it runs the plugin over an input WAV and/or a MIDI file as
+ * fast as the plugin allows and writes the result to a WAV file. --benchmark SECONDS runs the
+ * plugin on the null audio backend instead, as fast as possible or --paced to the clock, and
+ * logs the throughput and the wrapper overhead. Both run the plugin graph of --graph FILE if
+ * one is given.
+ */
+
+#include <cstdint>
+#include <string>
+
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct RenderSettings
+{
+  fs::path output, input, midi, state, graph;
+  uint32_t blockSize{512};
+  // 0 takes the rate of the input file, or 48000 without one
+  int32_t sampleRate{0};
+  // the length without an input file, 0 ends with the last MIDI event
+  double lengthSeconds{0};
+  // rendered after the input for reverb tails and note releases
+  double tailSeconds{0};
+  double tempo{120};
+  // > 0 runs the benchmark instead of a render
+  double benchmarkSeconds{0};
+  bool benchmarkPaced{false};
+};
+
+enum class RenderCommandLine
+{
+  NoRender,
+  Render,
+  Benchmark,
+  Invalid
+};
+
+// looks for --render or --benchmark and the options which go with them, before any UI toolkit
+// sees the arguments
+RenderCommandLine parseRenderCommandLine(int argc, char **argv, RenderSettings &settings);
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -1,7 +1,12 @@
 
 #include <cassert>
 #include "standalone_host.h"
+#include "interleave.h"
+#include "state_file.h"
+#include "detail/shared/audiothread_guard.h"
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 
 #if LIN
 #if CLAP_WRAPPER_HAS_GTK3
@@ -75,7 +80,6 @@ void StandaloneHost::setupAudioBusses(const clap_plugin_t *plugin,
     if (info.flags & CLAP_AUDIO_PORT_IS_MAIN) mainOutput = i;
   }
 
-  assert(totalOutputChannels + totalInputChannels < utilityBufferMaxChannels);
   if (numAudioInputs > 0) LOG << "main audio input is " << mainInput << std::endl;
 
   if (numAudioOutputs > 0) LOG << "main audio output is " << mainOutput << std::endl;
@@ -103,118 +107,132 @@ void StandaloneHost::setupMIDIBusses(const clap_plugin_t *plugin,
   if (numMIDIOutPorts > 0)
   {
     createsMidiOutput = true;
-    LOG << "Midi Output not supported yet" << std::endl;
+    LOG << "Set up output: " << numMIDIOutPorts << " note ports" << std::endl;
   }
 }
 
-void StandaloneHost::clapProcess(void *pOutput, const void *pInput, uint32_t frameCount)
+void StandaloneHost::clapProcess(void *pOutput, const void *pInput, uint32_t frameCount,
+                                 double streamTime)
 {
+  ClapWrapper::detail::shared::AudioThreadSection audiothread("StandaloneHost::clapProcess");
+
   if (!running)
   {
     finishedRunning = true;
     return;
   }
 
-  auto f = (float *)pOutput;
   clap_process process;
-  process.transport = nullptr;
+  process.transport = &transport;
+  process.steady_time = steadyTime;
   process.in_events = &inputEvents;
   process.out_events = &outputEvents;
   process.frames_count = frameCount;
 
-  assert(frameCount < utilityBufferSize);
-  if (frameCount >= utilityBufferSize)
+  assert(frameCount <= maxProcessFrames);
+  if (frameCount > maxProcessFrames)
   {
-    LOG << "frameCount " << frameCount << " is beyond utility buffer size " << utilityBufferSize
+    LOG << "frameCount " << frameCount << " is beyond the activated block size " << maxProcessFrames
         << std::endl;
     std::terminate();
   }
 
-  process.audio_outputs_count = 1;
-
-  float *bufferChanPtr[utilityBufferMaxChannels]{};
-  clap_audio_buffer buffers[utilityBufferMaxChannels]{};  // probably twice as large
-  size_t ptrIdx{0};
-  size_t bufIdx{0};
+  process.audio_inputs_count = numAudioInputs;
+  process.audio_outputs_count = numAudioOutputs;
+  process.audio_inputs = inputPorts.data();
+  process.audio_outputs = outputPorts.data();
 
-  int32_t mainOutIdx{-1}, mainInIdx{-1};
+  // The routing table is built on activation. With a non interleaved stream the routed channels
+  // work directly on the device buffers, otherwise they are (de)interleaved from and to channel rows
+  auto *devIn = (float *)pInput;
+  auto *devOut = (float *)pOutput;
+  bool planar = streamNonInterleaved;
 
-  process.audio_inputs = &(buffers[0]);
-  for (auto inp = 0U; inp < numAudioInputs; ++inp)
+  if (devIn)
   {
-    // For now assert sterep
-    assert(inputChannelByBus[inp] == 2);
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    memset(bufferChanPtr[ptrIdx], 0, frameCount * sizeof(float));
-    ptrIdx++;
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    memset(bufferChanPtr[ptrIdx], 0, frameCount * sizeof(float));
-    ptrIdx++;
-
-    buffers[bufIdx].channel_count = 2;
-    buffers[bufIdx].data32 = &(bufferChanPtr[ptrIdx - 2]);
-
-    if (mainInIdx < 0)
+    if (planar)
     {
-      // TODO cleaner
-      mainInIdx = (int32_t)(ptrIdx - 2);
+      for (auto d = 0U; d < streamInputChannels; ++d)
+      {
+        inputSlots[d] = devIn + d * frameCount;
+      }
+    }
+    else
+    {
+      deinterleave(devIn, streamInputChannels, inputSlots.data(), streamInputChannels, frameCount);
     }
-    bufIdx++;
   }
-
-  process.audio_outputs = &(buffers[bufIdx]);
-  for (auto oup = 0U; oup < numAudioOutputs; ++oup)
+  if (devOut && planar)
   {
-    // For now assert sterep
-    assert(outputChannelByBus[oup] == 2);
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    ptrIdx++;
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    ptrIdx++;
-
-    buffers[bufIdx].channel_count = 2;
-    buffers[bufIdx].data32 = &(bufferChanPtr[ptrIdx - 2]);
-
-    if (mainOutIdx < 0)
+    for (auto d = 0U; d < streamOutputChannels; ++d)
     {
-      // TODO cleaner
-      mainOutIdx = (int32_t)(ptrIdx - 2);
+      outputSlots[d] = devOut + d * frameCount;
     }
+  }
+  for (auto i = 0U; i < inputChannelPtr.size(); ++i)
+  {
+    inputChannelPtr[i] = inputSlots[inputSlotByChannel[i]];
+  }
+  for (auto i = 0U; i < outputChannelPtr.size(); ++i)
+  {
+    outputChannelPtr[i] = outputSlots[outputSlotByChannel[i]];
+  }
 
-    bufIdx++;
+  clearInputEvents();
+  if (offlineRender)
+  {
+    deliverRenderEvents(frameCount);
+  }
+  else
+  {
+    deliverMIDIEvents(frameCount, streamTime);
   }
+  prepareTransport(frameCount);
 
-  if (mainInIdx >= 0 && pInput)
+  // the graph works on the device slots and fills every device output itself
+  auto processPlugin = [&]()
   {
-    auto *g = (const float *)pInput;
-    for (auto i = 0U; i < frameCount; ++i)
+    if (graph)
     {
-      utilityBuffer[mainInIdx][i] = g[2 * i];
-      utilityBuffer[mainInIdx + 1][i] = g[2 * i + 1];
+      graph->process(process, inputSlots.data(), devIn ? streamInputChannels : 0, outputSlots.data(),
+                     devOut ? streamOutputChannels : 0);
     }
+    else
+    {
+      clapPlugin->_plugin->process(clapPlugin->_plugin, &process);
+    }
+  };
+  if (measurePluginTime)
+  {
+    auto start = monotonicNanoseconds();
+    processPlugin();
+    pluginProcessNanoseconds.store(
+        pluginProcessNanoseconds.load(std::memory_order_relaxed) + monotonicNanoseconds() - start,
+        std::memory_order_relaxed);
   }
-
-  clearInputEvents();
-  clap_event_midi midi;
-  midiChunk ck;
-  while (midiToAudioQueue.pop(ck))
+  else
   {
-    midi.port_index = 0;
-    midi.header.size = sizeof(clap_event_midi);
-    midi.header.time = 0;
-    midi.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-    midi.header.type = CLAP_EVENT_MIDI;
-    midi.header.flags = 0;
-    memcpy(midi.data, ck.dat, sizeof(ck.dat));
-    pushInputEvent(&(midi.header));
+    processPlugin();
   }
+  advanceTransport(frameCount);
 
-  clapPlugin->_plugin->process(clapPlugin->_plugin, &process);
-
-  for (auto i = 0U; i < frameCount; ++i)
+  if (devOut)
   {
-    f[2 * i] = utilityBuffer[mainOutIdx][i];
-    f[2 * i + 1] = utilityBuffer[mainOutIdx + 1][i];
+    if (numAudioOutputs == 0 && !graph)
+    {
+      memset(devOut, 0, frameCount * streamOutputChannels * sizeof(float));
+    }
+    else if (!planar)
+    {
+      interleave(outputSlots.data(), streamOutputChannels, devOut, streamOutputChannels, frameCount);
+    }
+    else if (!graph)
+    {
+      for (auto d : unroutedDeviceOutputs)
+      {
+        memset(devOut + d * frameCount, 0, frameCount * sizeof(float));
+      }
+    }
   }
 }
 
@@ -248,7 +266,8 @@ const char *StandaloneHost::host_get_name()
 bool StandaloneHost::register_timer(uint32_t period_ms, clap_id *timer_id)
 {
 #if LIN && CLAP_WRAPPER_HAS_GTK3
-  assert(gtkGui);
+  // there is no gui in an offline render
+  if (!gtkGui) return false;
   return gtkGui->register_timer(period_ms, timer_id);
 #else
   return false;
@@ -257,6 +276,7 @@ bool StandaloneHost::register_timer(uint32_t period_ms, clap_id *timer_id)
 bool StandaloneHost::unregister_timer(clap_id timer_id)
 {
 #if LIN && CLAP_WRAPPER_HAS_GTK3
+  if (!gtkGui) return false;
   return gtkGui->unregister_timer(timer_id);
 #else
   return false;
@@ -266,6 +286,7 @@ bool StandaloneHost::unregister_timer(clap_id timer_id)
 bool StandaloneHost::register_fd(int fd, clap_posix_fd_flags_t flags)
 {
 #if LIN && CLAP_WRAPPER_HAS_GTK3
+  if (!gtkGui) return false;
   return gtkGui->register_fd(fd, flags);
 #else
   return false;
@@ -278,6 +299,7 @@ bool StandaloneHost::modify_fd(int fd, clap_posix_fd_flags_t flags)
 bool StandaloneHost::unregister_fd(int fd)
 {
 #if LIN && CLAP_WRAPPER_HAS_GTK3
+  if (!gtkGui) return false;
   return gtkGui->unregister_fd(fd);
 #else
   return false;
@@ -295,26 +317,6 @@ bool StandaloneHost::unregister_timer(clap_id timer_id)
 }
 #endif
 
-static int64_t clapwrite(const clap_ostream *s, const void *buffer, uint64_t size)
-{
-  auto ofs = static_cast<std::ofstream *>(s->ctx);
-  ofs->write((const char *)buffer, size);
-  return size;
-}
-
-static int64_t clapread(const struct clap_istream *s, void *buffer, uint64_t size)
-{
-  auto ifs = static_cast<std::ifstream *>(s->ctx);
-
-  // Oh this API is so terrible. I think this is right?
-  ifs->read(static_cast<char *>(buffer), size);
-  if (ifs->rdstate() == std::ios::goodbit || ifs->rdstate() == std::ios::eofbit) return ifs->gcount();
-
-  if (ifs->rdstate() & std::ios::eofbit) return ifs->gcount();
-
-  return -1;
-}
-
 bool StandaloneHost::saveStandaloneAndPluginSettings(const fs::path &intoDir, const fs::path &withName)
 {
   // This should obviously be a more robust file format. What we
@@ -322,23 +324,23 @@ bool StandaloneHost::saveStandaloneAndPluginSettings(const fs::path &intoDir, co
   // the streamed plugin data. What we have here is just the streamed
   // plugin data with no settings space for audio port selection etc...
 
-  std::ofstream ofs(intoDir / withName, std::ios::out | std::ios::binary);
-  if (!ofs.is_open())
+  if (!clapPlugin || !clapPlugin->_ext._state)
+  {
+    return false;
+  }
+  StateFileWriter writer;
+  if (!writer.open(intoDir / withName))
   {
     LOG << "Unable to open for writing " << (intoDir / withName).u8string() << std::endl;
     return false;
   }
-  if (!clapPlugin || !clapPlugin->_ext._state)
+  if (!clapPlugin->_ext._state->save(clapPlugin->_plugin, writer.stream()))
   {
+    LOG << "The plugin failed to save its state, keeping " << (intoDir / withName).u8string()
+        << std::endl;
     return false;
   }
-  clap_ostream cos{};
-  cos.ctx = &ofs;
-  cos.write = clapwrite;
-  clapPlugin->_ext._state->save(clapPlugin->_plugin, &cos);
-  ofs.close();
-
-  return true;
+  return writer.commit();
 }
 
 bool StandaloneHost::tryLoadStandaloneAndPluginSettings(const fs::path &fromDir,
@@ -347,8 +349,8 @@ bool StandaloneHost::tryLoadStandaloneAndPluginSettings(const fs::path &fromDir,
   // see comment above on this file format being not just the
   // raw stream in the future
   auto fsp = fromDir / withName;
-  std::ifstream ifs(fsp, std::ios::in | std::ios::binary);
-  if (!ifs.is_open())
+  MappedStateFile file;
+  if (!file.open(fsp))
   {
     LOG << "Unable to open for reading " << fsp.u8string() << std::endl;
     return false;
@@ -357,18 +359,139 @@ bool StandaloneHost::tryLoadStandaloneAndPluginSettings(const fs::path &fromDir,
   {
     return false;
   }
-  clap_istream cis{};
-  cis.ctx = &ifs;
-  cis.read = clapread;
-  clapPlugin->_ext._state->load(clapPlugin->_plugin, &cis);
-  ifs.close();
+  clapPlugin->_ext._state->load(clapPlugin->_plugin, file.stream());
+  return true;
+}
+
+bool StandaloneHost::saveStandaloneSettings(const fs::path &intoDir, const fs::path &withName)
+{
+  StateFileWriter writer;
+  if (!writer.open(intoDir / withName))
+  {
+    LOG << "Unable to open for writing " << (intoDir / withName).u8string() << std::endl;
+    return false;
+  }
+  std::ostringstream ofs;
+  auto bufferSize =
+      (startBufferFrames == autoBufferFrames) ? std::string("auto") : std::to_string(startBufferFrames);
+  ofs << "buffer-size=" << bufferSize << "\n";
+  if (inputRoutingSet)
+  {
+    ofs << "input-routing=" << routingToString(inputRouting) << "\n";
+  }
+  if (outputRoutingSet)
+  {
+    ofs << "output-routing=" << routingToString(outputRouting) << "\n";
+  }
+  ofs << "lock-memory=" << (lockAudioMemory ? "true" : "false") << "\n";
+  ofs << "midi-latency=" << midiLatencyToString(midiLatencyFrames) << "\n";
+  ofs << "midi-output=" << midiOutputPorts << "\n";
+  auto settings = ofs.str();
+  return writer.write(settings.data(), settings.size()) && writer.commit();
+}
+
+bool StandaloneHost::tryLoadStandaloneSettings(const fs::path &fromDir, const fs::path &withName)
+{
+  auto fsp = fromDir / withName;
+  std::ifstream ifs(fsp, std::ios::in);
+  if (!ifs.is_open())
+  {
+    LOG << "Unable to open for reading " << fsp.u8string() << std::endl;
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    auto eq = line.find('=');
+    if (eq == std::string::npos)
+    {
+      continue;
+    }
+    auto key = line.substr(0, eq);
+    auto value = line.substr(eq + 1);
+
+    if (key == "buffer-size" && !startBufferFramesSet)
+    {
+      if (auto frames = parseBufferFrames(value); frames.has_value())
+      {
+        startBufferFrames = *frames;
+      }
+      else
+      {
+        LOG << "Ignoring invalid buffer-size '" << value << "'" << std::endl;
+      }
+    }
+    else if (key == "lock-memory" && !lockAudioMemorySet)
+    {
+      lockAudioMemory = (value == "true");
+    }
+    else if (key == "midi-output" && !midiOutputPortsSet)
+    {
+      midiOutputPorts = value;
+    }
+    else if (key == "midi-latency" && !midiLatencySet)
+    {
+      if (auto frames = parseMIDILatency(value); frames.has_value())
+      {
+        midiLatencyFrames = *frames;
+      }
+      else
+      {
+        LOG << "Ignoring invalid midi-latency '" << value << "'" << std::endl;
+      }
+    }
+    else if ((key == "input-routing" && !inputRoutingSet) ||
+             (key == "output-routing" && !outputRoutingSet))
+    {
+      if (auto routing = parseRouting(value); routing.has_value())
+      {
+        if (key == "input-routing")
+        {
+          setInputRouting(*routing);
+        }
+        else
+        {
+          setOutputRouting(*routing);
+        }
+      }
+      else
+      {
+        LOG << "Ignoring invalid " << key << " '" << value << "'" << std::endl;
+      }
+    }
+  }
   return true;
 }
 
+std::optional<uint32_t> StandaloneHost::parseBufferFrames(const std::string &value)
+{
+  if (value == "auto")
+  {
+    return autoBufferFrames;
+  }
+  try
+  {
+    auto frames = std::stoul(value);
+    if (frames > 0 && frames <= maxBufferFrames)
+    {
+      return (uint32_t)frames;
+    }
+  }
+  catch (const std::exception &)
+  {
+  }
+  return std::nullopt;
+}
+
 void StandaloneHost::activatePlugin(int32_t sr, int32_t minBlock, int32_t maxBlock)
 {
   if (isActive)
   {
+    if (graph)
+    {
+      graph->deactivate();
+    }
     clapPlugin->stop_processing();
     clapPlugin->deactivate();
     isActive = false;
@@ -378,11 +501,42 @@ void StandaloneHost::activatePlugin(int32_t sr, int32_t minBlock, int32_t maxBlo
       << std::endl;
   clapPlugin->setSampleRate(sr);
   clapPlugin->setBlockSizes(minBlock, maxBlock);
+  allocateProcessMemory(maxBlock);
+  buildRoutingTable();
   clapPlugin->activate();
 
   clapPlugin->start_processing();
+  if (graph)
+  {
+    graph->activate(sr, minBlock, maxBlock, lockAudioMemory);
+  }
 
   isActive = true;
 }
 
+void StandaloneHost::allocateProcessMemory(uint32_t maxFrames)
+{
+  // the silent row, the device channels of an interleaved stream and every output channel
+  // of the plugin, which may all end up on scratch rows
+  channelRows = 1 + streamOutputChannels + totalOutputChannels;
+  if (!streamNonInterleaved)
+  {
+    channelRows += streamInputChannels;
+  }
+  channelRowStride = (uint32_t)AlignedMemory::alignedCount<float>(maxFrames);
+
+  if (!channelMemory.allocate(sizeof(float) * channelRows * channelRowStride, lockAudioMemory) ||
+      !eventArena.allocate(eventArenaSize, lockAudioMemory) ||
+      !sysexArena.allocate(sysexArenaSize, lockAudioMemory))
+  {
+    std::terminate();
+  }
+  maxProcessFrames = maxFrames;
+  silentBuffer = channelRow(0);
+  clearInputEvents();
+
+  LOG << "Allocated " << channelRows << " channel buffers of " << maxFrames << " frames"
+      << (channelMemory.isLocked() ? " (locked)" : "") << std::endl;
+}
+
 }  // namespace freeaudio::clap_wrapper::standalone
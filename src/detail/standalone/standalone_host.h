@@ -1,10 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <cstring>
 #include <unordered_map>
 #include <unordered_set>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <optional>
 #include <tuple>
 
@@ -25,7 +27,14 @@
 #endif
 
 #include "clap_proxy.h"
+#include "aligned_memory.h"
+#include "audio_ring.h"
+#include "audio_stats.h"
+#include "midifile.h"
+#include "plugin_graph.h"
+#include "render.h"
 #include "detail/shared/fixedqueue.h"
+#include "detail/shared/bytequeue.h"
 
 namespace freeaudio::clap_wrapper::standalone
 {
@@ -49,6 +58,14 @@ struct Win32Gui;
 
 std::optional<fs::path> getStandaloneSettingsPath();
 
+// the monotonic clock used for the audio and MIDI timestamps
+inline int64_t monotonicNanoseconds()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 struct StandaloneHost : Clap::IHost
 {
   StandaloneHost()
@@ -63,7 +80,8 @@ struct StandaloneHost : Clap::IHost
 
   static bool oe_try_push(const struct clap_output_events *oe, const clap_event_header_t *evt)
   {
-    return true;
+    auto sh = (StandaloneHost *)oe->ctx;
+    return sh->queueOutputEvent(evt);
   }
 
   static uint32_t ie_getsize(const struct clap_input_events *ie)
@@ -77,21 +95,28 @@ struct StandaloneHost : Clap::IHost
     return sh->inputEvent(idx);
   }
 
-  static constexpr int maxEventsPerCycle{256};
-  static constexpr int eventSize{1024};
-  static constexpr int queueSize{eventSize * maxEventsPerCycle};
-  const unsigned char eventQueue[queueSize]{};
+  // The input events of a block are packed into an arena which is allocated on activation,
+  // each event starts at an 8 byte boundary.
+  static constexpr uint32_t maxEventsPerCycle{1024};
+  static constexpr uint32_t eventArenaSize{64 * 1024};
+  static constexpr uint32_t eventAlignment{8};
+  AlignedMemory eventArena;
+  uint32_t eventOffsets[maxEventsPerCycle]{};
+  uint32_t eventArenaUsed{0};
 
-  int currInput{0};
+  uint32_t currInput{0};
   void clearInputEvents()
   {
     currInput = 0;
+    eventArenaUsed = 0;
+    sysexArenaUsed = 0;
   }
   bool pushInputEvent(clap_event_header_t *event)
   {
-    if (event->size > eventSize)
+    auto size = (event->size + eventAlignment - 1) & ~(eventAlignment - 1);
+    if (eventArenaUsed + size > eventArena.size())
     {
-      LOG << "BAD EVENT" << std::endl;
+      LOG << "EVENT ARENA FULL" << std::endl;
       return false;
     }
     if (currInput >= maxEventsPerCycle)
@@ -99,17 +124,36 @@ struct StandaloneHost : Clap::IHost
       LOG << "TOO MANY EVENTS" << std::endl;
       return false;
     }
-    memcpy((void *)(eventQueue + currInput * eventSize), (const void *)event, event->size);
+    memcpy((void *)(eventArena.as<unsigned char>() + eventArenaUsed), (const void *)event, event->size);
+    eventOffsets[currInput] = eventArenaUsed;
+    eventArenaUsed += size;
     currInput++;
     return true;
   }
+  // like pushInputEvent, but keeps the events ordered by time if this one is earlier
+  bool insertInputEvent(clap_event_header_t *event)
+  {
+    if (!pushInputEvent(event))
+    {
+      return false;
+    }
+    auto offset = eventOffsets[currInput - 1];
+    auto at = currInput - 1;
+    while (at > 0 && inputEvent(at - 1)->time > event->time)
+    {
+      eventOffsets[at] = eventOffsets[at - 1];
+      at--;
+    }
+    eventOffsets[at] = offset;
+    return true;
+  }
   uint32_t inputEventSize()
   {
     return currInput;
   }
   const clap_event_header_t *inputEvent(uint32_t idx)
   {
-    return (const clap_event_header_t *)(eventQueue + idx * eventSize);
+    return (const clap_event_header_t *)(eventArena.as<unsigned char>() + eventOffsets[idx]);
   }
 
   std::shared_ptr<Clap::Plugin> clapPlugin;
@@ -138,6 +182,10 @@ struct StandaloneHost : Clap::IHost
   bool saveStandaloneAndPluginSettings(const fs::path &intoDir, const fs::path &withName);
   bool tryLoadStandaloneAndPluginSettings(const fs::path &fromDir, const fs::path &withName);
 
+  // the settings of the standalone itself (buffer size etc.) as key=value lines
+  bool saveStandaloneSettings(const fs::path &intoDir, const fs::path &withName);
+  bool tryLoadStandaloneSettings(const fs::path &fromDir, const fs::path &withName);
+
   uint32_t numAudioInputs{0}, numAudioOutputs{0};
   std::vector<uint32_t> inputChannelByBus;
   std::vector<uint32_t> outputChannelByBus;
@@ -242,12 +290,66 @@ struct StandaloneHost : Clap::IHost
   struct midiChunk
   {
     char dat[3]{};
+    int64_t receivedNanoseconds{0};
     midiChunk()
     {
       memset(dat, 0, sizeof(dat));
     }
   };
   ClapWrapper::detail::shared::fixedqueue<midiChunk, 4096> midiToAudioQueue;
+  // SysEx and other long messages, each record is the receive time followed by the message.
+  // They are copied into a per block arena which stays valid for the process call.
+  static constexpr uint32_t sysexArenaSize{64 * 1024};
+  ClapWrapper::detail::shared::bytequeue<128 * 1024> sysexToAudioQueue;
+  AlignedMemory sysexArena;
+  uint32_t sysexArenaUsed{0};
+  // each RtMidiIn calls back on its own thread, the queues only have a single producer
+  std::atomic_flag midiProducerLock = ATOMIC_FLAG_INIT;
+
+  // With midiLatencyImmediate all messages arrive at the start of the next block. Otherwise
+  // they are delayed by a fixed number of frames after they were received, midiLatencyBlock
+  // being one buffer, which keeps their timing sample accurate.
+  static constexpr int32_t midiLatencyImmediate{-1}, midiLatencyBlock{-2};
+  int32_t midiLatencyFrames{midiLatencyBlock};
+  bool midiLatencySet{false};
+  void setMIDILatency(int32_t frames)
+  {
+    midiLatencySet = true;
+    midiLatencyFrames = frames;
+  }
+  // accepts "off", "block" or a number of frames
+  static std::optional<int32_t> parseMIDILatency(const std::string &value);
+  static std::string midiLatencyToString(int32_t frames);
+
+  // maps the monotonic clock to the stream sample position, smoothed over the callbacks
+  double midiClockOffsetSamples{0};
+  bool midiClockValid{false};
+  double midiBlockStartSample{0};
+  uint32_t midiBlockFrames{0};
+  // the next short message, taken from the queue ahead of time to merge it with the long ones
+  midiChunk pendingMIDI;
+  bool hasPendingMIDI{false};
+  void deliverMIDIEvents(uint32_t frameCount, double streamTime);
+
+  // MIDI output. The audio thread queues the plugin's MIDI, SysEx and note events with the
+  // time they are due, a dedicated thread sends them to the RtMidiOut ports. midiOutputPorts
+  // is "all" (but through ports), "none" or the index of a single port.
+  ClapWrapper::detail::shared::bytequeue<64 * 1024> midiFromAudioQueue;
+  std::vector<std::unique_ptr<RtMidiOut>> midiOuts;
+  std::string midiOutputPorts{"all"};
+  bool midiOutputPortsSet{false};
+  void setMIDIOutputPorts(const std::string &ports)
+  {
+    midiOutputPortsSet = true;
+    midiOutputPorts = ports;
+  }
+  std::thread midiOutThread;
+  std::atomic<bool> midiOutRunning{false};
+  void startMIDIOutput();
+  bool queueOutputEvent(const clap_event_header_t *evt);
+  void runMIDIOutput();
+  // the length of a short MIDI message from its status byte
+  static uint32_t midiMessageSize(unsigned char status);
   std::vector<std::unique_ptr<RtMidiIn>> midiIns;
   void startMIDIThread();
   void stopMIDIThread();
@@ -255,7 +357,45 @@ struct StandaloneHost : Clap::IHost
   static void midiCallback(double deltatime, std::vector<unsigned char> *message, void *userData);
 
   // in standalone_host.cpp
-  void clapProcess(void *pOutput, const void *pInoput, uint32_t frameCount);
+  // The host transport, in standalone_host_transport.cpp. The UI and command line edit a
+  // TransportSettings and hand a copy to the audio thread through transportToAudioQueue, the
+  // audio thread converts it once per block and only advances the position.
+  struct TransportSettings
+  {
+    double tempo{120};
+    uint16_t tsigNum{4}, tsigDenom{4};
+    bool playing{true};
+    bool loopActive{false};
+    double loopStartBeats{0}, loopEndBeats{16};
+    bool rewind{false};
+  };
+  TransportSettings transportSettings;
+  void setTransport(const TransportSettings &settings);
+  void rewindTransport();
+  // accepts "N/D"
+  static bool parseTimeSignature(const std::string &value, uint16_t &num, uint16_t &denom);
+  // accepts "START:END" in beats
+  static bool parseLoop(const std::string &value, double &start, double &end);
+
+  ClapWrapper::detail::shared::fixedqueue<TransportSettings, 64> transportToAudioQueue;
+  TransportSettings audioTransportSettings;
+  clap_event_transport transport{};
+  double transportBeats{0};
+  int64_t steadyTime{0};
+  void prepareTransport(uint32_t frameCount);
+  void advanceTransport(uint32_t frameCount);
+
+  // The offline render, in standalone_host_render.cpp. It drives clapProcess with the blocks of
+  // the input file and, while offlineRender is set, the events come from the MIDI file.
+  int renderOffline(const RenderSettings &settings);
+  bool offlineRender{false};
+  std::vector<MidiFileEvent> renderMIDI;
+  size_t renderMIDINext{0};
+  int64_t renderPosition{0};
+  void deliverRenderEvents(uint32_t frameCount);
+
+  // streamTime is the time of the first frame in seconds as reported by RtAudio
+  void clapProcess(void *pOutput, const void *pInoput, uint32_t frameCount, double streamTime);
 
   // Actual audio IO In standalone_host_audio.cpp
   std::unique_ptr<RtAudio> rtaDac;
@@ -263,6 +403,9 @@ struct StandaloneHost : Clap::IHost
   unsigned int audioInputDeviceID{0}, audioOutputDeviceID{0};
   bool audioInputUsed{true}, audioOutputUsed{true};
   int32_t currentSampleRate{0};
+  // the layout of the open stream. A non interleaved stream is handed to the plugin without copies
+  bool streamNonInterleaved{true};
+  uint32_t streamInputChannels{0}, streamOutputChannels{0};
   void guaranteeRtAudioDAC();
   std::tuple<unsigned int, unsigned int, int32_t> getDefaultAudioInOutSampleRate();
   void startAudioThread();
@@ -271,6 +414,82 @@ struct StandaloneHost : Clap::IHost
                           int32_t sampleRate);
   void stopAudioThread();
 
+  // The null audio backend, in standalone_host_nullaudio.cpp. A thread of the host calls
+  // clapProcess without a device, paced to a virtual clock or as fast as the plugin allows.
+  // It is used when RtAudio finds no devices. While it runs clapProcess also times the plugin's
+  // own process call, so the report can tell the wrapper overhead from the plugin.
+  enum class NullAudio
+  {
+    Off,
+    Paced,
+    Fast
+  };
+  NullAudio nullAudio{NullAudio::Off};
+  void setNullAudio(NullAudio mode)
+  {
+    nullAudio = mode;
+  }
+  // accepts "off", "paced" or "fast"
+  static std::optional<NullAudio> parseNullAudio(const std::string &value);
+  std::thread nullAudioThread;
+  std::atomic<bool> nullAudioRunning{false};
+  // stops the thread after this many frames, 0 runs until stopNullAudioThread
+  int64_t nullAudioFrameLimit{0};
+  AlignedMemory nullAudioMemory;
+  std::atomic<uint64_t> nullAudioBlocks{0};
+  std::atomic<int64_t> nullAudioProcessNanoseconds{0}, nullAudioWallNanoseconds{0};
+  bool measurePluginTime{false};
+  std::atomic<int64_t> pluginProcessNanoseconds{0};
+  void startNullAudioThread(NullAudio mode);
+  void runNullAudio(NullAudio mode);
+  void stopNullAudioThread();
+  std::string nullAudioReport() const;
+  // the headless --benchmark, runs the null audio for the given length and logs the report
+  int runBenchmark(const RenderSettings &settings);
+
+  // The decoupled plugin block, in standalone_host_decoupled.cpp. With a plugin block size the
+  // plugin runs on a realtime thread of its own in blocks of that size, and the device callback
+  // only moves audio through two rings. The output ring starts with decoupledLatencyFrames of
+  // silence, enough to collect one plugin block and to compute the next, which is the latency
+  // the mode adds. An output block which isn't ready in time is played as silence and counted
+  // as an xrun, the late frames are dropped so the latency stays the same.
+  uint32_t pluginBlockFrames{0};
+  void setPluginBlockFrames(uint32_t frames)
+  {
+    pluginBlockFrames = frames;
+  }
+  bool decoupled{false};
+  bool decoupledDeviceInterleaved{false};
+  uint32_t decoupledLatencyFrames{0};
+  AudioRing decoupledInput, decoupledOutput;
+  // the planar plugin block and the device channel pointers
+  AlignedMemory decoupledMemory;
+  std::vector<const float *> decoupledDeviceIn;
+  std::vector<float *> decoupledDeviceOut, decoupledPluginIn, decoupledPluginOut;
+  // device thread only, the output frames still to be dropped after an underrun
+  uint32_t decoupledDebtFrames{0};
+  std::thread decoupledThread;
+  std::atomic<bool> decoupledRunning{false};
+  std::mutex decoupledMutex;
+  std::condition_variable decoupledWake;
+  void startDecoupled(uint32_t deviceFrames);
+  void runDecoupled(uint32_t deviceFrames);
+  void stopDecoupled();
+  // the device callback while decoupled, returns false on an underrun or an overflow
+  bool decoupledCallback(void *pOutput, const void *pInput, uint32_t frameCount);
+
+  // The plugin graph, in standalone_host_graph.cpp. With --graph the standalone's plugin is the
+  // node 'main' of a graph of plugins, which processes in its place and is activated with it.
+  // The routing options don't apply, the connections to 'in' and 'out' pick the device channels.
+  fs::path graphFile;
+  std::unique_ptr<PluginGraph> graph;
+  void setGraphFile(const fs::path &file)
+  {
+    graphFile = file;
+  }
+  bool loadGraph();
+  void unloadGraph();
+
   bool startupAudioSet{false};
   unsigned int startAudioIn{0}, startAudioOut{0};
   int startSampleRate{0};
@@ -282,6 +501,55 @@ struct StandaloneHost : Clap::IHost
     startSampleRate = sr;
   }
 
+  // the buffer size in frames, autoBufferFrames probes for the smallest size that runs without xruns.
+  // A size given on the command line takes precedence over the one from the settings file.
+  static constexpr uint32_t autoBufferFrames{0};
+  uint32_t startBufferFrames{256};
+  bool startBufferFramesSet{false};
+  uint32_t currentBufferFrames{0};
+  void setStartupBufferFrames(uint32_t frames)
+  {
+    startBufferFramesSet = true;
+    startBufferFrames = frames;
+  }
+  // accepts "auto" or a number of frames
+  static std::optional<uint32_t> parseBufferFrames(const std::string &value);
+  uint32_t calibrateBufferFrames(RtAudio::StreamParameters *oParams, RtAudio::StreamParameters *iParams,
+                                 int32_t sampleRate);
+
+  // Routing of the plugin port channels to the device channels, in standalone_host_routing.cpp.
+  // Without a routing the main port goes to the first device channels and the other ports follow.
+  struct AudioRoute
+  {
+    uint32_t port{0}, channel{0}, deviceChannel{0};
+  };
+  std::vector<AudioRoute> inputRouting, outputRouting;
+  bool inputRoutingSet{false}, outputRoutingSet{false};
+  void setInputRouting(const std::vector<AudioRoute> &routing)
+  {
+    inputRoutingSet = true;
+    inputRouting = routing;
+  }
+  void setOutputRouting(const std::vector<AudioRoute> &routing)
+  {
+    outputRoutingSet = true;
+    outputRouting = routing;
+  }
+  // accepts a comma separated list of port:channel=devicechannel
+  static std::optional<std::vector<AudioRoute>> parseRouting(const std::string &value);
+  static std::string routingToString(const std::vector<AudioRoute> &routing);
+  std::vector<AudioRoute> effectiveRouting(bool isInput) const;
+  uint32_t requiredDeviceChannels(bool isInput) const;
+
+  // Built on activation so the audio thread only copies pointers. A slot is a channel buffer, the
+  // first streamChannels slots are the device channels and the others are silence or scratch rows.
+  void buildRoutingTable();
+  std::vector<clap_audio_buffer> inputPorts, outputPorts;
+  std::vector<float *> inputChannelPtr, outputChannelPtr;
+  std::vector<float *> inputSlots, outputSlots;
+  std::vector<uint32_t> inputSlotByChannel, outputSlotByChannel;
+  std::vector<uint32_t> unroutedDeviceOutputs;
+
   void activatePlugin(int32_t sr, int32_t minBlock, int32_t maxBlock);
   bool isActive{false};
 
@@ -293,12 +561,45 @@ struct StandaloneHost : Clap::IHost
 
   std::atomic<bool> running{true}, finishedRunning{false};
 
-  // We need to have play buffers for the clap. For now lets assume
-  // (1) the standalone is never more than 64 total ins and outs and
-  // (2) the block size is less that 4096 * 16 and
-  // (3) memory in the standalone is pretty cheap
-  static constexpr int utilityBufferSize{4096 * 16};
-  static constexpr int utilityBufferMaxChannels{64};
-  float utilityBuffer[utilityBufferMaxChannels][utilityBufferSize]{};
+  // The channel buffers for the plugin are allocated on activation, one cache line aligned row of
+  // maxProcessFrames for each channel the routing may need. The first row is the silent buffer,
+  // shared by all inputs without a source and never written by the host.
+  static constexpr uint32_t maxBufferFrames{4096 * 16};
+  AlignedMemory channelMemory;
+  uint32_t channelRowStride{0}, channelRows{0}, maxProcessFrames{0};
+  float *silentBuffer{nullptr};
+  float *channelRow(uint32_t row) const
+  {
+    return channelMemory.as<float>() + row * channelRowStride;
+  }
+  // lock the buffers above into physical memory
+  bool lockAudioMemory{false}, lockAudioMemorySet{false};
+  void setLockAudioMemory(bool lock)
+  {
+    lockAudioMemorySet = true;
+    lockAudioMemory = lock;
+  }
+  void allocateProcessMemory(uint32_t maxFrames);
+
+  // Realtime setup of the audio thread, applied on the first callback of each stream and
+  // reported in the log. A priority of 0 leaves the scheduling to RtAudio, a cpu of -1 leaves
+  // the thread unpinned. With lockAudioMemory the whole process memory is locked as well.
+  int audioThreadPriority{0};
+  int audioThreadCpu{-1};
+  bool audioThreadFlushDenormals{true};
+  static constexpr size_t prefaultStackBytes{64 * 1024};
+  // a thread of the host rather than of the audio device gets ownThreadPriority by default,
+  // the graph workers aren't pinned since they are there to use the other cpus
+  static constexpr int ownThreadPriority{70};
+  void setupAudioThread(bool ownThread = false, bool pin = true);
+
+  // Written by the audio callback, reset when a stream starts. pollAudioStats is called about
+  // once a second from the main thread, logs new xruns, rewrites statsFile if one is set and
+  // runs the main thread callbacks the graph plugins asked for.
+  AudioStats audioStats;
+  std::string statsFile;
+  uint64_t lastReportedXruns{0};
+  void pollAudioStats();
+  void writeStatsFile(const AudioStats::Summary &summary);
 };
 }  // namespace freeaudio::clap_wrapper::standalone
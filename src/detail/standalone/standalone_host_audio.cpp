@@ -13,19 +13,84 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#if WIN
+#define NOMINMAX 1
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
 #include "standalone_host.h"
 #include "entry.h"
+#include "detail/shared/denormals.h"
 
 namespace freeaudio::clap_wrapper::standalone
 {
-int rtaCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
-                double /* streamTime */, RtAudioStreamStatus status, void *data)
+int rtaCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames, double streamTime,
+                RtAudioStreamStatus status, void *data)
 {
-  if (status)
+  auto sh = (StandaloneHost *)data;
+  static thread_local bool threadIsSetUp{false};
+  if (!threadIsSetUp)
   {
+    sh->setupAudioThread();
+    threadIsSetUp = true;
   }
-  auto sh = (StandaloneHost *)data;
-  sh->clapProcess(outputBuffer, inputBuffer, nBufferFrames);
+
+  auto start = monotonicNanoseconds();
+  bool xrun = status != 0;
+  if (sh->decoupled)
+  {
+    xrun = !sh->decoupledCallback(outputBuffer, inputBuffer, nBufferFrames) || xrun;
+  }
+  else
+  {
+    sh->clapProcess(outputBuffer, inputBuffer, nBufferFrames, streamTime);
+  }
+  sh->audioStats.recordBlock(start, monotonicNanoseconds() - start, nBufferFrames, sh->currentSampleRate,
+                             xrun);
+
+  return 0;
+}
+
+struct BufferCalibration
+{
+  StandaloneHost *host{nullptr};
+  uint32_t outputChannels{0};
+  uint32_t warmupBlocks{0};
+  std::atomic<uint32_t> blocks{0}, xruns{0};
+};
+
+// runs the plugin like rtaCallback, but silent and counting the xruns after a short warmup
+int rtaCalibrationCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
+                           double streamTime, RtAudioStreamStatus status, void *data)
+{
+  auto bc = (BufferCalibration *)data;
+  static thread_local bool threadIsSetUp{false};
+  if (!threadIsSetUp)
+  {
+    bc->host->setupAudioThread();
+    threadIsSetUp = true;
+  }
+  if (status && bc->blocks >= bc->warmupBlocks)
+  {
+    bc->xruns++;
+  }
+  bc->host->clapProcess(outputBuffer, inputBuffer, nBufferFrames, streamTime);
+  if (outputBuffer)
+  {
+    memset(outputBuffer, 0, nBufferFrames * bc->outputChannels * sizeof(float));
+  }
+  bc->blocks++;
 
   return 0;
 }
@@ -44,11 +109,13 @@ void rtaErrorCallback(RtAudioErrorType errorType, const std::string &errorText)
   }
   else
   {
+    getStandaloneHost()->audioStats.recordDeviceXrun(errorType == RTAUDIO_OUTPUT_UNDERFLOW);
     static bool reported = false;
     if (!reported)
     {
       LOG << "[ERROR] RtAudio reports '" << errorText << "'" << std::endl;
-      LOG << "[ERROR] Supressing future underflow reports" << std::endl;
+      LOG << "[ERROR] Supressing future underflow reports, they are counted in the audio stats"
+          << std::endl;
       reported = true;
     }
   }
@@ -76,19 +143,36 @@ std::tuple<unsigned int, unsigned int, int32_t> StandaloneHost::getDefaultAudioI
 }
 void StandaloneHost::startAudioThread()
 {
+  if (nullAudio != NullAudio::Off)
+  {
+    startNullAudioThread(nullAudio);
+    return;
+  }
   guaranteeRtAudioDAC();
+  if (rtaDac->getDeviceCount() == 0)
+  {
+    // a headless machine or a CI container, keep the plugin running on the virtual clock
+    LOG << "[WARNING] No audio devices, using the paced null audio" << std::endl;
+    startNullAudioThread(NullAudio::Paced);
+    return;
+  }
+
+  // open as many device channels as the routing uses, but at least a stereo output
+  auto inChannels = requiredDeviceChannels(true);
+  auto outChannels = std::max(2U, requiredDeviceChannels(false));
 
   if (startupAudioSet)
   {
     auto in = startAudioIn;
     auto out = startAudioOut;
     auto sr = startSampleRate;
-    startAudioThreadOn(in, 2, in > 0 && numAudioInputs > 0, out, 2, out > 0 && numAudioOutputs > 0, sr);
+    startAudioThreadOn(in, inChannels, in > 0 && inChannels > 0, out, outChannels,
+                       out > 0 && numAudioOutputs > 0, sr);
   }
   else
   {
     auto [in, out, sr] = getDefaultAudioInOutSampleRate();
-    startAudioThreadOn(in, 2, numAudioInputs > 0, out, 2, numAudioOutputs > 0, sr);
+    startAudioThreadOn(in, inChannels, inChannels > 0, out, outChannels, numAudioOutputs > 0, sr);
   }
 }
 
@@ -126,6 +210,7 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
                                         uint32_t outputChannels, bool useOutput, int32_t reqSampleRate)
 {
   guaranteeRtAudioDAC();
+  stopNullAudioThread();
 
   if (rtaDac->isStreamRunning())
   {
@@ -188,26 +273,57 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
 
   currentSampleRate = sampleRate;
 
+  streamInputChannels = (useInput) ? iParams.nChannels : 0;
+  streamOutputChannels = (useOutput) ? oParams.nChannels : 0;
+  streamNonInterleaved = true;
+
+  // RtAudio converts to non interleaved buffers if the backend can't provide them natively
   RtAudio::StreamOptions options;
-  options.flags = RTAUDIO_SCHEDULE_REALTIME;
+  options.flags = RTAUDIO_SCHEDULE_REALTIME | RTAUDIO_NONINTERLEAVED;
 
-  /*
-   * RTAudio doesn't tell you what the possible frame sizes are but instead
-   * just tells you to try open stream with power of twos you want. So leave
-   * this for now at 256 and return to it shortly.
-   */
-  LOG << "[WARNING] Hardcoding frame size to 256 samples for now" << std::endl;
-  uint32_t bufferFrames{256};
+  uint32_t bufferFrames{startBufferFrames};
+  if (bufferFrames == autoBufferFrames)
+  {
+    bufferFrames = calibrateBufferFrames((useOutput) ? &oParams : nullptr,
+                                         (useInput) ? &iParams : nullptr, sampleRate);
+  }
+
+  auto requestedFrames = bufferFrames;
   if (rtaDac->openStream((useOutput) ? &oParams : nullptr, (useInput) ? &iParams : nullptr,
                          RTAUDIO_FLOAT32, sampleRate, &bufferFrames, &rtaCallback, (void *)this,
                          &options))
   {
-    LOG << "[ERROR]" << rtaDac->getErrorText() << std::endl;
-    rtaDac->closeStream();
-    return;
+    LOG << "[WARNING] Can't open non interleaved stream (" << rtaDac->getErrorText()
+        << "), falling back to interleaved" << std::endl;
+    if (rtaDac->isStreamOpen()) rtaDac->closeStream();
+
+    streamNonInterleaved = false;
+    options.flags = RTAUDIO_SCHEDULE_REALTIME;
+    bufferFrames = requestedFrames;
+    if (rtaDac->openStream((useOutput) ? &oParams : nullptr, (useInput) ? &iParams : nullptr,
+                           RTAUDIO_FLOAT32, sampleRate, &bufferFrames, &rtaCallback, (void *)this,
+                           &options))
+    {
+      LOG << "[ERROR]" << rtaDac->getErrorText() << std::endl;
+      rtaDac->closeStream();
+      return;
+    }
+  }
+  if (bufferFrames != requestedFrames)
+  {
+    LOG << "Device changed buffer size from " << requestedFrames << " to " << bufferFrames << std::endl;
   }
+  currentBufferFrames = bufferFrames;
 
-  activatePlugin(sampleRate, 1, bufferFrames * 2);
+  if (pluginBlockFrames > 0)
+  {
+    startDecoupled(bufferFrames);
+  }
+  else
+  {
+    // RtAudio always calls back with the negotiated buffer size
+    activatePlugin(sampleRate, bufferFrames, bufferFrames);
+  }
 
   LOG << "RtAudio Attached Devices" << std::endl;
   if (useOutput)
@@ -231,6 +347,9 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
     return;
   }
 
+  audioStats.reset();
+  lastReportedXruns = 0;
+  midiClockValid = false;
   if (rtaDac->startStream())
   {
     LOG << "[ERROR] startStream failed : " << rtaDac->getErrorText() << std::endl;
@@ -240,12 +359,191 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
   LOG << "RtAudio: Started Stream" << std::endl;
 }
 
+uint32_t StandaloneHost::calibrateBufferFrames(RtAudio::StreamParameters *oParams,
+                                               RtAudio::StreamParameters *iParams, int32_t sampleRate)
+{
+  /*
+   * RtAudio doesn't tell you what the possible frame sizes are but instead
+   * just tells you to try open stream with power of twos you want. So we do
+   * exactly that, with the plugin running, and take the first size which
+   * survives the calibration window without xruns.
+   */
+  static constexpr uint32_t minProbeFrames{16}, maxProbeFrames{2048};
+  static constexpr double warmupSeconds{0.1}, calibrationSeconds{0.5};
+
+  LOG << "Calibrating buffer size from " << minProbeFrames << " to " << maxProbeFrames << " frames"
+      << std::endl;
+  activatePlugin(sampleRate, minProbeFrames, maxProbeFrames);
+
+  for (uint32_t probe = minProbeFrames; probe <= maxProbeFrames; probe *= 2)
+  {
+    BufferCalibration bc;
+    bc.host = this;
+    bc.outputChannels = oParams ? oParams->nChannels : 0;
+    bc.warmupBlocks = (uint32_t)std::ceil(warmupSeconds * sampleRate / probe);
+
+    RtAudio::StreamOptions options;
+    options.flags = RTAUDIO_SCHEDULE_REALTIME | RTAUDIO_NONINTERLEAVED;
+
+    uint32_t frames{probe};
+    midiClockValid = false;
+    if (rtaDac->openStream(oParams, iParams, RTAUDIO_FLOAT32, sampleRate, &frames,
+                           &rtaCalibrationCallback, (void *)&bc, &options))
+    {
+      LOG << "  " << probe << " frames : can't open stream (" << rtaDac->getErrorText() << ")"
+          << std::endl;
+      if (rtaDac->isStreamOpen()) rtaDac->closeStream();
+      continue;
+    }
+    if (frames > maxProbeFrames || rtaDac->startStream())
+    {
+      rtaDac->closeStream();
+      continue;
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(warmupSeconds + calibrationSeconds));
+
+    rtaDac->stopStream();
+    rtaDac->closeStream();
+
+    LOG << "  " << frames << " frames : " << bc.xruns << " xruns in " << bc.blocks << " blocks"
+        << std::endl;
+    if (bc.blocks > bc.warmupBlocks && bc.xruns == 0)
+    {
+      LOG << "Using calibrated buffer size of " << frames << " frames" << std::endl;
+      return frames;
+    }
+  }
+
+  LOG << "[WARNING] No buffer size ran without xruns, using " << maxProbeFrames << " frames"
+      << std::endl;
+  return maxProbeFrames;
+}
+
+// touches the stack the plugin is going to use, so it doesn't page fault during processing
+static void prefaultStack()
+{
+  volatile unsigned char stack[StandaloneHost::prefaultStackBytes];
+  for (size_t i = 0; i < sizeof(stack); i += 512)
+  {
+    stack[i] = 0;
+  }
+}
+
+void StandaloneHost::setupAudioThread(bool ownThread, bool pin)
+{
+  LOG << "Setting up audio thread" << std::endl;
+
+  auto priority = audioThreadPriority > 0 ? audioThreadPriority : (ownThread ? ownThreadPriority : 0);
+  if (priority > 0)
+  {
+#if WIN
+    auto ok = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+    LOG << "  - priority : time critical " << (ok ? "set" : "failed") << std::endl;
+#elif LIN
+    sched_param sp{};
+    sp.sched_priority = std::clamp(priority, sched_get_priority_min(SCHED_FIFO),
+                                   sched_get_priority_max(SCHED_FIFO));
+    auto res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    LOG << "  - priority : SCHED_FIFO " << sp.sched_priority << " "
+        << (res == 0 ? std::string("set") : std::string("failed: ") + strerror(res)) << std::endl;
+#else
+    if (ownThread)
+    {
+      LOG << "  - priority : not supported for the host's own threads on this platform" << std::endl;
+    }
+    else
+    {
+      LOG << "  - priority : left to the audio device, which runs it as a realtime thread" << std::endl;
+    }
+#endif
+  }
+
+  if (pin && audioThreadCpu >= 0)
+  {
+#if WIN
+    auto ok = audioThreadCpu < 64 && SetThreadAffinityMask(GetCurrentThread(), 1ULL << audioThreadCpu);
+    LOG << "  - affinity : cpu " << audioThreadCpu << " " << (ok ? "set" : "failed") << std::endl;
+#elif LIN
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(audioThreadCpu, &cpus);
+    auto res = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    LOG << "  - affinity : cpu " << audioThreadCpu << " "
+        << (res == 0 ? std::string("set") : std::string("failed: ") + strerror(res)) << std::endl;
+#else
+    LOG << "  - affinity : not supported on this platform" << std::endl;
+#endif
+  }
+
+  if (audioThreadFlushDenormals)
+  {
+    auto ok = ClapWrapper::detail::shared::flushDenormals();
+    LOG << "  - denormals : " << (ok ? "flushed to zero" : "not supported on this cpu") << std::endl;
+  }
+
+  prefaultStack();
+  LOG << "  - prefaulted " << prefaultStackBytes / 1024 << " kB of stack" << std::endl;
+
+  if (lockAudioMemory)
+  {
+#if LIN
+    auto res = mlockall(MCL_CURRENT);
+    LOG << "  - process memory : "
+        << (res == 0 ? std::string("locked") : std::string("lock failed: ") + strerror(errno))
+        << std::endl;
+#else
+    LOG << "  - process memory : only the wrapper buffers are locked on this platform" << std::endl;
+#endif
+  }
+}
+
+void StandaloneHost::pollAudioStats()
+{
+  if (graph)
+  {
+    graph->runCallbacks();
+  }
+  auto summary = audioStats.summary();
+  if (summary.xruns + summary.underflows + summary.overflows > lastReportedXruns)
+  {
+    lastReportedXruns = summary.xruns + summary.underflows + summary.overflows;
+    LOG << "[WARNING] Audio stats : " << AudioStats::toString(summary) << std::endl;
+  }
+  writeStatsFile(summary);
+}
+
+void StandaloneHost::writeStatsFile(const AudioStats::Summary &summary)
+{
+  if (statsFile.empty())
+  {
+    return;
+  }
+  std::ofstream ofs(statsFile, std::ios::out | std::ios::trunc);
+  if (!ofs.is_open())
+  {
+    LOG << "Unable to open for writing " << statsFile << std::endl;
+    statsFile.clear();
+    return;
+  }
+  ofs << AudioStats::toJSON(summary);
+}
+
 void StandaloneHost::stopAudioThread()
 {
   LOG << "Shutting down audio" << std::endl;
-  if (!rtaDac->isStreamRunning())
+  if (nullAudioThread.joinable())
+  {
+    stopNullAudioThread();
+    auto summary = audioStats.summary();
+    LOG << "Audio stats : " << AudioStats::toString(summary) << std::endl;
+    writeStatsFile(summary);
+    return;
+  }
+  if (!rtaDac || !rtaDac->isStreamRunning())
   {
     LOG << "Stream not running" << std::endl;
+    stopDecoupled();
   }
   else
   {
@@ -265,6 +563,11 @@ void StandaloneHost::stopAudioThread()
       rtaDac->closeStream();
     }
     LOG << "RtAudio stream stopped" << std::endl;
+    stopDecoupled();
+
+    auto summary = audioStats.summary();
+    LOG << "Audio stats : " << AudioStats::toString(summary) << std::endl;
+    writeStatsFile(summary);
   }
   return;
 }
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "standalone_host.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+void StandaloneHost::startDecoupled(uint32_t deviceFrames)
+{
+  stopDecoupled();
+
+  /*
+   * A plugin block can start once the device has recorded all of it and has to be in the
+   * output ring before the device plays its first frame. One block of latency collects it and
+   * one more gives the plugin a whole block of time to compute it. If neither size divides the
+   * other a block can end in the middle of a device block, which costs another device block.
+   */
+  auto pluginFrames = pluginBlockFrames;
+  auto longest = std::max(pluginFrames, deviceFrames);
+  auto misaligned = pluginFrames % deviceFrames != 0 && deviceFrames % pluginFrames != 0;
+  decoupledLatencyFrames = 2 * longest + (misaligned ? deviceFrames : 0);
+
+  // the device side keeps its layout, the plugin side is always planar
+  decoupledDeviceInterleaved = !streamNonInterleaved;
+  streamNonInterleaved = true;
+  activatePlugin(currentSampleRate, pluginFrames, pluginFrames);
+
+  auto ringFrames = 2 * (decoupledLatencyFrames + pluginFrames + deviceFrames);
+  auto blockBytes = sizeof(float) * (streamInputChannels + streamOutputChannels) * pluginFrames;
+  if (!decoupledInput.allocate(streamInputChannels, ringFrames, lockAudioMemory) ||
+      !decoupledOutput.allocate(streamOutputChannels, ringFrames, lockAudioMemory) ||
+      !decoupledMemory.allocate(blockBytes, lockAudioMemory))
+  {
+    std::terminate();
+  }
+  decoupledOutput.writeSilence(decoupledLatencyFrames);
+  decoupledDebtFrames = 0;
+
+  decoupledDeviceIn.assign(streamInputChannels, nullptr);
+  decoupledDeviceOut.assign(streamOutputChannels, nullptr);
+  decoupledPluginIn.resize(streamInputChannels);
+  decoupledPluginOut.resize(streamOutputChannels);
+  auto *block = decoupledMemory.as<float>();
+  for (auto c = 0U; c < streamInputChannels; ++c)
+  {
+    decoupledPluginIn[c] = block + c * pluginFrames;
+  }
+  for (auto c = 0U; c < streamOutputChannels; ++c)
+  {
+    decoupledPluginOut[c] = block + (streamInputChannels + c) * pluginFrames;
+  }
+
+  LOG << "Decoupled plugin blocks of " << pluginFrames << " frames on device blocks of " << deviceFrames
+      << ", adding " << decoupledLatencyFrames << " frames ("
+      << 1000.0 * decoupledLatencyFrames / currentSampleRate << "ms) of latency" << std::endl;
+  decoupled = true;
+  decoupledRunning = true;
+  decoupledThread = std::thread([this, deviceFrames]() { runDecoupled(deviceFrames); });
+}
+
+void StandaloneHost::runDecoupled(uint32_t deviceFrames)
+{
+  setupAudioThread(true);
+
+  auto pluginFrames = pluginBlockFrames;
+  auto sampleRate = (double)currentSampleRate;
+  auto *in = decoupledMemory.as<float>();
+  auto *out = in + streamInputChannels * pluginFrames;
+  // the device callback doesn't take the mutex, so a wake up may be missed and the wait ends
+  // after a device block at the latest, which the latency covers
+  auto timeout = std::chrono::nanoseconds((int64_t)(deviceFrames * 1e9 / sampleRate));
+
+  int64_t position{0};
+  while (decoupledRunning)
+  {
+    if (decoupledInput.readable() < pluginFrames || decoupledOutput.writable() < pluginFrames)
+    {
+      std::unique_lock<std::mutex> lock(decoupledMutex);
+      decoupledWake.wait_for(lock, timeout);
+      continue;
+    }
+    decoupledInput.read(decoupledPluginIn.data(), pluginFrames);
+    // on the stream clock the block is heard the latency after it was recorded
+    clapProcess(out, streamInputChannels > 0 ? in : nullptr, pluginFrames,
+                (double)(position + decoupledLatencyFrames) / sampleRate);
+    decoupledOutput.write(decoupledPluginOut.data(), pluginFrames);
+    position += pluginFrames;
+  }
+}
+
+void StandaloneHost::stopDecoupled()
+{
+  if (!decoupledThread.joinable())
+  {
+    return;
+  }
+  decoupledRunning = false;
+  decoupledWake.notify_one();
+  decoupledThread.join();
+  decoupled = false;
+  LOG << "Decoupled plugin thread stopped" << std::endl;
+}
+
+bool StandaloneHost::decoupledCallback(void *pOutput, const void *pInput, uint32_t frameCount)
+{
+  auto *devIn = (const float *)pInput;
+  auto *devOut = (float *)pOutput;
+  if (!running)
+  {
+    finishedRunning = true;
+    if (devOut)
+    {
+      memset(devOut, 0, frameCount * streamOutputChannels * sizeof(float));
+    }
+    return true;
+  }
+
+  // the recorded frames go to the plugin thread, if it's that far behind the rest is dropped
+  auto written = std::min(frameCount, decoupledInput.writable());
+  if (!devIn)
+  {
+    decoupledInput.writeSilence(written);
+  }
+  else if (decoupledDeviceInterleaved)
+  {
+    decoupledInput.writeInterleaved(devIn, written);
+  }
+  else
+  {
+    for (auto c = 0U; c < streamInputChannels; ++c)
+    {
+      decoupledDeviceIn[c] = devIn + c * frameCount;
+    }
+    decoupledInput.write(decoupledDeviceIn.data(), written);
+  }
+  decoupledWake.notify_one();
+
+  // after an underrun the frames which came too late are dropped, so the latency stays the same
+  auto late = std::min(decoupledDebtFrames, decoupledOutput.readable());
+  decoupledOutput.skip(late);
+  decoupledDebtFrames -= late;
+
+  auto read = std::min(frameCount, decoupledOutput.readable());
+  if (!devOut)
+  {
+    decoupledOutput.skip(read);
+  }
+  else if (decoupledDeviceInterleaved)
+  {
+    decoupledOutput.readInterleaved(devOut, read);
+    memset(devOut + read * streamOutputChannels, 0,
+           (frameCount - read) * streamOutputChannels * sizeof(float));
+  }
+  else
+  {
+    for (auto c = 0U; c < streamOutputChannels; ++c)
+    {
+      decoupledDeviceOut[c] = devOut + c * frameCount;
+    }
+    decoupledOutput.read(decoupledDeviceOut.data(), read);
+    for (auto c = 0U; c < streamOutputChannels; ++c)
+    {
+      memset(decoupledDeviceOut[c] + read, 0, (frameCount - read) * sizeof(float));
+    }
+  }
+  decoupledDebtFrames += frameCount - read;
+
+  return written == frameCount && read == frameCount;
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,38 @@
+#include "standalone_host.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+bool StandaloneHost::loadGraph()
+{
+  if (graphFile.empty() || graph)
+  {
+    return true;
+  }
+
+  // the workers compute with the audio thread, so they get its realtime setup
+  auto loading = std::make_unique<PluginGraph>([this]() { setupAudioThread(true, false); });
+  GraphConfig config;
+  std::string error;
+  if (!readGraphConfig(graphFile, config, error) ||
+      !loading->load(config, graphFile.parent_path(), clapPlugin, error))
+  {
+    LOG << "[ERROR] Unable to load the graph " << graphFile.u8string() << " : " << error << std::endl;
+    return false;
+  }
+  if (inputRoutingSet || outputRoutingSet)
+  {
+    LOG << "[WARNING] The audio routing is ignored, the graph connects the device channels" << std::endl;
+  }
+
+  // activated from the next activatePlugin on
+  graph = std::move(loading);
+  return true;
+}
+
+void StandaloneHost::unloadGraph()
+{
+  graph.reset();
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
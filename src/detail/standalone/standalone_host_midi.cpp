@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+
 #include "standalone_host.h"
 #include "standalone_details.h"
 
@@ -38,6 +41,8 @@ void StandaloneHost::startMIDIThread()
       LOG << "  - '" << midiIn->getPortName(i) << "'" << std::endl;
       midiIn->openPort(i);
       midiIn->setCallback(midiCallback, this);
+      // RtMidi ignores SysEx by default
+      midiIn->ignoreTypes(false, true, true);
       midiIns.push_back(std::move(midiIn));
     }
     catch (RtMidiError &error)
@@ -45,19 +50,364 @@ void StandaloneHost::startMIDIThread()
       error.printMessage();
     }
   }
+
+  if (createsMidiOutput)
+  {
+    startMIDIOutput();
+  }
+}
+
+void StandaloneHost::startMIDIOutput()
+{
+  unsigned int numPorts{0};
+  try
+  {
+    auto midiOut = std::make_unique<RtMidiOut>();
+    numPorts = midiOut->getPortCount();
+  }
+  catch (RtMidiError &error)
+  {
+    error.printMessage();
+    return;
+  }
+
+  LOG << "MIDI: There are " << numPorts << " MIDI output destinations available. Binding '"
+      << midiOutputPorts << "'" << std::endl;
+  for (unsigned int i = 0; i < numPorts; i++)
+  {
+    try
+    {
+      auto midiOut = std::make_unique<RtMidiOut>();
+      auto name = midiOut->getPortName(i);
+      if (midiOutputPorts == "all")
+      {
+        // all inputs are bound as well, so a through port would feed the output back
+        if (name.find("Through") != std::string::npos)
+        {
+          LOG << "  - skipping '" << name << "'" << std::endl;
+          continue;
+        }
+      }
+      else if (midiOutputPorts != std::to_string(i))
+      {
+        continue;
+      }
+      LOG << "  - '" << name << "'" << std::endl;
+      midiOut->openPort(i);
+      midiOuts.push_back(std::move(midiOut));
+    }
+    catch (RtMidiError &error)
+    {
+      error.printMessage();
+    }
+  }
+
+  if (!midiOuts.empty())
+  {
+    midiOutRunning = true;
+    midiOutThread = std::thread([this]() { runMIDIOutput(); });
+  }
+}
+
+bool StandaloneHost::queueOutputEvent(const clap_event_header_t *evt)
+{
+  if (evt->space_id != CLAP_CORE_EVENT_SPACE_ID || !midiOutRunning)
+  {
+    return true;
+  }
+
+  unsigned char dat[3]{};
+  const void *data{dat};
+  uint32_t size{0};
+  switch (evt->type)
+  {
+  case CLAP_EVENT_MIDI:
+  {
+    auto midi = (const clap_event_midi *)evt;
+    memcpy(dat, midi->data, sizeof(dat));
+    size = midiMessageSize(dat[0]);
+    break;
+  }
+  case CLAP_EVENT_MIDI_SYSEX:
+  {
+    auto sysex = (const clap_event_midi_sysex *)evt;
+    data = sysex->buffer;
+    size = sysex->size;
+    break;
+  }
+  case CLAP_EVENT_NOTE_ON:
+  case CLAP_EVENT_NOTE_OFF:
+  {
+    auto note = (const clap_event_note *)evt;
+    if (note->channel < 0 || note->channel > 15 || note->key < 0 || note->key > 127)
+    {
+      return true;
+    }
+    auto on = evt->type == CLAP_EVENT_NOTE_ON;
+    auto velocity = (unsigned char)std::clamp((int)std::lround(note->velocity * 127), 0, 127);
+    dat[0] = (unsigned char)((on ? 0x90 : 0x80) | note->channel);
+    dat[1] = (unsigned char)note->key;
+    // a note on with velocity 0 would be a note off
+    dat[2] = on ? std::max(velocity, (unsigned char)1) : velocity;
+    size = 3;
+    break;
+  }
+  default:
+    return true;
+  }
+  if (size == 0 || !data)
+  {
+    return true;
+  }
+
+  // the block is heard one buffer after it started, the event time is relative to that
+  auto sampleRate = (double)currentSampleRate;
+  int64_t due{0};
+  if (midiClockValid && sampleRate > 0)
+  {
+    auto at = midiBlockStartSample + midiBlockFrames + evt->time - midiClockOffsetSamples;
+    due = (int64_t)(at / sampleRate * 1e9);
+  }
+  return midiFromAudioQueue.push(&due, sizeof(due), data, size);
+}
+
+uint32_t StandaloneHost::midiMessageSize(unsigned char status)
+{
+  if (status < 0x80)
+  {
+    return 0;
+  }
+  if (status < 0xF0)
+  {
+    auto kind = status & 0xF0;
+    return (kind == 0xC0 || kind == 0xD0) ? 2 : 3;
+  }
+  switch (status)
+  {
+  case 0xF1:
+  case 0xF3:
+    return 2;
+  case 0xF2:
+    return 3;
+  default:
+    return 1;
+  }
+}
+
+void StandaloneHost::runMIDIOutput()
+{
+  std::vector<unsigned char> message;
+  message.reserve(sysexArenaSize);
+  while (midiOutRunning)
+  {
+    auto record = midiFromAudioQueue.peekSize();
+    if (record == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    int64_t due{0};
+    midiFromAudioQueue.peek(&due, 0, sizeof(due));
+    auto wait = due - monotonicNanoseconds();
+    if (wait > 0)
+    {
+      // short sleeps, so a message queued meanwhile with an earlier time is only a little late
+      std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<int64_t>(wait, 1000000)));
+      continue;
+    }
+
+    message.resize(record - sizeof(due));
+    midiFromAudioQueue.peek(message.data(), sizeof(due), (uint32_t)message.size());
+    midiFromAudioQueue.pop();
+    for (auto &m : midiOuts)
+    {
+      try
+      {
+        m->sendMessage(&message);
+      }
+      catch (RtMidiError &error)
+      {
+        error.printMessage();
+      }
+    }
+  }
 }
 
 void StandaloneHost::processMIDIEvents(double deltatime, std::vector<unsigned char> *message)
 {
   auto nBytes = message->size();
+  if (nBytes == 0)
+  {
+    return;
+  }
 
-  if (nBytes <= 3)
+  // deltatime is only relative to the previous message of the same port, so the messages
+  // of all ports are stamped with the monotonic clock on arrival
+  auto received = monotonicNanoseconds();
+
+  while (midiProducerLock.test_and_set(std::memory_order_acquire))
+  {
+    std::this_thread::yield();
+  }
+  if (nBytes <= 3 && (*message)[0] != 0xF0)
   {
     midiChunk ck;
     memset(ck.dat, 0, sizeof(ck.dat));
     memcpy(ck.dat, message->data(), nBytes);
+    ck.receivedNanoseconds = received;
     midiToAudioQueue.push(ck);
   }
+  else if (nBytes > sysexArenaSize ||
+           !sysexToAudioQueue.push(&received, sizeof(received), message->data(), (uint32_t)nBytes))
+  {
+    LOG << "[WARNING] Dropping MIDI message of " << nBytes << " bytes" << std::endl;
+  }
+  midiProducerLock.clear(std::memory_order_release);
+}
+
+void StandaloneHost::deliverMIDIEvents(uint32_t frameCount, double streamTime)
+{
+  auto sampleRate = (double)currentSampleRate;
+  auto latency = (midiLatencyFrames == midiLatencyBlock) ? (int32_t)frameCount : midiLatencyFrames;
+  auto sampleAccurate = latency >= 0 && sampleRate > 0;
+
+  /*
+   * The block starts at streamTime on the stream clock and the callback runs a little after
+   * that on the monotonic clock. The offset between the two clocks is smoothed since the
+   * callbacks jitter, and reset if it jumps by more than a block, for example on a new stream.
+   * The MIDI output is scheduled with the same clock.
+   */
+  auto blockStart = streamTime * sampleRate;
+  midiBlockStartSample = blockStart;
+  midiBlockFrames = frameCount;
+  if (sampleRate > 0)
+  {
+    auto offset = blockStart - monotonicNanoseconds() * 1e-9 * sampleRate;
+    if (!midiClockValid || std::fabs(offset - midiClockOffsetSamples) > frameCount)
+    {
+      midiClockOffsetSamples = offset;
+      midiClockValid = true;
+    }
+    else
+    {
+      midiClockOffsetSamples += 0.05 * (offset - midiClockOffsetSamples);
+    }
+  }
+
+  clap_event_midi midi;
+  midi.port_index = 0;
+  midi.header.size = sizeof(clap_event_midi);
+  midi.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+  midi.header.type = CLAP_EVENT_MIDI;
+  midi.header.flags = 0;
+
+  clap_event_midi_sysex sysex;
+  sysex.port_index = 0;
+  sysex.header.size = sizeof(clap_event_midi_sysex);
+  sysex.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+  sysex.header.type = CLAP_EVENT_MIDI_SYSEX;
+  sysex.header.flags = 0;
+
+  // the short and the long messages are merged in the order they were received
+  uint32_t lastTime{0};
+  while (true)
+  {
+    if (!hasPendingMIDI && midiToAudioQueue.pop(pendingMIDI))
+    {
+      hasPendingMIDI = true;
+    }
+    auto sysexRecord = sysexToAudioQueue.peekSize();
+    int64_t sysexReceived{0};
+    if (sysexRecord > 0)
+    {
+      sysexToAudioQueue.peek(&sysexReceived, 0, sizeof(sysexReceived));
+    }
+    if (!hasPendingMIDI && sysexRecord == 0)
+    {
+      break;
+    }
+    auto isSysex =
+        sysexRecord > 0 && (!hasPendingMIDI || sysexReceived < pendingMIDI.receivedNanoseconds);
+
+    uint32_t time{0};
+    if (sampleAccurate)
+    {
+      auto received = isSysex ? sysexReceived : pendingMIDI.receivedNanoseconds;
+      auto at = received * 1e-9 * sampleRate + midiClockOffsetSamples + latency;
+      if (at >= blockStart + frameCount)
+      {
+        // due in a later block, and so is everything received after it
+        break;
+      }
+      // late messages are delivered right away, and the events have to stay in order
+      time = std::max(lastTime, (uint32_t)std::max(0.0, at - blockStart));
+    }
+
+    if (isSysex)
+    {
+      auto size = sysexRecord - (uint32_t)sizeof(sysexReceived);
+      if (sysexArenaUsed + size > sysexArena.size())
+      {
+        // the arena is full for this block, the message goes out with the next one
+        break;
+      }
+      auto *buffer = sysexArena.as<uint8_t>() + sysexArenaUsed;
+      sysexToAudioQueue.peek(buffer, sizeof(sysexReceived), size);
+      sysexToAudioQueue.pop();
+      sysexArenaUsed += size;
+
+      sysex.header.time = time;
+      sysex.buffer = buffer;
+      sysex.size = size;
+      pushInputEvent(&(sysex.header));
+    }
+    else
+    {
+      hasPendingMIDI = false;
+      midi.header.time = time;
+      memcpy(midi.data, pendingMIDI.dat, sizeof(pendingMIDI.dat));
+      pushInputEvent(&(midi.header));
+    }
+    lastTime = time;
+  }
+}
+
+std::optional<int32_t> StandaloneHost::parseMIDILatency(const std::string &value)
+{
+  if (value == "off")
+  {
+    return midiLatencyImmediate;
+  }
+  if (value == "block")
+  {
+    return midiLatencyBlock;
+  }
+  try
+  {
+    auto frames = std::stoi(value);
+    if (frames >= 0 && frames < (int32_t)maxBufferFrames)
+    {
+      return frames;
+    }
+  }
+  catch (const std::exception &)
+  {
+  }
+  return std::nullopt;
+}
+
+std::string StandaloneHost::midiLatencyToString(int32_t frames)
+{
+  if (frames == midiLatencyImmediate)
+  {
+    return "off";
+  }
+  if (frames == midiLatencyBlock)
+  {
+    return "block";
+  }
+  return std::to_string(frames);
 }
 
 void StandaloneHost::midiCallback(double deltatime, std::vector<unsigned char> *message, void *userData)
@@ -72,6 +422,13 @@ void StandaloneHost::stopMIDIThread()
   {
     m.reset();
   }
+
+  midiOutRunning = false;
+  if (midiOutThread.joinable())
+  {
+    midiOutThread.join();
+  }
+  midiOuts.clear();
 }
 
 }  // namespace freeaudio::clap_wrapper::standalone
\ No newline at end of file
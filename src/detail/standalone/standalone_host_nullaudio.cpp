@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "standalone_host.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+std::optional<StandaloneHost::NullAudio> StandaloneHost::parseNullAudio(const std::string &value)
+{
+  if (value == "off") return NullAudio::Off;
+  if (value == "paced") return NullAudio::Paced;
+  if (value == "fast") return NullAudio::Fast;
+  return std::nullopt;
+}
+
+void StandaloneHost::startNullAudioThread(NullAudio mode)
+{
+  if (rtaDac && rtaDac->isStreamRunning())
+  {
+    stopAudioThread();
+  }
+  stopNullAudioThread();
+  running = true;
+  finishedRunning = false;
+
+  // a planar stream like the one of a device, with the channels the routing uses
+  streamNonInterleaved = true;
+  streamInputChannels = requiredDeviceChannels(true);
+  streamOutputChannels = std::max(2U, requiredDeviceChannels(false));
+  auto sampleRate = startSampleRate > 0 ? startSampleRate : 48000;
+  // there is no device to calibrate against
+  auto frames = startBufferFrames == autoBufferFrames ? 256U : startBufferFrames;
+  currentSampleRate = sampleRate;
+  currentBufferFrames = frames;
+
+  activatePlugin(sampleRate, frames, frames);
+  if (!nullAudioMemory.allocate(sizeof(float) * (streamInputChannels + streamOutputChannels) * frames,
+                                lockAudioMemory))
+  {
+    std::terminate();
+  }
+
+  audioStats.reset();
+  lastReportedXruns = 0;
+  midiClockValid = false;
+  nullAudioBlocks = 0;
+  nullAudioProcessNanoseconds = 0;
+  nullAudioWallNanoseconds = 0;
+  pluginProcessNanoseconds = 0;
+  measurePluginTime = true;
+
+  LOG << "Null audio: " << (mode == NullAudio::Paced ? "paced" : "as fast as possible") << " at "
+      << sampleRate << "Hz in blocks of " << frames << std::endl;
+  nullAudioRunning = true;
+  nullAudioThread = std::thread([this, mode]() { runNullAudio(mode); });
+}
+
+void StandaloneHost::runNullAudio(NullAudio mode)
+{
+  setupAudioThread();
+
+  auto frames = currentBufferFrames;
+  auto sampleRate = currentSampleRate;
+  auto *input = streamInputChannels > 0 ? nullAudioMemory.as<float>() : nullptr;
+  auto *output = nullAudioMemory.as<float>() + streamInputChannels * frames;
+
+  // the virtual clock is the stream position, so the pacing doesn't drift with the sleeps
+  auto start = monotonicNanoseconds();
+  auto due = [start, frames, sampleRate](uint64_t block)
+  { return start + (int64_t)((double)block * frames * 1e9 / sampleRate); };
+
+  uint64_t blocks{0};
+  int64_t processSum{0};
+  while (nullAudioRunning &&
+         (nullAudioFrameLimit == 0 || (int64_t)(blocks * frames) < nullAudioFrameLimit))
+  {
+    auto blockStart = monotonicNanoseconds();
+    clapProcess(output, input, frames, (double)(blocks * frames) / sampleRate);
+    auto blockEnd = monotonicNanoseconds();
+
+    // paced, a block is late if it finishes after the next one is due
+    bool late = mode == NullAudio::Paced && blockEnd > due(blocks + 1);
+    audioStats.recordBlock(blockStart, blockEnd - blockStart, frames, sampleRate, late);
+    processSum += blockEnd - blockStart;
+    blocks++;
+    nullAudioBlocks.store(blocks, std::memory_order_relaxed);
+    nullAudioProcessNanoseconds.store(processSum, std::memory_order_relaxed);
+
+    if (mode == NullAudio::Paced)
+    {
+      auto wait = due(blocks) - monotonicNanoseconds();
+      if (wait > 0)
+      {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+      }
+    }
+  }
+  nullAudioWallNanoseconds = monotonicNanoseconds() - start;
+  nullAudioRunning = false;
+  finishedRunning = true;
+}
+
+void StandaloneHost::stopNullAudioThread()
+{
+  if (!nullAudioThread.joinable())
+  {
+    return;
+  }
+  nullAudioRunning = false;
+  nullAudioThread.join();
+  measurePluginTime = false;
+  LOG << "Null audio: " << nullAudioReport() << std::endl;
+}
+
+std::string StandaloneHost::nullAudioReport() const
+{
+  auto blocks = nullAudioBlocks.load(std::memory_order_relaxed);
+  auto samples = (double)blocks * currentBufferFrames;
+  auto wall = nullAudioWallNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+  auto process = (double)nullAudioProcessNanoseconds.load(std::memory_order_relaxed);
+  auto plugin = (double)pluginProcessNanoseconds.load(std::memory_order_relaxed);
+  if (blocks == 0 || wall <= 0)
+  {
+    return "no blocks processed";
+  }
+
+  // ns per sample frame: for the whole clapProcess, for the plugin alone and the difference
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(1) << blocks << " blocks in " << wall << "s, "
+      << blocks / wall << " blocks/s, " << samples / currentSampleRate / wall << "x realtime, "
+      << std::setprecision(2) << process / samples << " ns/sample (plugin " << plugin / samples
+      << ", wrapper " << (process - plugin) / samples << " = " << std::setprecision(1)
+      << (process > 0 ? 100.0 * (process - plugin) / process : 0) << "%)";
+  return oss.str();
+}
+
+int StandaloneHost::runBenchmark(const RenderSettings &settings)
+{
+  if (!clapPlugin)
+  {
+    return 3;
+  }
+  if (!settings.state.empty() &&
+      !tryLoadStandaloneAndPluginSettings(settings.state.parent_path(), settings.state.filename()))
+  {
+    LOG << "[ERROR] Unable to load the plugin state from " << settings.state.u8string() << std::endl;
+    return 2;
+  }
+  startSampleRate = settings.sampleRate > 0 ? settings.sampleRate : 48000;
+  setStartupBufferFrames(settings.blockSize);
+  nullAudioFrameLimit = (int64_t)std::llround(settings.benchmarkSeconds * startSampleRate);
+
+  startNullAudioThread(settings.benchmarkPaced ? NullAudio::Paced : NullAudio::Fast);
+  while (nullAudioRunning)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  stopNullAudioThread();
+  LOG << "Audio stats : " << AudioStats::toString(audioStats.summary()) << std::endl;
+  nullAudioFrameLimit = 0;
+  return 0;
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
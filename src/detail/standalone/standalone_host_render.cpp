@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "standalone_host.h"
+#include "render.h"
+#include "wavfile.h"
+#include "midifile.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+static bool parseSeconds(const std::string &value, double &seconds)
+{
+  try
+  {
+    size_t used{0};
+    auto s = std::stod(value, &used);
+    if (used == value.size() && s >= 0)
+    {
+      seconds = s;
+      return true;
+    }
+  }
+  catch (const std::exception &)
+  {
+  }
+  return false;
+}
+
+RenderCommandLine parseRenderCommandLine(int argc, char **argv, RenderSettings &settings)
+{
+  bool render{false}, benchmark{false};
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--render") == 0 || strncmp(argv[i], "--render=", 9) == 0)
+    {
+      render = true;
+    }
+    if (strcmp(argv[i], "--benchmark") == 0 || strncmp(argv[i], "--benchmark=", 12) == 0)
+    {
+      benchmark = true;
+    }
+  }
+  if (!render && !benchmark)
+  {
+    return RenderCommandLine::NoRender;
+  }
+  if (render && benchmark)
+  {
+    std::cerr << "--render and --benchmark can't be combined" << std::endl;
+    return RenderCommandLine::Invalid;
+  }
+
+  for (int i = 1; i < argc; ++i)
+  {
+    // both "--option value" and "--option=value"
+    std::string option{argv[i]}, value;
+    if (option == "--paced")
+    {
+      // the only option without a value, it has no meaning for an offline render
+      if (!benchmark)
+      {
+        std::cerr << "Unknown option for --render: " << option << std::endl;
+        return RenderCommandLine::Invalid;
+      }
+      settings.benchmarkPaced = true;
+      continue;
+    }
+    auto eq = option.find('=');
+    if (eq != std::string::npos)
+    {
+      value = option.substr(eq + 1);
+      option = option.substr(0, eq);
+    }
+    else if (i + 1 < argc)
+    {
+      value = argv[++i];
+    }
+    else
+    {
+      std::cerr << "Missing value for " << option << std::endl;
+      return RenderCommandLine::Invalid;
+    }
+
+    bool ok{true};
+    if (option == "--render")
+    {
+      settings.output = fs::u8path(value);
+    }
+    else if (option == "--benchmark")
+    {
+      ok = parseSeconds(value, settings.benchmarkSeconds) && settings.benchmarkSeconds > 0;
+    }
+    else if (option == "--input")
+    {
+      settings.input = fs::u8path(value);
+    }
+    else if (option == "--midi")
+    {
+      settings.midi = fs::u8path(value);
+    }
+    else if (option == "--state")
+    {
+      settings.state = fs::u8path(value);
+    }
+    else if (option == "--graph")
+    {
+      settings.graph = fs::u8path(value);
+    }
+    else if (option == "--buffer-size")
+    {
+      auto frames = StandaloneHost::parseBufferFrames(value);
+      ok = frames.has_value() && *frames != StandaloneHost::autoBufferFrames;
+      if (ok) settings.blockSize = *frames;
+    }
+    else if (option == "--sample-rate")
+    {
+      double sr{0};
+      ok = parseSeconds(value, sr) && sr >= 8000 && sr <= 768000;
+      if (ok) settings.sampleRate = (int32_t)sr;
+    }
+    else if (option == "--length")
+    {
+      ok = parseSeconds(value, settings.lengthSeconds);
+    }
+    else if (option == "--tail")
+    {
+      ok = parseSeconds(value, settings.tailSeconds);
+    }
+    else if (option == "--tempo")
+    {
+      ok = parseSeconds(value, settings.tempo) && settings.tempo >= 20 && settings.tempo <= 999;
+    }
+    else
+    {
+      std::cerr << "Unknown option for " << (render ? "--render: " : "--benchmark: ") << option
+                << std::endl;
+      return RenderCommandLine::Invalid;
+    }
+    if (!ok)
+    {
+      std::cerr << "Invalid value for " << option << ": '" << value << "'" << std::endl;
+      return RenderCommandLine::Invalid;
+    }
+  }
+  if (benchmark)
+  {
+    return RenderCommandLine::Benchmark;
+  }
+  if (settings.output.empty())
+  {
+    std::cerr << "--render needs an output file" << std::endl;
+    return RenderCommandLine::Invalid;
+  }
+  return RenderCommandLine::Render;
+}
+
+void StandaloneHost::deliverRenderEvents(uint32_t frameCount)
+{
+  clap_event_midi midi;
+  midi.port_index = 0;
+  midi.header.size = sizeof(clap_event_midi);
+  midi.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+  midi.header.type = CLAP_EVENT_MIDI;
+  midi.header.flags = 0;
+
+  clap_event_midi_sysex sysex;
+  sysex.port_index = 0;
+  sysex.header.size = sizeof(clap_event_midi_sysex);
+  sysex.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+  sysex.header.type = CLAP_EVENT_MIDI_SYSEX;
+  sysex.header.flags = 0;
+
+  while (renderMIDINext < renderMIDI.size())
+  {
+    const auto &ev = renderMIDI[renderMIDINext];
+    auto frame = (int64_t)std::llround(ev.seconds * currentSampleRate);
+    if (frame >= renderPosition + frameCount)
+    {
+      break;
+    }
+    auto time = (uint32_t)std::max<int64_t>(frame - renderPosition, 0);
+
+    bool pushed;
+    if (ev.bytes[0] == 0xF0 || ev.bytes[0] < 0x80 || ev.bytes.size() > 3)
+    {
+      // the event list outlives the block, so SysEx points straight at it
+      sysex.header.time = time;
+      sysex.buffer = ev.bytes.data();
+      sysex.size = (uint32_t)ev.bytes.size();
+      pushed = pushInputEvent(&(sysex.header));
+    }
+    else
+    {
+      midi.header.time = time;
+      memset(midi.data, 0, sizeof(midi.data));
+      memcpy(midi.data, ev.bytes.data(), ev.bytes.size());
+      pushed = pushInputEvent(&(midi.header));
+    }
+    if (!pushed)
+    {
+      // the rest goes at the start of the next block
+      break;
+    }
+    renderMIDINext++;
+  }
+}
+
+int StandaloneHost::renderOffline(const RenderSettings &settings)
+{
+  if (!clapPlugin)
+  {
+    return 3;
+  }
+
+  std::string error;
+  AudioFileData input;
+  if (!settings.input.empty() && !readWavFile(settings.input, input, error))
+  {
+    LOG << "[ERROR] " << settings.input.u8string() << " : " << error << std::endl;
+    return 2;
+  }
+  if (!settings.midi.empty() && !readMidiFile(settings.midi, renderMIDI, error))
+  {
+    LOG << "[ERROR] " << settings.midi.u8string() << " : " << error << std::endl;
+    return 2;
+  }
+
+  auto sampleRate = settings.sampleRate;
+  if (sampleRate == 0)
+  {
+    sampleRate = input.sampleRate > 0 ? input.sampleRate : 48000;
+  }
+  if (input.frames() > 0 && input.sampleRate != sampleRate)
+  {
+    LOG << "[ERROR] The input is at " << input.sampleRate << "Hz, rendering at " << sampleRate
+        << "Hz would need a resampler" << std::endl;
+    return 2;
+  }
+
+  double seconds = settings.lengthSeconds;
+  if (input.frames() > 0)
+  {
+    seconds = (double)input.frames() / sampleRate;
+  }
+  else if (seconds == 0 && !renderMIDI.empty())
+  {
+    seconds = renderMIDI.back().seconds;
+  }
+  auto totalFrames = (int64_t)std::ceil((seconds + settings.tailSeconds) * sampleRate);
+  if (totalFrames <= 0)
+  {
+    LOG << "[ERROR] Nothing to render, give an --input, a --midi file or a --length" << std::endl;
+    return 2;
+  }
+
+  if (!settings.state.empty() &&
+      !tryLoadStandaloneAndPluginSettings(settings.state.parent_path(), settings.state.filename()))
+  {
+    LOG << "[ERROR] Unable to load the plugin state from " << settings.state.u8string() << std::endl;
+    return 2;
+  }
+
+  // a planar stream with the layout of the files and the default routing
+  streamNonInterleaved = true;
+  streamInputChannels = (uint32_t)input.channels.size();
+  streamOutputChannels = std::max(1U, requiredDeviceChannels(false));
+  currentSampleRate = sampleRate;
+  currentBufferFrames = settings.blockSize;
+
+  TransportSettings ts;
+  ts.tempo = settings.tempo;
+  setTransport(ts);
+
+  auto *p = clapPlugin->_plugin;
+  auto render = clapPlugin->_ext._render;
+  if (render && render->has_hard_realtime_requirement(p))
+  {
+    LOG << "The plugin has a hard realtime requirement, rendering in realtime mode" << std::endl;
+  }
+  else if (render && !render->set(p, CLAP_RENDER_OFFLINE))
+  {
+    LOG << "The plugin refused the offline render mode" << std::endl;
+  }
+
+  activatePlugin(sampleRate, 1, (int32_t)settings.blockSize);
+
+  AudioFileData output;
+  output.sampleRate = sampleRate;
+  output.channels.assign(streamOutputChannels, std::vector<float>((size_t)totalFrames));
+  std::vector<float> blockIn(streamInputChannels * settings.blockSize);
+  std::vector<float> blockOut(streamOutputChannels * settings.blockSize);
+
+  LOG << "Rendering " << totalFrames << " frames at " << sampleRate << "Hz in blocks of "
+      << settings.blockSize << " to " << settings.output.u8string() << std::endl;
+
+  offlineRender = true;
+  renderPosition = 0;
+  renderMIDINext = 0;
+  auto start = monotonicNanoseconds();
+  while (renderPosition < totalFrames)
+  {
+    auto frames = (uint32_t)std::min<int64_t>(settings.blockSize, totalFrames - renderPosition);
+
+    // the device layout of clapProcess, one run of frames per channel
+    for (auto c = 0U; c < streamInputChannels; ++c)
+    {
+      auto *dst = blockIn.data() + c * frames;
+      const auto &src = input.channels[c];
+      auto avail = (int64_t)src.size() - renderPosition;
+      auto n = (uint32_t)std::clamp<int64_t>(avail, 0, frames);
+      if (n > 0)
+      {
+        memcpy(dst, src.data() + renderPosition, n * sizeof(float));
+      }
+      memset(dst + n, 0, (frames - n) * sizeof(float));
+    }
+
+    clapProcess(blockOut.data(), streamInputChannels ? blockIn.data() : nullptr, frames,
+                (double)renderPosition / sampleRate);
+
+    for (auto c = 0U; c < streamOutputChannels; ++c)
+    {
+      memcpy(output.channels[c].data() + renderPosition, blockOut.data() + c * frames,
+             frames * sizeof(float));
+    }
+    renderPosition += frames;
+  }
+  auto elapsed = (monotonicNanoseconds() - start) * 1e-9;
+  offlineRender = false;
+
+  auto rendered = (double)totalFrames / sampleRate;
+  LOG << "Rendered " << rendered << "s in " << elapsed << "s, "
+      << (elapsed > 0 ? rendered / elapsed : 0) << "x realtime" << std::endl;
+
+  if (!writeWavFile(settings.output, output, error))
+  {
+    LOG << "[ERROR] " << error << std::endl;
+    return 2;
+  }
+  return 0;
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <sstream>
+
+#include "standalone_host.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+/*
+ * A routing is written as a comma separated list of port:channel=devicechannel,
+ * for example "0:0=0,0:1=1,1:0=2,1:1=3" sends the first two stereo ports to
+ * the device channels 1 to 4.
+ */
+std::optional<std::vector<StandaloneHost::AudioRoute>> StandaloneHost::parseRouting(
+    const std::string &value)
+{
+  std::vector<AudioRoute> res;
+  std::stringstream ss(value);
+  std::string entry;
+  while (std::getline(ss, entry, ','))
+  {
+    if (entry.empty())
+    {
+      continue;
+    }
+    AudioRoute r;
+    char colon{0}, equals{0};
+    std::stringstream es(entry);
+    if (!(es >> r.port >> colon >> r.channel >> equals >> r.deviceChannel) || colon != ':' ||
+        equals != '=' || !(es >> std::ws).eof())
+    {
+      return std::nullopt;
+    }
+    res.push_back(r);
+  }
+  return res;
+}
+
+std::string StandaloneHost::routingToString(const std::vector<AudioRoute> &routing)
+{
+  std::string res;
+  for (const auto &r : routing)
+  {
+    if (!res.empty()) res += ",";
+    res += std::to_string(r.port) + ":" + std::to_string(r.channel) + "=" +
+           std::to_string(r.deviceChannel);
+  }
+  return res;
+}
+
+std::vector<StandaloneHost::AudioRoute> StandaloneHost::effectiveRouting(bool isInput) const
+{
+  if (isInput ? inputRoutingSet : outputRoutingSet)
+  {
+    return isInput ? inputRouting : outputRouting;
+  }
+
+  // the default layout puts the main port first and all other ports consecutively after it
+  const auto &channelByBus = isInput ? inputChannelByBus : outputChannelByBus;
+  auto mainPort = isInput ? mainInput : mainOutput;
+
+  std::vector<uint32_t> order;
+  if (mainPort < channelByBus.size()) order.push_back(mainPort);
+  for (auto p = 0U; p < channelByBus.size(); ++p)
+  {
+    if (p != mainPort) order.push_back(p);
+  }
+
+  std::vector<AudioRoute> res;
+  uint32_t deviceChannel{0};
+  for (auto p : order)
+  {
+    for (auto c = 0U; c < channelByBus[p]; ++c)
+    {
+      res.push_back({p, c, deviceChannel++});
+    }
+  }
+  return res;
+}
+
+uint32_t StandaloneHost::requiredDeviceChannels(bool isInput) const
+{
+  if (graph)
+  {
+    return graph->deviceChannels(isInput);
+  }
+  uint32_t res{0};
+  for (const auto &r : effectiveRouting(isInput))
+  {
+    res = std::max(res, r.deviceChannel + 1);
+  }
+  return res;
+}
+
+void StandaloneHost::buildRoutingTable()
+{
+  // channel rows are handed out in order after the silent row, allocateProcessMemory made room
+  // for as many as the routing can use
+  uint32_t nextRow{1};
+  auto takeRow = [&nextRow, this]()
+  {
+    auto row = std::min(nextRow, channelRows - 1);
+    nextRow++;
+    return channelRow(row);
+  };
+
+  auto build = [&](bool isInput)
+  {
+    const auto &channelByBus = isInput ? inputChannelByBus : outputChannelByBus;
+    auto streamChannels = isInput ? streamInputChannels : streamOutputChannels;
+    auto &ports = isInput ? inputPorts : outputPorts;
+    auto &channelPtr = isInput ? inputChannelPtr : outputChannelPtr;
+    auto &slotByChannel = isInput ? inputSlotByChannel : outputSlotByChannel;
+    auto &slots = isInput ? inputSlots : outputSlots;
+
+    // the first port channel of each port in the flat channel arrays
+    std::vector<uint32_t> firstChannel;
+    uint32_t totalChannels{0};
+    for (auto cc : channelByBus)
+    {
+      firstChannel.push_back(totalChannels);
+      totalChannels += cc;
+    }
+
+    // the device channels come first. An interleaved stream has them in channel rows, a non
+    // interleaved one replaces them with the device buffers in each block.
+    slots.clear();
+    for (auto d = 0U; d < streamChannels; ++d)
+    {
+      if (isInput && streamNonInterleaved)
+      {
+        slots.push_back(silentBuffer);
+      }
+      else
+      {
+        slots.push_back(takeRow());
+      }
+    }
+
+    // unrouted inputs read silence, unrouted outputs each write to their own scratch row
+    uint32_t silentSlot = (uint32_t)slots.size();
+    if (isInput)
+    {
+      slots.push_back(silentBuffer);
+    }
+    slotByChannel.assign(totalChannels, silentSlot);
+
+    std::vector<bool> deviceChannelUsed(streamChannels, false);
+    for (const auto &r : effectiveRouting(isInput))
+    {
+      if (r.port >= channelByBus.size() || r.channel >= channelByBus[r.port])
+      {
+        LOG << "[WARNING] " << (isInput ? "input" : "output") << " routing " << r.port << ":"
+            << r.channel << " does not exist on the plugin" << std::endl;
+        continue;
+      }
+      if (r.deviceChannel >= streamChannels)
+      {
+        LOG << "[WARNING] " << (isInput ? "input" : "output") << " routing " << r.port << ":"
+            << r.channel << " to device channel " << r.deviceChannel << " beyond the "
+            << streamChannels << " open channels" << std::endl;
+        continue;
+      }
+      if (!isInput && deviceChannelUsed[r.deviceChannel])
+      {
+        LOG << "[WARNING] output device channel " << r.deviceChannel << " is already routed, ignoring "
+            << r.port << ":" << r.channel << std::endl;
+        continue;
+      }
+      deviceChannelUsed[r.deviceChannel] = true;
+      slotByChannel[firstChannel[r.port] + r.channel] = r.deviceChannel;
+    }
+
+    if (!isInput)
+    {
+      for (auto &s : slotByChannel)
+      {
+        if (s == silentSlot)
+        {
+          s = (uint32_t)slots.size();
+          slots.push_back(takeRow());
+        }
+      }
+
+      unroutedDeviceOutputs.clear();
+      for (auto d = 0U; d < streamChannels; ++d)
+      {
+        if (!deviceChannelUsed[d]) unroutedDeviceOutputs.push_back(d);
+      }
+    }
+
+    channelPtr.assign(totalChannels, nullptr);
+    for (auto i = 0U; i < totalChannels; ++i)
+    {
+      channelPtr[i] = slots[slotByChannel[i]];
+    }
+
+    ports.assign(channelByBus.size(), clap_audio_buffer{});
+    for (auto p = 0U; p < channelByBus.size(); ++p)
+    {
+      auto &port = ports[p];
+      port.channel_count = channelByBus[p];
+      port.data32 = channelByBus[p] > 0 ? &(channelPtr[firstChannel[p]]) : nullptr;
+      port.constant_mask = 0;
+      for (auto c = 0U; isInput && c < channelByBus[p] && c < 64; ++c)
+      {
+        if (slotByChannel[firstChannel[p] + c] == silentSlot) port.constant_mask |= (1ULL << c);
+      }
+    }
+  };
+
+  build(true);
+  build(false);
+
+  if (nextRow > channelRows)
+  {
+    LOG << "[WARNING] routing needs " << nextRow << " channel buffers, sharing the last one"
+        << std::endl;
+  }
+  LOG << "Routing inputs '" << routingToString(effectiveRouting(true)) << "' outputs '"
+      << routingToString(effectiveRouting(false)) << "'" << std::endl;
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,147 @@
+#include <cmath>
+#include <sstream>
+
+#include "standalone_host.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+
+static clap_beattime doubleToBeatTime(double t)
+{
+  return std::llround(t * CLAP_BEATTIME_FACTOR);
+}
+
+static clap_sectime doubleToSecTime(double t)
+{
+  return std::llround(t * CLAP_SECTIME_FACTOR);
+}
+
+void StandaloneHost::setTransport(const TransportSettings &settings)
+{
+  transportSettings = settings;
+  transportSettings.rewind = false;
+  transportToAudioQueue.push(settings);
+}
+
+void StandaloneHost::rewindTransport()
+{
+  auto settings = transportSettings;
+  settings.rewind = true;
+  transportToAudioQueue.push(settings);
+}
+
+bool StandaloneHost::parseTimeSignature(const std::string &value, uint16_t &num, uint16_t &denom)
+{
+  std::stringstream ss(value);
+  unsigned int n{0}, d{0};
+  char slash{0};
+  if (!(ss >> n >> slash >> d) || slash != '/' || !(ss >> std::ws).eof() || n == 0 || n > 64 ||
+      d == 0 || d > 64)
+  {
+    return false;
+  }
+  num = (uint16_t)n;
+  denom = (uint16_t)d;
+  return true;
+}
+
+bool StandaloneHost::parseLoop(const std::string &value, double &start, double &end)
+{
+  std::stringstream ss(value);
+  double s{0}, e{0};
+  char colon{0};
+  if (!(ss >> s >> colon >> e) || colon != ':' || !(ss >> std::ws).eof() || s < 0 || e <= s)
+  {
+    return false;
+  }
+  start = s;
+  end = e;
+  return true;
+}
+
+// the fields which follow the position, for the block start and the loop wrap events
+static void setTransportPosition(clap_event_transport &t, double beats, double tempo, uint16_t tsigNum,
+                                 uint16_t tsigDenom)
+{
+  t.song_pos_beats = doubleToBeatTime(beats);
+  t.song_pos_seconds = doubleToSecTime(beats * 60.0 / tempo);
+
+  double quartersPerBar = tsigNum * 4.0 / tsigDenom;
+  auto bar = std::floor(beats / quartersPerBar);
+  t.bar_start = doubleToBeatTime(bar * quartersPerBar);
+  t.bar_number = (int32_t)bar;
+}
+
+void StandaloneHost::prepareTransport(uint32_t frameCount)
+{
+  const auto &ts = audioTransportSettings;
+
+  TransportSettings request;
+  bool changed = transport.header.size == 0;
+  while (transportToAudioQueue.pop(request))
+  {
+    if (request.rewind)
+    {
+      transportBeats = request.loopActive ? request.loopStartBeats : 0;
+    }
+    audioTransportSettings = request;
+    changed = true;
+  }
+
+  // the fields which only change with the settings
+  if (changed)
+  {
+    transport.header = {sizeof(transport), 0, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_TRANSPORT, 0};
+    transport.flags = CLAP_TRANSPORT_HAS_TEMPO | CLAP_TRANSPORT_HAS_BEATS_TIMELINE |
+                      CLAP_TRANSPORT_HAS_SECONDS_TIMELINE | CLAP_TRANSPORT_HAS_TIME_SIGNATURE |
+                      (ts.playing ? CLAP_TRANSPORT_IS_PLAYING : 0) |
+                      (ts.loopActive ? CLAP_TRANSPORT_IS_LOOP_ACTIVE : 0);
+    transport.tempo = ts.tempo;
+    transport.tempo_inc = 0;
+    transport.tsig_num = ts.tsigNum;
+    transport.tsig_denom = ts.tsigDenom;
+    transport.loop_start_beats = doubleToBeatTime(ts.loopStartBeats);
+    transport.loop_end_beats = doubleToBeatTime(ts.loopEndBeats);
+    transport.loop_start_seconds = doubleToSecTime(ts.loopStartBeats * 60.0 / ts.tempo);
+    transport.loop_end_seconds = doubleToSecTime(ts.loopEndBeats * 60.0 / ts.tempo);
+  }
+
+  setTransportPosition(transport, transportBeats, ts.tempo, ts.tsigNum, ts.tsigDenom);
+
+  // a loop wrap within the block is a transport event at the first sample after the loop end
+  if (ts.playing && ts.loopActive && ts.loopEndBeats > ts.loopStartBeats && currentSampleRate > 0 &&
+      transportBeats < ts.loopEndBeats)
+  {
+    auto beatsPerSample = ts.tempo / 60.0 / currentSampleRate;
+    auto samplesToEnd = (ts.loopEndBeats - transportBeats) / beatsPerSample;
+    auto wrapAt = (uint32_t)std::ceil(samplesToEnd);
+    if (wrapAt < frameCount)
+    {
+      auto wrap = transport;
+      wrap.header.time = wrapAt;
+      setTransportPosition(wrap, ts.loopStartBeats + (wrapAt - samplesToEnd) * beatsPerSample, ts.tempo,
+                           ts.tsigNum, ts.tsigDenom);
+      insertInputEvent(&(wrap.header));
+    }
+  }
+}
+
+void StandaloneHost::advanceTransport(uint32_t frameCount)
+{
+  const auto &ts = audioTransportSettings;
+  steadyTime += frameCount;
+  if (!ts.playing || currentSampleRate <= 0)
+  {
+    return;
+  }
+
+  auto next = transportBeats + frameCount * ts.tempo / 60.0 / currentSampleRate;
+  auto loopLength = ts.loopEndBeats - ts.loopStartBeats;
+  if (ts.loopActive && loopLength > 0 && transportBeats < ts.loopEndBeats && next >= ts.loopEndBeats)
+  {
+    next = ts.loopStartBeats + std::fmod(next - ts.loopEndBeats, loopLength);
+  }
+  transportBeats = next;
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
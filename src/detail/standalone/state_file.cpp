@@ -0,0 +1,231 @@
+#include "state_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+
+#if WIN
+#define NOMINMAX 1
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "standalone_details.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+bool MappedStateFile::open(const fs::path &path)
+{
+  close();
+#if WIN
+  _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                      FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (_file == INVALID_HANDLE_VALUE)
+  {
+    _file = nullptr;
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(_file, &size))
+  {
+    close();
+    return false;
+  }
+  _size = (size_t)size.QuadPart;
+  if (_size > 0)
+  {
+    _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    _data = _mapping ? (const uint8_t *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!_data)
+    {
+      close();
+      return false;
+    }
+  }
+#else
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  _size = (size_t)st.st_size;
+  if (_size > 0)
+  {
+    // the mapping keeps the file referenced, the descriptor isn't needed any more
+    auto *mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+      _size = 0;
+      return false;
+    }
+    _data = (const uint8_t *)mapped;
+    madvise(mapped, _size, MADV_SEQUENTIAL);
+    madvise(mapped, _size, MADV_WILLNEED);
+  }
+  else
+  {
+    ::close(fd);
+  }
+#endif
+  _readPos = 0;
+  return true;
+}
+
+void MappedStateFile::close()
+{
+#if WIN
+  if (_data)
+  {
+    UnmapViewOfFile(_data);
+  }
+  if (_mapping)
+  {
+    CloseHandle(_mapping);
+    _mapping = nullptr;
+  }
+  if (_file)
+  {
+    CloseHandle(_file);
+    _file = nullptr;
+  }
+#else
+  if (_data)
+  {
+    munmap((void *)_data, _size);
+  }
+#endif
+  _data = nullptr;
+  _size = 0;
+  _readPos = 0;
+}
+
+const clap_istream *MappedStateFile::stream()
+{
+  _readPos = 0;
+  _stream.ctx = this;
+  _stream.read = read;
+  return &_stream;
+}
+
+int64_t MappedStateFile::read(const clap_istream *stream, void *buffer, uint64_t size)
+{
+  auto *self = static_cast<MappedStateFile *>(stream->ctx);
+  auto n = (size_t)std::min<uint64_t>(size, self->_size - self->_readPos);
+  if (n > 0)
+  {
+    memcpy(buffer, self->_data + self->_readPos, n);
+    self->_readPos += n;
+  }
+  return (int64_t)n;
+}
+
+StateFileWriter::~StateFileWriter()
+{
+  discard();
+}
+
+bool StateFileWriter::open(const fs::path &path)
+{
+  discard();
+  _path = path;
+  _tempPath = path;
+  _tempPath += ".tmp";
+#if WIN
+  _file = _wfopen(_tempPath.c_str(), L"wb");
+#else
+  _file = fopen(_tempPath.c_str(), "wb");
+#endif
+  if (!_file)
+  {
+    return false;
+  }
+  _buffer.resize(bufferSize);
+  setvbuf(_file, _buffer.data(), _IOFBF, _buffer.size());
+  _failed = false;
+  return true;
+}
+
+bool StateFileWriter::write(const void *data, size_t size)
+{
+  if (!_file || _failed)
+  {
+    return false;
+  }
+  _failed = fwrite(data, 1, size, _file) != size;
+  return !_failed;
+}
+
+const clap_ostream *StateFileWriter::stream()
+{
+  _stream.ctx = this;
+  _stream.write = write;
+  return &_stream;
+}
+
+int64_t StateFileWriter::write(const clap_ostream *stream, const void *buffer, uint64_t size)
+{
+  auto *self = static_cast<StateFileWriter *>(stream->ctx);
+  return self->write(buffer, (size_t)size) ? (int64_t)size : -1;
+}
+
+bool StateFileWriter::commit()
+{
+  if (!_file)
+  {
+    return false;
+  }
+  // the data has to be on the disk before the rename is, or a crash can leave an empty file
+  auto ok = !_failed && fflush(_file) == 0;
+#if WIN
+  ok = ok && _commit(_fileno(_file)) == 0;
+#else
+  ok = ok && fsync(fileno(_file)) == 0;
+#endif
+  ok = fclose(_file) == 0 && ok;
+  _file = nullptr;
+  if (ok)
+  {
+    std::error_code ec;
+    fs::rename(_tempPath, _path, ec);
+    ok = !ec;
+  }
+  if (ok)
+  {
+    _tempPath.clear();
+  }
+  else
+  {
+    LOG << "[ERROR] Unable to write " << _path.u8string() << ", keeping the previous file" << std::endl;
+    discard();
+  }
+  return ok;
+}
+
+void StateFileWriter::discard()
+{
+  if (_file)
+  {
+    fclose(_file);
+    _file = nullptr;
+  }
+  if (!_tempPath.empty())
+  {
+    std::error_code ec;
+    fs::remove(_tempPath, ec);
+  }
+  _buffer.clear();
+  _buffer.shrink_to_fit();
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+ * The files the standalone keeps the plugin state in. A state is read from a read-only memory
+ * map, so each read of the plugin is a copy out of the page cache, and written to a temporary
+ * file next to the target which replaces it only once it is complete, so a crash or a full
+ * disk never leaves a truncated state behind.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <clap/clap.h>
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+class MappedStateFile
+{
+ public:
+  MappedStateFile() = default;
+  ~MappedStateFile()
+  {
+    close();
+  }
+  MappedStateFile(const MappedStateFile &) = delete;
+  MappedStateFile &operator=(const MappedStateFile &) = delete;
+
+  // maps the whole file and hints the kernel to read it ahead, an empty file maps to nothing
+  bool open(const fs::path &path);
+  void close();
+
+  const uint8_t *data() const
+  {
+    return _data;
+  }
+  size_t size() const
+  {
+    return _size;
+  }
+  // reads the mapping from the start, valid as long as the mapping is
+  const clap_istream *stream();
+
+ private:
+  static int64_t read(const clap_istream *stream, void *buffer, uint64_t size);
+
+  const uint8_t *_data{nullptr};
+  size_t _size{0}, _readPos{0};
+  clap_istream _stream{};
+#if WIN
+  void *_file{nullptr}, *_mapping{nullptr};
+#endif
+};
+
+class StateFileWriter
+{
+ public:
+  StateFileWriter() = default;
+  // removes the temporary file unless it was committed
+  ~StateFileWriter();
+  StateFileWriter(const StateFileWriter &) = delete;
+  StateFileWriter &operator=(const StateFileWriter &) = delete;
+
+  bool open(const fs::path &path);
+  bool write(const void *data, size_t size);
+  const clap_ostream *stream();
+  // flushes and syncs the temporary file and renames it over the target
+  bool commit();
+
+ private:
+  static int64_t write(const clap_ostream *stream, const void *buffer, uint64_t size);
+  void discard();
+
+  // a plugin writing in small pieces fills this before it goes to the file, larger writes
+  // go straight through
+  static constexpr size_t bufferSize{1024 * 1024};
+  fs::path _path, _tempPath;
+  FILE *_file{nullptr};
+  std::vector<char> _buffer;
+  bool _failed{false};
+  clap_ostream _stream{};
+};
+}  // namespace freeaudio::clap_wrapper::standalone
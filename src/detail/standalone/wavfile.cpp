@@ -0,0 +1,196 @@
+#include "wavfile.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+static constexpr uint16_t formatPCM{1}, formatFloat{3}, formatExtensible{0xFFFE};
+
+static uint32_t le32(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const unsigned char *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put32(std::ostream &ofs, uint32_t v)
+{
+  unsigned char b[4] = {(unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16),
+                        (unsigned char)(v >> 24)};
+  ofs.write((const char *)b, 4);
+}
+
+static void put16(std::ostream &ofs, uint16_t v)
+{
+  unsigned char b[2] = {(unsigned char)v, (unsigned char)(v >> 8)};
+  ofs.write((const char *)b, 2);
+}
+
+bool readWavFile(const fs::path &path, AudioFileData &data, std::string &error)
+{
+  std::ifstream ifs(path, std::ios::in | std::ios::binary);
+  if (!ifs.is_open())
+  {
+    error = "unable to open " + path.u8string();
+    return false;
+  }
+
+  unsigned char riff[12];
+  if (!ifs.read((char *)riff, 12) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+  {
+    error = "not a RIFF/WAVE file";
+    return false;
+  }
+
+  uint16_t format{0}, numChannels{0}, bitsPerSample{0};
+  bool hasFormat{false};
+  std::vector<unsigned char> samples;
+
+  unsigned char chunk[8];
+  while (ifs.read((char *)chunk, 8))
+  {
+    auto size = le32(chunk + 4);
+    if (memcmp(chunk, "fmt ", 4) == 0)
+    {
+      std::vector<unsigned char> fmt(size);
+      if (size < 16 || !ifs.read((char *)fmt.data(), size))
+      {
+        error = "broken fmt chunk";
+        return false;
+      }
+      format = le16(fmt.data());
+      numChannels = le16(fmt.data() + 2);
+      data.sampleRate = (int32_t)le32(fmt.data() + 4);
+      bitsPerSample = le16(fmt.data() + 14);
+      if (format == formatExtensible && size >= 26)
+      {
+        // the first two bytes of the sub format guid are the actual format
+        format = le16(fmt.data() + 24);
+      }
+      hasFormat = true;
+    }
+    else if (memcmp(chunk, "data", 4) == 0)
+    {
+      samples.resize(size);
+      ifs.read((char *)samples.data(), size);
+      samples.resize((size_t)ifs.gcount());
+      break;
+    }
+    else
+    {
+      ifs.seekg(size, std::ios::cur);
+    }
+    if (size & 1)
+    {
+      ifs.seekg(1, std::ios::cur);
+    }
+  }
+
+  if (!hasFormat || numChannels == 0)
+  {
+    error = "no fmt chunk";
+    return false;
+  }
+  auto bytesPerSample = bitsPerSample / 8U;
+  bool supported =
+      (format == formatPCM && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32)) ||
+      (format == formatFloat && (bitsPerSample == 32 || bitsPerSample == 64));
+  if (!supported)
+  {
+    error = "unsupported sample format " + std::to_string(format) + "/" + std::to_string(bitsPerSample);
+    return false;
+  }
+
+  auto frames = samples.size() / (bytesPerSample * numChannels);
+  data.channels.assign(numChannels, std::vector<float>(frames));
+  const unsigned char *p = samples.data();
+  for (size_t i = 0; i < frames; ++i)
+  {
+    for (auto c = 0U; c < numChannels; ++c)
+    {
+      float v{0};
+      if (format == formatFloat && bitsPerSample == 32)
+      {
+        memcpy(&v, p, 4);
+      }
+      else if (format == formatFloat)
+      {
+        double d;
+        memcpy(&d, p, 8);
+        v = (float)d;
+      }
+      else if (bitsPerSample == 16)
+      {
+        v = (int16_t)le16(p) / 32768.f;
+      }
+      else if (bitsPerSample == 24)
+      {
+        auto s = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+        v = s / 8388608.f;
+      }
+      else
+      {
+        v = (float)((int32_t)le32(p) / 2147483648.0);
+      }
+      data.channels[c][i] = v;
+      p += bytesPerSample;
+    }
+  }
+  return true;
+}
+
+void writeWavHeader(std::ostream &os, uint16_t numChannels, int32_t sampleRate, uint32_t dataBytes)
+{
+  os.write("RIFF", 4);
+  put32(os, wavHeaderBytes - 8 + dataBytes);
+  os.write("WAVE", 4);
+
+  os.write("fmt ", 4);
+  put32(os, 16);
+  put16(os, formatFloat);
+  put16(os, numChannels);
+  put32(os, (uint32_t)sampleRate);
+  put32(os, (uint32_t)(sampleRate * numChannels * sizeof(float)));
+  put16(os, (uint16_t)(numChannels * sizeof(float)));
+  put16(os, 32);
+
+  os.write("data", 4);
+  put32(os, dataBytes);
+}
+
+bool writeWavFile(const fs::path &path, const AudioFileData &data, std::string &error)
+{
+  std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open())
+  {
+    error = "unable to open " + path.u8string() + " for writing";
+    return false;
+  }
+
+  auto numChannels = (uint16_t)data.channels.size();
+  auto frames = data.frames();
+  writeWavHeader(ofs, numChannels, data.sampleRate, (uint32_t)(frames * numChannels * sizeof(float)));
+
+  std::vector<float> interleaved(numChannels);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    for (auto c = 0U; c < numChannels; ++c)
+    {
+      interleaved[c] = data.channels[c][i];
+    }
+    // the floats are stored little endian, like on all platforms the wrapper runs on
+    ofs.write((const char *)interleaved.data(), numChannels * sizeof(float));
+  }
+
+  if (!ofs.good())
+  {
+    error = "write to " + path.u8string() + " failed";
+    return false;
+  }
+  return true;
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+ * Minimal RIFF/WAVE reading and writing for the offline render. Reads 16, 24 and 32 bit
+ * integer PCM and 32/64 bit float, always writes 32 bit float.
+ */
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "detail/clap/fsutil.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct AudioFileData
+{
+  int32_t sampleRate{0};
+  // one vector of samples per channel
+  std::vector<std::vector<float>> channels;
+
+  size_t frames() const
+  {
+    return channels.empty() ? 0 : channels[0].size();
+  }
+};
+
+// the header of a 32 bit float file, written again with the final size by streaming writers
+static constexpr uint32_t wavHeaderBytes{44};
+void writeWavHeader(std::ostream &os, uint16_t numChannels, int32_t sampleRate, uint32_t dataBytes);
+
+bool readWavFile(const fs::path &path, AudioFileData &data, std::string &error);
+bool writeWavFile(const fs::path &path, const AudioFileData &data, std::string &error);
+}  // namespace freeaudio::clap_wrapper::standalone
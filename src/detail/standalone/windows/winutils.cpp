@@ -27,18 +27,29 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine
 #else
   std::string clapName{HOSTED_CLAP_NAME};
 
-  auto searchPaths{Clap::getValidCLAPSearchPaths()};
-
   auto lib{Clap::Library()};
 
-  for (const auto& searchPath : searchPaths)
+  // the search paths are only walked if the cached location is gone or has changed
+  auto cached{Clap::lookupDiscoveryCache(clapName + ".clap")};
+  if (cached && lib.load(*cached))
+  {
+    entry = lib._pluginEntry;
+  }
+
+  if (!entry)
   {
-    auto clapPath = searchPath / (clapName + ".clap");
+    auto searchPaths{Clap::getValidCLAPSearchPaths()};
 
-    if (fs::exists(clapPath) && !entry)
+    for (const auto& searchPath : searchPaths)
     {
-      lib.load(clapPath);
-      entry = lib._pluginEntry;
+      auto clapPath = searchPath / (clapName + ".clap");
+
+      if (fs::exists(clapPath) && !entry)
+      {
+        lib.load(clapPath);
+        entry = lib._pluginEntry;
+        if (entry) Clap::storeDiscoveryCache(clapName + ".clap", clapPath);
+      }
     }
   }
 #endif
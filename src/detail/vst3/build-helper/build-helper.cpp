@@ -0,0 +1,178 @@
+/*
+    writes the moduleinfo.json of a VST3 bundle
+
+    A host which finds Contents/Resources/moduleinfo.json in a bundle can list its classes
+    without loading the binary, which for a wrapper means without searching and loading the
+    CLAP as well. This runs after the build, loads the CLAP the wrapper is built for and
+    describes its classes exactly like the factory of the wrapper (see classinfo.h).
+
+      build-helper <clap> <moduleinfo.json> <module name> <module version> [<tuid>]
+*/
+
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include <pluginterfaces/base/ipluginbase.h>
+#include <pluginterfaces/vst/ivstcomponent.h>
+#include <pluginterfaces/vst/vsttypes.h>
+
+#include "detail/clap/fsutil.h"
+#include "detail/vst3/classinfo.h"
+
+// the library logs its search, which is build output here
+namespace os
+{
+void log(const char *text)
+{
+  std::cout << "  - " << text << std::endl;
+}
+}  // namespace os
+
+static std::string jsonString(const std::string &text)
+{
+  std::string result{"\""};
+  for (auto c : text)
+  {
+    switch (c)
+    {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\r':
+        result += "\\r";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if ((unsigned char)c < 0x20)
+        {
+          char esc[8];
+          snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)c);
+          result += esc;
+        }
+        else
+        {
+          result += c;
+        }
+    }
+  }
+  return result + "\"";
+}
+
+static std::string subCategoryList(const std::string &subCategories)
+{
+  std::string result{"["};
+  std::istringstream tokens(subCategories);
+  std::string token;
+  bool first{true};
+  while (std::getline(tokens, token, '|'))
+  {
+    if (token.empty()) continue;
+    result += (first ? "" : ", ") + jsonString(token);
+    first = false;
+  }
+  return result + "]";
+}
+
+static void writeModuleInfo(std::ostream &of, const Vst3FactoryDescription &description,
+                            const std::string &name, const std::string &version)
+{
+  auto flags = Steinberg::Vst::kDefaultFactoryFlags;
+  auto flag = [flags](Steinberg::int32 f) { return (flags & f) ? "true" : "false"; };
+
+  of << "{\n"
+     << "  \"Name\": " << jsonString(name) << ",\n"
+     << "  \"Version\": " << jsonString(version) << ",\n"
+     << "  \"Factory Info\": {\n"
+     << "    \"Vendor\": " << jsonString(description.vendor) << ",\n"
+     << "    \"URL\": " << jsonString(description.url) << ",\n"
+     << "    \"E-Mail\": " << jsonString(description.email) << ",\n"
+     << "    \"Flags\": {\n"
+     << "      \"Unicode\": " << flag(Steinberg::PFactoryInfo::kUnicode) << ",\n"
+     << "      \"Classes Discardable\": " << flag(Steinberg::PFactoryInfo::kClassesDiscardable)
+     << ",\n"
+     << "      \"Component Non Discardable\": "
+     << flag(Steinberg::PFactoryInfo::kComponentNonDiscardable) << "\n"
+     << "    }\n"
+     << "  },\n"
+     << "  \"Compatibility\": [],\n"
+     << "  \"Classes\": [";
+  bool first{true};
+  for (auto &c : description.classes)
+  {
+    of << (first ? "\n" : ",\n") << "    {\n"
+       << "      \"CID\": " << jsonString(vst3ClassIdString(c.cid)) << ",\n"
+       << "      \"Category\": " << jsonString(c.category) << ",\n"
+       << "      \"Name\": " << jsonString(c.name) << ",\n"
+       << "      \"Vendor\": " << jsonString(c.vendor) << ",\n"
+       << "      \"Version\": " << jsonString(c.version) << ",\n"
+       << "      \"SDKVersion\": " << jsonString(kVstVersionString) << ",\n"
+       << "      \"Sub Categories\": " << subCategoryList(c.subCategories) << ",\n"
+       << "      \"Class Flags\": 0,\n"
+       << "      \"Cardinality\": " << Steinberg::PClassInfo::kManyInstances << ",\n"
+       << "      \"Snapshots\": []\n"
+       << "    }";
+    first = false;
+  }
+  of << "\n  ]\n}\n";
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 5 || argc > 6)
+  {
+    std::cout << "[ERROR] Configuration incorrect. Got " << argc << " arguments" << std::endl;
+    return 1;
+  }
+
+  std::cout << "clap-wrapper: vst3 moduleinfo tool starting\n";
+
+  auto clapfile = fs::path(argv[1]);
+  auto outfile = fs::path(argv[2]);
+  std::string name{argv[3]}, version{argv[4]};
+  const char *tuid = argc > 5 && *argv[5] ? argv[5] : nullptr;
+
+  std::cout << "  - source clap: '" << clapfile.u8string() << "'" << std::endl;
+  Clap::Library loader;
+  if (!loader.load(clapfile))
+  {
+    std::cout << "[ERROR] library.load of clapfile failed" << std::endl;
+    return 2;
+  }
+  if (loader.plugins.empty())
+  {
+    std::cout << "[ERROR] No plugins in clap file" << std::endl;
+    return 3;
+  }
+
+  auto description = describeVst3Factory(loader, tuid);
+
+  std::error_code ec;
+  fs::create_directories(outfile.parent_path(), ec);
+  std::ofstream of(outfile, std::ios::out | std::ios::trunc);
+  if (!of.is_open())
+  {
+    std::cout << "[ERROR] Unable to open '" << outfile.u8string() << "'" << std::endl;
+    return 4;
+  }
+  writeModuleInfo(of, description, name, version);
+  of.close();
+  if (of.fail())
+  {
+    std::cout << "[ERROR] Unable to write '" << outfile.u8string() << "'" << std::endl;
+    return 4;
+  }
+
+  std::cout << "  - wrote " << description.classes.size() << " classes to '" << outfile.u8string()
+            << "'" << std::endl;
+  return 0;
+}
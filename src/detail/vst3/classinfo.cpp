@@ -0,0 +1,265 @@
+/*
+    describing the VST3 classes of a CLAP library
+
+    Copyright (c) 2022 Timo Kaluza (defiantnerd)
+
+    This file is part of the clap-wrappers project which is released under MIT License.
+    See file LICENSE or go to https://github.com/free-audio/clap-wrapper for full license details.
+
+
+    Every plugin of the CLAP factory becomes an audio effect class. Its class id is, in this order
+
+      - the TUID the wrapper was built with (SINGLE_PLUGIN_TUID in cmake), applied to every plugin
+      - the componentId of the CLAP_PLUGIN_AS_VST3 extension
+      - a SHA1 based UUID derived from the CLAP id
+
+    The vendor and the categories can be overridden by the extension as well. Every ARA factory
+    of the library becomes an ARA main factory class for the plugin it belongs to, with an id
+    derived from the CLAP id and "-ARA".
+
+    A snapshot is a text file, a header line, the stamps and the CLAP path, the factory info and
+    a line per class, the fields separated by tabs. A description with a tab or a line break in
+    one of its strings isn't stored.
+*/
+
+#include "classinfo.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <pluginterfaces/vst/ivstaudioprocessor.h>
+
+#include "detail/clap/fsutil.h"
+#include "detail/shared/sha1.h"
+#include "categories.h"
+#include "../ara/ara.h"
+
+static const char* orEmpty(const char* text)
+{
+  return text ? text : "";
+}
+
+static std::string className(const clap_plugin_descriptor_t* descr)
+{
+  std::string n(orEmpty(descr->name));
+#ifdef _DEBUG
+  n.append(" (CLAP->VST3)");
+#endif
+  return n;
+}
+
+static void sha1ClassId(const std::string& name, Steinberg::TUID& cid)
+{
+  auto g = Crypto::create_sha1_guid_from_name(name.c_str(), name.size());
+  memcpy(&cid, &g, sizeof(Steinberg::TUID));
+}
+
+Vst3FactoryDescription describeVst3Factory(const Clap::Library& lib, const char* tuidOverride)
+{
+  Vst3FactoryDescription result;
+  if (lib.plugins.empty())
+  {
+    return result;
+  }
+
+  // we need at least one plugin to obtain vendor/name etc.
+  result.vendor = orEmpty(lib.plugins[0]->vendor);
+  result.url = orEmpty(lib.plugins[0]->url);
+  // TODO: extract the domain and prefix with info@
+  result.email = "info@";
+
+  // override for VST3 specifics
+  if (auto* v3 = lib._pluginFactoryVst3Info)
+  {
+    if (v3->vendor) result.vendor = v3->vendor;
+    if (v3->vendor_url) result.url = v3->vendor_url;
+    if (v3->email_contact) result.email = v3->email_contact;
+  }
+
+  Steinberg::FUID fixedId;
+  auto hasFixedId = tuidOverride && fixedId.fromString(tuidOverride);
+
+  int numPlugins = static_cast<int>(lib.plugins.size());
+  for (int ctr = 0; ctr < numPlugins; ++ctr)
+  {
+    auto* clapdescr = lib.plugins[ctr];
+    auto* vst3info = lib.get_vst3_info(ctr);
+
+    Vst3ClassDescription c;
+    c.category = kVstAudioEffectClass;
+    c.name = className(clapdescr);
+    c.version = orEmpty(clapdescr->version);
+    c.index = ctr;
+
+    // get vendor -------------------------------------
+    c.vendor = orEmpty(clapdescr->vendor);
+    if (c.vendor.empty()) c.vendor = "Unspecified Vendor";
+    if (vst3info && vst3info->vendor) c.vendor = vst3info->vendor;
+
+    // make id or take it from vst3 info --------------
+    if (hasFixedId)
+    {
+      memcpy(&c.cid, fixedId.toTUID(), sizeof(Steinberg::TUID));
+    }
+    else if (vst3info && vst3info->componentId)
+    {
+      memcpy(&c.cid, vst3info->componentId, sizeof(Steinberg::TUID));
+    }
+    else
+    {
+      sha1ClassId(orEmpty(clapdescr->id), c.cid);
+    }
+
+    // features ----------------------------------------
+    if (vst3info && vst3info->features)
+    {
+      c.subCategories = vst3info->features;
+    }
+    else
+    {
+      c.subCategories = clapCategoriesToVST3(clapdescr->features);
+    }
+
+    result.classes.push_back(std::move(c));
+  }
+
+  if (auto* factory = lib._pluginFactoryARAInfo)
+  {
+    auto count = factory->get_factory_count(factory);
+    for (decltype(count) i = 0; i < count; ++i)
+    {
+      auto matching_plugin = factory->get_plugin_id(factory, i);
+      for (auto* clapdescr : lib.plugins)
+      {
+        if (!strcmp(clapdescr->id, matching_plugin))
+        {
+          Vst3ClassDescription c;
+          c.category = kARAMainFactoryClass;
+          c.name = className(clapdescr);
+          c.version = orEmpty(clapdescr->version);
+          c.index = (int)i;
+          sha1ClassId(std::string(matching_plugin) + "-ARA", c.cid);
+          result.classes.push_back(std::move(c));
+          break;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+std::string vst3ClassIdString(const Steinberg::TUID& cid)
+{
+  constexpr char hexchar[] = "0123456789ABCDEF";
+  std::string result;
+  for (auto i = 0U; i < sizeof(Steinberg::TUID); ++i)
+  {
+    auto n = (uint8_t)cid[i];
+    result.push_back(hexchar[(n >> 4) & 0xF]);
+    result.push_back(hexchar[n & 0xF]);
+  }
+  return result;
+}
+
+static constexpr const char* snapshotHeader{"clap-wrapper vst3 classes 1"};
+
+static std::vector<std::string> splitFields(const std::string& line)
+{
+  std::vector<std::string> result;
+  size_t start = 0;
+  for (auto tab = line.find('\t'); tab != std::string::npos; tab = line.find('\t', start))
+  {
+    result.push_back(line.substr(start, tab - start));
+    start = tab + 1;
+  }
+  result.push_back(line.substr(start));
+  return result;
+}
+
+static bool parseClassId(const std::string& text, Steinberg::TUID& cid)
+{
+  if (text.size() != 2 * sizeof(Steinberg::TUID)) return false;
+  auto nibble = [](char c) -> int
+  {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+  for (auto i = 0U; i < sizeof(Steinberg::TUID); ++i)
+  {
+    auto hi = nibble(text[2 * i]), lo = nibble(text[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    cid[i] = (char)((hi << 4) | lo);
+  }
+  return true;
+}
+
+bool readVst3Snapshot(const fs::path& file, Vst3FactorySnapshot& snapshot)
+{
+  std::ifstream ifs(file, std::ios::in | std::ios::binary);
+  std::string line;
+  if (!std::getline(ifs, line) || line != snapshotHeader) return false;
+
+  Vst3FactorySnapshot result;
+  try
+  {
+    if (!std::getline(ifs, line)) return false;
+    auto stamps = splitFields(line);
+    if (stamps.size() != 3) return false;
+    result.wrapperStamp = std::stoll(stamps[0]);
+    result.clapStamp = std::stoll(stamps[1]);
+    result.clapPath = fs::u8path(stamps[2]);
+
+    if (!std::getline(ifs, line)) return false;
+    auto factory = splitFields(line);
+    if (factory.size() != 3) return false;
+    result.description.vendor = factory[0];
+    result.description.url = factory[1];
+    result.description.email = factory[2];
+
+    while (std::getline(ifs, line))
+    {
+      auto f = splitFields(line);
+      Vst3ClassDescription c;
+      if (f.size() != 7 || !parseClassId(f[0], c.cid)) return false;
+      c.index = std::stoi(f[1]);
+      c.category = f[2];
+      c.name = f[3];
+      c.vendor = f[4];
+      c.version = f[5];
+      c.subCategories = f[6];
+      result.description.classes.push_back(std::move(c));
+    }
+  }
+  catch (const std::exception& e)
+  {
+    return false;
+  }
+  if (result.description.classes.empty()) return false;
+  snapshot = std::move(result);
+  return true;
+}
+
+bool writeVst3Snapshot(const fs::path& file, const Vst3FactorySnapshot& snapshot)
+{
+  bool storable{true};
+  auto field = [&storable](const std::string& text) -> const std::string&
+  {
+    storable = storable && text.find_first_of("\t\r\n") == std::string::npos;
+    return text;
+  };
+
+  const auto& d = snapshot.description;
+  std::ostringstream content;
+  content << snapshotHeader << '\n'
+          << snapshot.wrapperStamp << '\t' << snapshot.clapStamp << '\t'
+          << field(snapshot.clapPath.u8string()) << '\n'
+          << field(d.vendor) << '\t' << field(d.url) << '\t' << field(d.email) << '\n';
+  for (const auto& c : d.classes)
+  {
+    content << vst3ClassIdString(c.cid) << '\t' << c.index << '\t' << field(c.category) << '\t'
+            << field(c.name) << '\t' << field(c.vendor) << '\t' << field(c.version) << '\t'
+            << field(c.subCategories) << '\n';
+  }
+  return storable && !d.classes.empty() && Clap::writeCacheFile(file, content.str());
+}
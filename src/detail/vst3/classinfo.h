@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+    The classes the VST3 factory registers for a CLAP library.
+
+    The entry registers them when a host loads the factory and the build helper writes them into
+    the moduleinfo.json of the bundle, so both have to derive the ids, names and categories the
+    same way. See classinfo.cpp for details.
+*/
+
+#include <string>
+#include <vector>
+#include <pluginterfaces/base/funknown.h>
+#include "detail/clap/fsutil.h"
+
+struct Vst3ClassDescription
+{
+  Steinberg::TUID cid;
+  // kVstAudioEffectClass or kARAMainFactoryClass
+  std::string category;
+  std::string name, vendor, version;
+  // the VST3 sub categories separated by '|', empty for an ARA factory
+  std::string subCategories;
+  // the plugin index for an audio effect, the ARA factory index for an ARA factory
+  int index{0};
+};
+
+struct Vst3FactoryDescription
+{
+  std::string vendor, url, email;
+  std::vector<Vst3ClassDescription> classes;
+};
+
+// tuidOverride is the TUID string the wrapper was built with for a single plugin, or nullptr
+Vst3FactoryDescription describeVst3Factory(const Clap::Library& lib, const char* tuidOverride);
+
+// the 32 hex digits of a class id in the byte order of the TUID, as moduleinfo.json has them
+std::string vst3ClassIdString(const Steinberg::TUID& cid);
+
+// The description the factory registers the classes from without loading the CLAP. It's valid
+// while the wrapper binary and the CLAP keep the stamps (see Clap::getCacheStamp) they had when
+// it was taken. A wrapper which contains its CLAP has no CLAP path.
+struct Vst3FactorySnapshot
+{
+  int64_t wrapperStamp{0}, clapStamp{0};
+  fs::path clapPath;
+  Vst3FactoryDescription description;
+};
+
+bool readVst3Snapshot(const fs::path& file, Vst3FactorySnapshot& snapshot);
+// false if the description can't be stored, which leaves the file as it was
+bool writeVst3Snapshot(const fs::path& file, const Vst3FactorySnapshot& snapshot);
@@ -6,9 +6,11 @@
 
 #include "parameter.h"
 #include <algorithm>
+#include <type_traits>
 
 #include <cmath>
 #include "../clap/automation.h"
+#include "../shared/audiothread_guard.h"
 
 namespace Clap
 {
@@ -21,7 +23,8 @@ void ProcessAdapter::setupProcessing(const clap_plugin_t* plugin, const clap_plu
                                      Steinberg::Vst::ParameterContainer& params,
                                      Steinberg::Vst::IComponentHandler* componenthandler,
                                      IAutomation* automation, bool enablePolyPressure,
-                                     bool supportsTuningNoteExpression)
+                                     bool supportsTuningNoteExpression, bool useMIDIMapping,
+                                     bool use64bit)
 {
   _plugin = plugin;
   _ext_params = ext_params;
@@ -34,15 +37,29 @@ void ProcessAdapter::setupProcessing(const clap_plugin_t* plugin, const clap_plu
 
   if (numSamples > 0)
   {
+    _silent_frames = numSamples;
+
     delete[] _silent_input;
-    _silent_input = new float[numSamples];
+    _silent_input = new float[numSamples]();
 
     delete[] _silent_output;
-    _silent_output = new float[numSamples];
+    _silent_output = new float[numSamples]();
+
+    delete[] _silent_input64;
+    delete[] _silent_output64;
+    _silent_input64 = nullptr;
+    _silent_output64 = nullptr;
+    if (use64bit)
+    {
+      _silent_input64 = new double[numSamples]();
+      _silent_output64 = new double[numSamples]();
+    }
   }
 
   auto numInputs = (uint32_t)_audioinputs->size();
   auto numOutputs = (uint32_t)_audiooutputs->size();
+  uint32_t maxInputChannels = 0;
+  uint32_t maxOutputChannels = 0;
 
   _processData.audio_inputs_count = numInputs;
   delete[] _input_ports;
@@ -57,6 +74,7 @@ void ProcessAdapter::setupProcessing(const clap_plugin_t* plugin, const clap_plu
       Vst::BusInfo info;
       if (_audioinputs->at(i)->getInfo(info))
       {
+        maxInputChannels = std::max(maxInputChannels, (uint32_t)info.channelCount);
         bus.channel_count = info.channelCount;
         bus.constant_mask = 0;
         bus.latency = 0;
@@ -84,6 +102,7 @@ void ProcessAdapter::setupProcessing(const clap_plugin_t* plugin, const clap_plu
       Vst::BusInfo info;
       if (_audiooutputs->at(i)->getInfo(info))
       {
+        maxOutputChannels = std::max(maxOutputChannels, (uint32_t)info.channelCount);
         bus.channel_count = info.channelCount;
         bus.constant_mask = 0;
         bus.latency = 0;
@@ -98,10 +117,29 @@ void ProcessAdapter::setupProcessing(const clap_plugin_t* plugin, const clap_plu
     _processData.audio_outputs = nullptr;
   }
 
+  _silent_input_channels.assign(maxInputChannels, _silent_input);
+  _silent_output_channels.assign(maxOutputChannels, _silent_output);
+  _silent_input_channels64.assign(maxInputChannels, _silent_input64);
+  _silent_output_channels64.assign(maxOutputChannels, _silent_output64);
+  // the host usually activated the busses before, an unused sidechain stays inactive
+  _active_inputs = std::vector<std::atomic<bool>>(numInputs);
+  _active_outputs = std::vector<std::atomic<bool>>(numOutputs);
+  for (auto i = 0U; i < numInputs; ++i)
+  {
+    _active_inputs[i].store(_audioinputs->at(i)->isActive(), std::memory_order_relaxed);
+  }
+  for (auto i = 0U; i < numOutputs; ++i)
+  {
+    _active_outputs[i].store(_audiooutputs->at(i)->isActive(), std::memory_order_relaxed);
+  }
+
   _processData.in_events = &_in_events;
   _processData.out_events = &_out_events;
 
   _processData.transport = &_transport;
+  _hasLastContext = false;
+  _lastTempoSlope = 0;
+  _steadyTime = 0;
 
   _in_events.ctx = this;
   _in_events.size = input_events_size;
@@ -121,30 +159,74 @@ void ProcessAdapter::setupProcessing(const clap_plugin_t* plugin, const clap_plu
 
   _activeNotes.reserve(32);
 
-  _supportsPolyPressure = enablePolyPressure;
-  _supportsTuningNoteExpression = supportsTuningNoteExpression;
+  // the IMidiMapping parameters only exist if the wrapper created them
+  if (useMIDIMapping)
+  {
+    _processPipeline =
+        selectPipeline<true>(enablePolyPressure, supportsTuningNoteExpression, use64bit);
+  }
+  else
+  {
+    _processPipeline =
+        selectPipeline<false>(enablePolyPressure, supportsTuningNoteExpression, use64bit);
+  }
+}
+
+template <bool MIDIMAPPING>
+ProcessAdapter::process_pipeline_t ProcessAdapter::selectPipeline(bool polyPressure,
+                                                                  bool tuningNoteExpression,
+                                                                  bool use64bit)
+{
+  if (polyPressure)
+  {
+    return selectPipeline<MIDIMAPPING, true>(tuningNoteExpression, use64bit);
+  }
+  return selectPipeline<MIDIMAPPING, false>(tuningNoteExpression, use64bit);
+}
+
+template <bool MIDIMAPPING, bool POLYPRESSURE>
+ProcessAdapter::process_pipeline_t ProcessAdapter::selectPipeline(bool tuningNoteExpression,
+                                                                  bool use64bit)
+{
+  if (tuningNoteExpression)
+  {
+    return selectPipeline<MIDIMAPPING, POLYPRESSURE, true>(use64bit);
+  }
+  return selectPipeline<MIDIMAPPING, POLYPRESSURE, false>(use64bit);
+}
+
+template <bool MIDIMAPPING, bool POLYPRESSURE, bool TUNINGEXPRESSION>
+ProcessAdapter::process_pipeline_t ProcessAdapter::selectPipeline(bool use64bit)
+{
+  if (use64bit)
+  {
+    return &ProcessAdapter::processPipeline<MIDIMAPPING, POLYPRESSURE, TUNINGEXPRESSION, double>;
+  }
+  return &ProcessAdapter::processPipeline<MIDIMAPPING, POLYPRESSURE, TUNINGEXPRESSION, float>;
 }
 
 void ProcessAdapter::activateAudioBus(Steinberg::Vst::BusDirection dir, int32 index, TBool state)
 {
-  /*
-    if (dir == Vst::kInput)
-    {
-      auto& map = _bogus_buffers->_in_channelmap[index];
-      if (state)
-        _bogus_buffers->_active_mask_in |= map._bitmap;
-      else
-        _bogus_buffers->_active_mask_in &= ~map._bitmap;
-    }
-    if (dir == Vst::kOutput)
-    {
-      auto& map = _bogus_buffers->_out_channelmap[index];
-      if (state)
-        _bogus_buffers->_active_mask_out |= map._bitmap;
-      else
-        _bogus_buffers->_active_mask_out &= ~map._bitmap;
-    }
-    */
+  // a deactivated bus will be served with the silent buffers in process()
+  if (dir == Vst::kInput && index >= 0 && index < (int32)_active_inputs.size())
+  {
+    _active_inputs[index].store(state != 0, std::memory_order_relaxed);
+  }
+  if (dir == Vst::kOutput && index >= 0 && index < (int32)_active_outputs.size())
+  {
+    _active_outputs[index].store(state != 0, std::memory_order_relaxed);
+  }
+}
+
+bool ProcessAdapter::isAudioBusActive(Steinberg::Vst::BusDirection dir, int32 index) const
+{
+  const auto& flags = (dir == Vst::kInput) ? _active_inputs : _active_outputs;
+  return index >= 0 && index < (int32)flags.size() && flags[index].load(std::memory_order_relaxed);
+}
+
+inline uint64_t constantMaskFor(uint32_t channelCount)
+{
+  return (channelCount >= 64) ? ~0ULL : ((1ULL << channelCount) - 1);
 }
 
 inline clap_beattime doubleToBeatTime(double t)
@@ -170,242 +252,363 @@ void ProcessAdapter::flush()
   }
 }
 
-// this converts the ProcessContext data from VST to CLAP
 void ProcessAdapter::process(Steinberg::Vst::ProcessData& data)
 {
-  // remember the ProcessData pointer during process
-  _vstdata = &data;
+  ClapWrapper::detail::shared::AudioThreadSection audiothread("ProcessAdapter::process");
 
-  /// convert timing
+  (this->*_processPipeline)(data);
+}
+
+// this converts the ProcessContext data from VST to CLAP.
+// To keep the per block work low, the fields are only converted if their source values changed.
+void ProcessAdapter::processTransport()
+{
   _transport.header = {sizeof(_transport), 0, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_TRANSPORT, 0};
 
-  _transport.flags = 0;
-  if (_vstdata->processContext)
+  auto ctx = _vstdata->processContext;
+  if (!ctx)
+  {
+    _transport.flags = 0;
+    _hasLastContext = false;
+    _lastTempoSlope = 0;
+    _processData.steady_time = _steadyTime;
+    _steadyTime += _vstdata->numSamples;
+    return;
+  }
+
+  const auto& last = _lastContext;
+  const auto state = ctx->state;
+  const auto changedState = _hasLastContext ? (state ^ last.state) : ~0U;
+
+  if (changedState)
   {
     // converting the flags
-    _transport.flags |=
+    _transport.flags =
         0
         // kPlaying = 1 << 1,		///< currently playing
-        | ((_vstdata->processContext->state & Vst::ProcessContext::kPlaying) ? CLAP_TRANSPORT_IS_PLAYING
-                                                                             : 0)
+        | ((state & Vst::ProcessContext::kPlaying) ? CLAP_TRANSPORT_IS_PLAYING : 0)
         // kRecording = 1 << 3,		///< currently recording
-        | ((_vstdata->processContext->state & Vst::ProcessContext::kRecording)
-               ? CLAP_TRANSPORT_IS_RECORDING
-               : 0)
+        | ((state & Vst::ProcessContext::kRecording) ? CLAP_TRANSPORT_IS_RECORDING : 0)
         // kCycleActive = 1 << 2,		///< cycle is active
-        | ((_vstdata->processContext->state & Vst::ProcessContext::kCycleActive)
-               ? CLAP_TRANSPORT_IS_LOOP_ACTIVE
-               : 0)
+        | ((state & Vst::ProcessContext::kCycleActive) ? CLAP_TRANSPORT_IS_LOOP_ACTIVE : 0)
         // kTempoValid = 1 << 10,	///< tempo contains valid information
-        |
-        ((_vstdata->processContext->state & Vst::ProcessContext::kTempoValid) ? CLAP_TRANSPORT_HAS_TEMPO
-                                                                              : 0) |
-        ((_vstdata->processContext->state & Vst::ProcessContext::kBarPositionValid)
-             ? CLAP_TRANSPORT_HAS_BEATS_TIMELINE
-             : 0) |
-        ((_vstdata->processContext->state & Vst::ProcessContext::kTimeSigValid)
-             ? CLAP_TRANSPORT_HAS_TIME_SIGNATURE
-             : 0)
+        | ((state & Vst::ProcessContext::kTempoValid) ? CLAP_TRANSPORT_HAS_TEMPO : 0) |
+        ((state & Vst::ProcessContext::kBarPositionValid) ? CLAP_TRANSPORT_HAS_BEATS_TIMELINE : 0) |
+        ((state & Vst::ProcessContext::kTimeSigValid) ? CLAP_TRANSPORT_HAS_TIME_SIGNATURE : 0)
 
         // the rest of the flags has no meaning to CLAP
         // kSystemTimeValid = 1 << 8,		///< systemTime contains valid information
         // kContTimeValid = 1 << 17,	///< continousTimeSamples contains valid information
         //
         // kProjectTimeMusicValid = 1 << 9,///< projectTimeMusic contains valid information
-        // kBarPositionValid = 1 << 11,	///< barPositionMusic contains valid information
         // kCycleValid = 1 << 12,	///< cycleStartMusic and barPositionMusic contain valid information
         //
         // kClockValid = 1 << 15		///< samplesToNextClock valid
-        // kTimeSigValid = 1 << 13,	///< timeSigNumerator and timeSigDenominator contain valid information
         // kChordValid = 1 << 18,	///< chord contains valid information
         //
         // kSmpteValid = 1 << 14,	///< smpteOffset and frameRate contain valid information
         ;
+  }
 
-    _transport.song_pos_beats = 0;
-
-    // samplerate and projectTimeSamples are always valid
-    _transport.song_pos_seconds = doubleToSecTime(_vstdata->processContext->projectTimeSamples /
-                                                  _vstdata->processContext->sampleRate);
+  // samplerate and projectTimeSamples are always valid
+  if (!_hasLastContext || ctx->sampleRate != last.sampleRate)
+  {
+    _secTimePerSample = (ctx->sampleRate > 0) ? CLAP_SECTIME_FACTOR / ctx->sampleRate : 0;
+  }
+  _transport.song_pos_seconds = std::round(ctx->projectTimeSamples * _secTimePerSample);
 
-    if ((_vstdata->processContext->state & Vst::ProcessContext::kProjectTimeMusicValid))
-    {
-      _transport.song_pos_beats = doubleToBeatTime(_vstdata->processContext->projectTimeMusic);
-    }
+  if ((changedState & Vst::ProcessContext::kProjectTimeMusicValid) ||
+      ctx->projectTimeMusic != last.projectTimeMusic)
+  {
+    _transport.song_pos_beats = (state & Vst::ProcessContext::kProjectTimeMusicValid)
+                                    ? doubleToBeatTime(ctx->projectTimeMusic)
+                                    : 0;
+  }
 
-    _transport.tempo = 120;
-    _transport.tempo_inc = 0;
-    if ((_vstdata->processContext->state & Vst::ProcessContext::kTempoValid))
+  // VST3 does not report tempo ramps. A ramp is only assumed once the same slope held between
+  // three adjacent blocks, a single tempo step (e.g. a tempo marker) must not continue as a ramp.
+  _transport.tempo_inc = 0;
+  if ((changedState & Vst::ProcessContext::kTempoValid) || ctx->tempo != last.tempo)
+  {
+    _transport.tempo = (state & Vst::ProcessContext::kTempoValid) ? ctx->tempo : 120;
+  }
+  if ((state & Vst::ProcessContext::kTempoValid) && !(changedState & Vst::ProcessContext::kTempoValid) &&
+      _lastNumSamples > 0 && ctx->projectTimeSamples == last.projectTimeSamples + _lastNumSamples)
+  {
+    const double slope = (ctx->tempo - last.tempo) / _lastNumSamples;
+    if (slope != 0 && std::abs(slope - _lastTempoSlope) <= std::abs(slope) * 1e-6)
     {
-      _transport.tempo = _vstdata->processContext->tempo;
+      _transport.tempo_inc = slope;
     }
+    _lastTempoSlope = slope;
+  }
+  else
+  {
+    _lastTempoSlope = 0;
+  }
 
+  if ((changedState & Vst::ProcessContext::kCycleValid) ||
+      ctx->cycleStartMusic != last.cycleStartMusic || ctx->cycleEndMusic != last.cycleEndMusic)
+  {
     _transport.loop_start_beats = 0;
     _transport.loop_end_beats = 0;
     _transport.loop_start_seconds = 0;
     _transport.loop_end_seconds = 0;
 
-    if ((_vstdata->processContext->state & Vst::ProcessContext::kCycleValid))
+    if ((state & Vst::ProcessContext::kCycleValid))
     {
-      _transport.loop_start_beats = doubleToBeatTime(_vstdata->processContext->cycleStartMusic);
-      _transport.loop_end_beats = doubleToBeatTime(_vstdata->processContext->cycleEndMusic);
+      _transport.loop_start_beats = doubleToBeatTime(ctx->cycleStartMusic);
+      _transport.loop_end_beats = doubleToBeatTime(ctx->cycleEndMusic);
     }
+  }
 
+  bool changedTimeSignature = (changedState & Vst::ProcessContext::kTimeSigValid) ||
+                              ctx->timeSigNumerator != last.timeSigNumerator ||
+                              ctx->timeSigDenominator != last.timeSigDenominator;
+  if (changedTimeSignature)
+  {
     _transport.tsig_num = 4;
     _transport.tsig_denom = 4;
-    if ((_vstdata->processContext->state & Vst::ProcessContext::kTimeSigValid))
+    if ((state & Vst::ProcessContext::kTimeSigValid) && ctx->timeSigDenominator > 0)
     {
-      _transport.tsig_num = _vstdata->processContext->timeSigNumerator;
-      _transport.tsig_denom = _vstdata->processContext->timeSigDenominator;
+      _transport.tsig_num = ctx->timeSigNumerator;
+      _transport.tsig_denom = ctx->timeSigDenominator;
     }
+  }
 
+  if (changedTimeSignature || (changedState & Vst::ProcessContext::kBarPositionValid) ||
+      ctx->barPositionMusic != last.barPositionMusic)
+  {
     _transport.bar_start = 0;
     _transport.bar_number = 0;
-    if ((_vstdata->processContext->state & Vst::ProcessContext::kBarPositionValid))
+    if ((state & Vst::ProcessContext::kBarPositionValid))
     {
-      _transport.bar_start = _vstdata->processContext->barPositionMusic * CLAP_BEATTIME_FACTOR;
+      _transport.bar_start = doubleToBeatTime(ctx->barPositionMusic);
+
+      // VST3 only provides the bar start in quarter notes, the bar number is derived
+      // from the current time signature
+      double quartersPerBar = _transport.tsig_num * 4.0 / _transport.tsig_denom;
+      if (quartersPerBar > 0)
+      {
+        _transport.bar_number = (int32_t)std::floor(ctx->barPositionMusic / quartersPerBar + 0.5);
+      }
     }
-    _processData.steady_time = _vstdata->processContext->projectTimeSamples;
   }
 
-  // setting up transport
-  _processData.frames_count = _vstdata->numSamples;
+  // steady_time must not jump with the song position, without a continuous time from the host
+  // the samples processed by this adapter are counted instead
+  _processData.steady_time =
+      (state & Vst::ProcessContext::kContTimeValid) ? ctx->continousTimeSamples : _steadyTime;
+  _steadyTime += _vstdata->numSamples;
 
-  // always clear
-  _events.clear();
-  _eventindices.clear();
+  _lastContext = *ctx;
+  _lastNumSamples = _vstdata->numSamples;
+  _hasLastContext = true;
+}
 
-  processInputEvents(_vstdata->inputEvents);
+template <bool MIDIMAPPING>
+void ProcessAdapter::processInputParameterChanges(Steinberg::Vst::IParameterChanges* paramchanges)
+{
+  if (!paramchanges)
+  {
+    return;
+  }
 
-  if (_vstdata->inputParameterChanges)
+  auto numPevent = paramchanges->getParameterCount();
+  for (decltype(numPevent) i = 0; i < numPevent; ++i)
   {
-    auto numPevent = _vstdata->inputParameterChanges->getParameterCount();
-    for (decltype(numPevent) i = 0; i < numPevent; ++i)
-    {
-      auto k = _vstdata->inputParameterChanges->getParameterData(i);
+    auto k = paramchanges->getParameterData(i);
 
-      // get the Vst3Parameter
-      auto paramid = k->getParameterId();
+    // get the Vst3Parameter
+    auto paramid = k->getParameterId();
 
-      // if a parameter is currently edited by a user, we are not allowed to send this back to the CLAP.
-      // this is a fundamental difference between VST3 and CLAP
-      if (std::find(_gesturedParameters.begin(), _gesturedParameters.end(), paramid) !=
-          _gesturedParameters.end())
-      {
-        continue;
-      }
+    // if a parameter is currently edited by a user, we are not allowed to send this back to the CLAP.
+    // this is a fundamental difference between VST3 and CLAP
+    if (std::find(_gesturedParameters.begin(), _gesturedParameters.end(), paramid) !=
+        _gesturedParameters.end())
+    {
+      continue;
+    }
 
-      auto param = (Vst3Parameter*)parameters->getParameter(paramid);
-      if (param)
+    auto param = (Vst3Parameter*)parameters->getParameter(paramid);
+    if (param)
+    {
+      if (MIDIMAPPING && param->isMidi)
       {
-        if (param->isMidi)
-        {
-          auto nums = k->getPointCount();
+        auto nums = k->getPointCount();
 
-          Vst::ParamValue value;
-          int32 offset;
-          if (k->getPoint(nums - 1, offset, value) == kResultOk)
+        Vst::ParamValue value;
+        int32 offset;
+        if (k->getPoint(nums - 1, offset, value) == kResultOk)
+        {
+          // create MIDI event
+          clap_multi_event_t n;
+          n.param.header.type = CLAP_EVENT_MIDI;
+          n.param.header.flags = 0;
+          n.param.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+          n.param.header.time = offset;
+          n.param.header.size = sizeof(clap_event_midi_t);
+          n.midi.port_index = 0;
+
+          switch (param->controller)
           {
-            // create MIDI event
-            clap_multi_event_t n;
-            n.param.header.type = CLAP_EVENT_MIDI;
-            n.param.header.flags = 0;
-            n.param.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-            n.param.header.time = offset;
-            n.param.header.size = sizeof(clap_event_midi_t);
-            n.midi.port_index = 0;
-
-            switch (param->controller)
-            {
-              case Vst::ControllerNumbers::kAfterTouch:
-                n.midi.data[0] = 0xD0 | param->channel;
-                n.midi.data[1] = param->asClapValue(value);
-                n.midi.data[2] = 0;
-                break;
-              case Vst::ControllerNumbers::kPitchBend:
-              {
-                auto val = (uint16_t)param->asClapValue(value);
-                n.midi.data[0] = 0xE0 | param->channel;  // $Ec
-                n.midi.data[1] = (val & 0x7F);           // LSB
-                n.midi.data[2] = (val >> 7) & 0x7F;      // MSB
-              }
+            case Vst::ControllerNumbers::kAfterTouch:
+              n.midi.data[0] = 0xD0 | param->channel;
+              n.midi.data[1] = param->asClapValue(value);
+              n.midi.data[2] = 0;
               break;
-              case Vst::ControllerNumbers::kCtrlProgramChange:
-              {
-                auto val = (uint16_t)param->asClapValue(value);
-                n.midi.data[0] = 0xC0 | param->channel;  // $Cc
-                n.midi.data[1] = (val & 0x7F);           // only one byte
-                n.midi.data[2] = 0;
-              }
-              break;
-              default:
-                n.midi.data[0] = 0xB0 | param->channel;
-                n.midi.data[1] = param->controller;
-                n.midi.data[2] = param->asClapValue(value);
-                break;
+            case Vst::ControllerNumbers::kPitchBend:
+            {
+              auto val = (uint16_t)param->asClapValue(value);
+              n.midi.data[0] = 0xE0 | param->channel;  // $Ec
+              n.midi.data[1] = (val & 0x7F);           // LSB
+              n.midi.data[2] = (val >> 7) & 0x7F;      // MSB
             }
-
-            _eventindices.push_back(_events.size());
-            _events.push_back(n);
+            break;
+            case Vst::ControllerNumbers::kCtrlProgramChange:
+            {
+              auto val = (uint16_t)param->asClapValue(value);
+              n.midi.data[0] = 0xC0 | param->channel;  // $Cc
+              n.midi.data[1] = (val & 0x7F);           // only one byte
+              n.midi.data[2] = 0;
+            }
+            break;
+            default:
+              n.midi.data[0] = 0xB0 | param->channel;
+              n.midi.data[1] = param->controller;
+              n.midi.data[2] = param->asClapValue(value);
+              break;
           }
+
+          _eventindices.push_back(_events.size());
+          _events.push_back(n);
         }
-        else
-        {
-          auto nums = k->getPointCount();
+      }
+      else
+      {
+        auto nums = k->getPointCount();
 
-          Vst::ParamValue value;
-          int32 offset;
-          if (k->getPoint(nums - 1, offset, value) == kResultOk)
-          {
-            clap_multi_event_t n;
-            n.param.header.type = CLAP_EVENT_PARAM_VALUE;
-            n.param.header.flags = 0;
-            n.param.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-            n.param.header.time = offset;
-            n.param.header.size = sizeof(clap_event_param_value);
-            n.param.param_id = param->id;
-            n.param.cookie = param->cookie;
-
-            // nothing note specific
-            n.param.note_id = -1;  // always global
-            n.param.port_index = -1;
-            n.param.channel = -1;
-            n.param.key = -1;
-
-            n.param.value = param->asClapValue(value);
-            _eventindices.push_back(_events.size());
-            _events.push_back(n);
-          }
+        Vst::ParamValue value;
+        int32 offset;
+        if (k->getPoint(nums - 1, offset, value) == kResultOk)
+        {
+          clap_multi_event_t n;
+          n.param.header.type = CLAP_EVENT_PARAM_VALUE;
+          n.param.header.flags = 0;
+          n.param.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+          n.param.header.time = offset;
+          n.param.header.size = sizeof(clap_event_param_value);
+          n.param.param_id = param->id;
+          n.param.cookie = param->cookie;
+
+          // nothing note specific
+          n.param.note_id = -1;  // always global
+          n.param.port_index = -1;
+          n.param.channel = -1;
+          n.param.key = -1;
+
+          n.param.value = param->asClapValue(value);
+          _eventindices.push_back(_events.size());
+          _events.push_back(n);
         }
       }
     }
   }
+}
 
-  sortEventIndices();
+template <typename SampleType>
+bool ProcessAdapter::assignAudioBuffers()
+{
+  constexpr bool is64bit = std::is_same_v<SampleType, double>;
 
-  bool doProcess = true;
+  // the silent buffers are sized to the maximum block size from setupProcessing()
+  bool canSubstitute = ((uint32_t)_vstdata->numSamples <= _silent_frames);
+  bool complete = true;
 
-  if (_vstdata->numSamples > 0)
+  // setting the buffers
+  auto inbusses = _audioinputs->size();
+  for (auto i = 0U; i < inbusses; ++i)
   {
-    // setting the buffers
-    auto inbusses = _audioinputs->size();
-    for (auto i = 0U; i < inbusses; ++i)
+    // the host may provide less busses than declared if the last busses are deactivated
+    // and some hosts provide busses with no channels at all (e.g. an unused sidechain).
+    // In all those cases the plugin gets silence, so it can still render.
+    if (!_active_inputs[i].load(std::memory_order_relaxed) || (int32)i >= _vstdata->numInputs ||
+        _vstdata->inputs[i].numChannels == 0)
     {
-      if (_vstdata->inputs[i].numChannels > 0)
-        _input_ports[i].data32 = _vstdata->inputs[i].channelBuffers32;
+      if (!canSubstitute)
+      {
+        complete = false;
+        continue;
+      }
+      if constexpr (is64bit)
+        _input_ports[i].data64 = _silent_input_channels64.data();
       else
-        doProcess = false;
+        _input_ports[i].data32 = _silent_input_channels.data();
+      _input_ports[i].constant_mask = constantMaskFor(_input_ports[i].channel_count);
+      continue;
     }
+    _input_ports[i].constant_mask = 0;
+    if constexpr (is64bit)
+      _input_ports[i].data64 = _vstdata->inputs[i].channelBuffers64;
+    else
+      _input_ports[i].data32 = _vstdata->inputs[i].channelBuffers32;
+  }
 
-    auto outbusses = _audiooutputs->size();
-    for (auto i = 0U; i < outbusses; ++i)
+  auto outbusses = _audiooutputs->size();
+  for (auto i = 0U; i < outbusses; ++i)
+  {
+    if (!_active_outputs[i].load(std::memory_order_relaxed) || (int32)i >= _vstdata->numOutputs ||
+        _vstdata->outputs[i].numChannels == 0)
     {
-      if (_vstdata->outputs[i].numChannels > 0)
-        _output_ports[i].data32 = _vstdata->outputs[i].channelBuffers32;
+      if (!canSubstitute)
+      {
+        complete = false;
+        continue;
+      }
+      // the plugin may render into the silent output, nobody will listen to it
+      if constexpr (is64bit)
+        _output_ports[i].data64 = _silent_output_channels64.data();
       else
-        doProcess = false;
+        _output_ports[i].data32 = _silent_output_channels.data();
+      _output_ports[i].constant_mask = constantMaskFor(_output_ports[i].channel_count);
+      if ((int32)i < _vstdata->numOutputs)
+      {
+        _vstdata->outputs[i].silenceFlags = constantMaskFor(_vstdata->outputs[i].numChannels);
+      }
+      continue;
     }
-    if (doProcess)
+    _output_ports[i].constant_mask = 0;
+    if constexpr (is64bit)
+      _output_ports[i].data64 = _vstdata->outputs[i].channelBuffers64;
+    else
+      _output_ports[i].data32 = _vstdata->outputs[i].channelBuffers32;
+  }
+  return complete;
+}
+
+template <bool MIDIMAPPING, bool POLYPRESSURE, bool TUNINGEXPRESSION, typename SampleType>
+void ProcessAdapter::processPipeline(Steinberg::Vst::ProcessData& data)
+{
+  // remember the ProcessData pointer during process
+  _vstdata = &data;
+
+  processTransport();
+
+  // setting up transport
+  _processData.frames_count = _vstdata->numSamples;
+
+  // always clear
+  _events.clear();
+  _eventindices.clear();
+
+  processInputEvents<POLYPRESSURE, TUNINGEXPRESSION>(_vstdata->inputEvents);
+  processInputParameterChanges<MIDIMAPPING>(_vstdata->inputParameterChanges);
+
+  sortEventIndices();
+
+  if (_vstdata->numSamples > 0)
+  {
+    if (assignAudioBuffers<SampleType>())
       _plugin->process(_plugin, &_processData);
     else
     {
@@ -485,6 +688,7 @@ void ProcessAdapter::sortEventIndices()
             });
 }
 
+template <bool POLYPRESSURE, bool TUNINGEXPRESSION>
 void ProcessAdapter::processInputEvents(Steinberg::Vst::IEventList* eventlist)
 {
   if (eventlist)
@@ -514,7 +718,7 @@ void ProcessAdapter::processInputEvents(Steinberg::Vst::IEventList* eventlist)
 
           // CLAP doesn't support note-on retuning but does support note expressions so
           // convert but only if your target clap supports note expressions
-          if (_supportsTuningNoteExpression && vstevent.noteOn.tuning != 0)
+          if (TUNINGEXPRESSION && vstevent.noteOn.tuning != 0)
           {
             clap_multi_event_t n;
             n.noteexpression.header.type = CLAP_EVENT_NOTE_EXPRESSION;
@@ -574,7 +778,7 @@ void ProcessAdapter::processInputEvents(Steinberg::Vst::IEventList* eventlist)
             // there are no other event types yet
           }
         }
-        if (_supportsPolyPressure && vstevent.type == Vst::Event::kPolyPressureEvent)
+        if (POLYPRESSURE && vstevent.type == Vst::Event::kPolyPressureEvent)
         {
           clap_multi_event_t n;
           n.noteexpression.header.type = CLAP_EVENT_NOTE_EXPRESSION;
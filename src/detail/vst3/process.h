@@ -31,6 +31,7 @@
 
 #include <vector>
 #include <memory>
+#include <atomic>
 
 #include "../clap/automation.h"
 
@@ -69,12 +70,15 @@ class ProcessAdapter
                        uint32_t numSamples, size_t numEventInputs, size_t numEventOutputs,
                        Steinberg::Vst::ParameterContainer& params,
                        Steinberg::Vst::IComponentHandler* componenthandler, IAutomation* automation,
-                       bool enablePolyPressure, bool supportsTuningNoteExpression);
+                       bool enablePolyPressure, bool supportsTuningNoteExpression,
+                       bool useMIDIMapping = false, bool use64bit = false);
   void process(Steinberg::Vst::ProcessData& data);
   void flush();
   void processOutputParams(Steinberg::Vst::ProcessData& data);
   void activateAudioBus(Steinberg::Vst::BusDirection dir, Steinberg::int32 index,
                         Steinberg::TBool state);
+  // safe to call from the audio thread, unlike Bus::isActive()
+  bool isAudioBusActive(Steinberg::Vst::BusDirection dir, Steinberg::int32 index) const;
 
   // C callbacks
   static uint32_t input_events_size(const struct clap_input_events* list);
@@ -85,8 +89,29 @@ class ProcessAdapter
                                      const clap_event_header_t* event);
 
  private:
-  void sortEventIndices();
+  // the process pipeline is specialized at compile time for the features the plugin uses,
+  // setupProcessing() picks the matching instance so the event loops don't test these per event
+  using process_pipeline_t = void (ProcessAdapter::*)(Steinberg::Vst::ProcessData& data);
+
+  template <bool MIDIMAPPING>
+  static process_pipeline_t selectPipeline(bool polyPressure, bool tuningNoteExpression, bool use64bit);
+  template <bool MIDIMAPPING, bool POLYPRESSURE>
+  static process_pipeline_t selectPipeline(bool tuningNoteExpression, bool use64bit);
+  template <bool MIDIMAPPING, bool POLYPRESSURE, bool TUNINGEXPRESSION>
+  static process_pipeline_t selectPipeline(bool use64bit);
+
+  template <bool MIDIMAPPING, bool POLYPRESSURE, bool TUNINGEXPRESSION, typename SampleType>
+  void processPipeline(Steinberg::Vst::ProcessData& data);
+
+  void processTransport();
+  template <bool MIDIMAPPING>
+  void processInputParameterChanges(Steinberg::Vst::IParameterChanges* paramchanges);
+  template <bool POLYPRESSURE, bool TUNINGEXPRESSION>
   void processInputEvents(Steinberg::Vst::IEventList* eventlist);
+  template <typename SampleType>
+  bool assignAudioBuffers();
+
+  void sortEventIndices();
 
   bool enqueueOutputEvent(const clap_event_header_t* event);
   void addToActiveNotes(const clap_event_note* note);
@@ -119,11 +144,31 @@ class ProcessAdapter
   clap_audio_buffer_t* _input_ports = nullptr;
   clap_audio_buffer_t* _output_ports = nullptr;
   clap_event_transport_t _transport = {};
+
+  // the ProcessContext of the last block, the transport is only converted where it differs
+  Steinberg::Vst::ProcessContext _lastContext = {};
+  Steinberg::int32 _lastNumSamples = 0;
+  bool _hasLastContext = false;
+  double _lastTempoSlope = 0;  // tempo change per sample between the two last adjacent blocks
+  int64_t _steadyTime = 0;     // used as steady_time if the host provides no continuous time
+  double _secTimePerSample = 0;
   clap_input_events_t _in_events = {};
   clap_output_events_t _out_events = {};
 
   float* _silent_input = nullptr;
   float* _silent_output = nullptr;
+  double* _silent_input64 = nullptr;
+  double* _silent_output64 = nullptr;
+  uint32_t _silent_frames = 0;
+
+  // deactivated busses get these channel arrays, all channels point to the silent buffers
+  std::vector<float*> _silent_input_channels;
+  std::vector<float*> _silent_output_channels;
+  std::vector<double*> _silent_input_channels64;
+  std::vector<double*> _silent_output_channels64;
+  // written by activateBus() on the main thread while process() might read them
+  std::vector<std::atomic<bool>> _active_inputs;
+  std::vector<std::atomic<bool>> _active_outputs;
 
   clap_process_t _processData = {-1, 0, &_transport, nullptr, nullptr, 0, 0, &_in_events, &_out_events};
 
@@ -132,8 +177,7 @@ class ProcessAdapter
   std::vector<clap_multi_event_t> _events;
   std::vector<size_t> _eventindices;
 
-  bool _supportsPolyPressure = false;
-  bool _supportsTuningNoteExpression = false;
+  process_pipeline_t _processPipeline = nullptr;
 };
 
 }  // namespace Clap
@@ -0,0 +1,150 @@
+#include "runloop_dispatcher.h"
+
+#include <algorithm>
+#include <chrono>
+
+struct RunLoopTick : Steinberg::Linux::ITimerHandler, public Steinberg::FObject
+{
+  RunLoopDispatcher* _parent{nullptr};
+  RunLoopTick(RunLoopDispatcher* parent) : _parent(parent)
+  {
+  }
+  void PLUGIN_API onTimer() final
+  {
+    if (_parent) _parent->dispatch();
+  }
+  DELEGATE_REFCOUNT(Steinberg::FObject)
+  DEFINE_INTERFACES
+  DEF_INTERFACE(Steinberg::Linux::ITimerHandler)
+  END_DEFINE_INTERFACES(Steinberg::FObject)
+};
+
+// the entry due first is on the top
+bool RunLoopDispatcher::dueLater(const Entry& a, const Entry& b)
+{
+  return a.due > b.due;
+}
+
+std::shared_ptr<RunLoopDispatcher> RunLoopDispatcher::forRunLoop(Steinberg::Linux::IRunLoop* runLoop)
+{
+  // hosts have a single run loop as a rule, a dispatcher lives as long as an instance uses it
+  static std::map<Steinberg::Linux::IRunLoop*, std::weak_ptr<RunLoopDispatcher>> dispatchers;
+  for (auto it = dispatchers.begin(); it != dispatchers.end();)
+  {
+    it = it->second.expired() ? dispatchers.erase(it) : std::next(it);
+  }
+  if (!runLoop)
+  {
+    return nullptr;
+  }
+  auto& slot = dispatchers[runLoop];
+  auto dispatcher = slot.lock();
+  if (!dispatcher)
+  {
+    dispatcher = std::make_shared<RunLoopDispatcher>(runLoop);
+    slot = dispatcher;
+  }
+  return dispatcher;
+}
+
+RunLoopDispatcher::RunLoopDispatcher(Steinberg::Linux::IRunLoop* runLoop) : _runLoop(runLoop)
+{
+  _tick = Steinberg::owned(new RunLoopTick(this));
+  _runLoop->registerTimer(_tick.get(), tickMs);
+}
+
+RunLoopDispatcher::~RunLoopDispatcher()
+{
+  // the host may still hold the handler, it must not call back into a dispatcher that is gone
+  static_cast<RunLoopTick*>(_tick.get())->_parent = nullptr;
+  _runLoop->unregisterTimer(_tick.get());
+}
+
+uint64_t RunLoopDispatcher::now()
+{
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void RunLoopDispatcher::schedule(Client* client, clap_id id, uint32_t period)
+{
+  // a new entry replaces the one with the same key, which is dropped when it comes up
+  Entry e{now() + period, ++_serial, client, id, std::max(period, tickMs)};
+  _current[{client, id}] = e.serial;
+  _heap.push_back(e);
+  std::push_heap(_heap.begin(), _heap.end(), dueLater);
+}
+
+void RunLoopDispatcher::attach(Client* client)
+{
+  schedule(client, idleId, idleMs);
+}
+
+void RunLoopDispatcher::detach(Client* client)
+{
+  auto it = _current.lower_bound({client, 0});
+  while (it != _current.end() && it->first.first == client)
+  {
+    it = _current.erase(it);
+  }
+}
+
+void RunLoopDispatcher::addTimer(Client* client, clap_id timer_id, uint32_t period_ms)
+{
+  schedule(client, timer_id, period_ms);
+}
+
+void RunLoopDispatcher::removeTimer(Client* client, clap_id timer_id)
+{
+  _current.erase({client, timer_id});
+}
+
+void RunLoopDispatcher::dispatch()
+{
+  // a client may let go of the dispatcher in its callback
+  auto self = shared_from_this();
+
+  auto t = now();
+  while (!_heap.empty() && _heap.front().due <= t)
+  {
+    std::pop_heap(_heap.begin(), _heap.end(), dueLater);
+    auto e = _heap.back();
+    _heap.pop_back();
+
+    auto it = _current.find({e.client, e.id});
+    if (it == _current.end() || it->second != e.serial)
+    {
+      continue;
+    }
+
+    // rescheduled before the callback, which may remove or replace it. A timer which is
+    // late skips the periods it missed.
+    e.due = e.due + e.period > t ? e.due + e.period : t + e.period;
+    e.serial = ++_serial;
+    it->second = e.serial;
+    _heap.push_back(e);
+    std::push_heap(_heap.begin(), _heap.end(), dueLater);
+
+    if (e.id == idleId)
+    {
+      if (e.client->hasIdleWork()) e.client->onIdle();
+    }
+    else
+    {
+      e.client->fireTimer(e.id);
+    }
+  }
+
+  // entries removed long before they come up would otherwise pile up
+  if (_heap.size() > 64 && _heap.size() > 4 * _current.size())
+  {
+    _heap.erase(std::remove_if(_heap.begin(), _heap.end(),
+                               [this](const Entry& e)
+                               {
+                                 auto it = _current.find({e.client, e.id});
+                                 return it == _current.end() || it->second != e.serial;
+                               }),
+                _heap.end());
+    std::make_heap(_heap.begin(), _heap.end(), dueLater);
+  }
+}
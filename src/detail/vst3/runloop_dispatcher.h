@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+    The timers of all wrapped plugins of this module on the Linux run loop of the host.
+
+    Instead of an idle timer and a timer per CLAP timer for every instance, the instances
+    which have a run loop share a single host timer per run loop. Each tick pops the due
+    entries of a min-heap of CLAP timers and idle checks. An instance is only called when
+    one of its timers is due or when it actually has idle work. A timer which couldn't keep
+    up skips the ticks it missed rather than firing several times in a row.
+*/
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "base/source/fobject.h"
+#include <pluginterfaces/gui/iplugview.h>
+#include <clap/clap.h>
+
+class RunLoopDispatcher : public std::enable_shared_from_this<RunLoopDispatcher>
+{
+ public:
+  class Client
+  {
+   public:
+    virtual ~Client() = default;
+    // called on every idle check, has to be cheap
+    virtual bool hasIdleWork() = 0;
+    virtual void onIdle() = 0;
+    virtual void fireTimer(clap_id timer_id) = 0;
+  };
+
+  // main thread. The dispatcher of the run loop, which registers its timer on the first use
+  // and unregisters it once the last client let go.
+  static std::shared_ptr<RunLoopDispatcher> forRunLoop(Steinberg::Linux::IRunLoop* runLoop);
+
+  explicit RunLoopDispatcher(Steinberg::Linux::IRunLoop* runLoop);
+  ~RunLoopDispatcher();
+  RunLoopDispatcher(const RunLoopDispatcher&) = delete;
+  RunLoopDispatcher& operator=(const RunLoopDispatcher&) = delete;
+
+  // main thread, also from within the callbacks of the clients
+  void attach(Client* client);
+  void detach(Client* client);
+  void addTimer(Client* client, clap_id timer_id, uint32_t period_ms);
+  void removeTimer(Client* client, clap_id timer_id);
+
+  // the period of the host timer, which limits the rate of any timer
+  static constexpr uint32_t tickMs{10};
+  // how often an instance is asked for idle work
+  static constexpr uint32_t idleMs{30};
+
+ private:
+  struct Entry
+  {
+    uint64_t due{0};
+    // an entry is current while it has the serial its key maps to
+    uint64_t serial{0};
+    Client* client{nullptr};
+    clap_id id{CLAP_INVALID_ID};
+    uint32_t period{0};
+  };
+  // idle checks use the invalid id, the timers of the wrapper start at 1000
+  static constexpr clap_id idleId{CLAP_INVALID_ID};
+
+  static bool dueLater(const Entry& a, const Entry& b);
+  void schedule(Client* client, clap_id id, uint32_t period);
+  void dispatch();
+  static uint64_t now();
+
+  Steinberg::IPtr<Steinberg::Linux::IRunLoop> _runLoop;
+  Steinberg::IPtr<Steinberg::Linux::ITimerHandler> _tick;
+  std::vector<Entry> _heap;
+  std::map<std::pair<Client*, clap_id>, uint64_t> _current;
+  uint64_t _serial{0};
+
+  friend struct RunLoopTick;
+};
@@ -61,22 +61,32 @@ bool WrapAsAUV2::initializeClapDesc()
                 << std::endl;
     }
 
-    auto csp = Clap::getValidCLAPSearchPaths();
-    auto it = std::find_if(csp.begin(), csp.end(),
-                           [this](const auto& cs)
-                           {
-                             auto fp = cs / (_clapname + ".clap");
-                             return fs::is_directory(fp) && _library.load(fp);
-                           });
-
-    if (it != csp.end())
+    // the search paths are only walked if the cached location is gone or has changed
+    auto cached = Clap::lookupDiscoveryCache(_clapname + ".clap");
+    if (cached && _library.load(*cached))
     {
-      std::cout << "[clap-wrapper] auv2 loaded clap from " << it->u8string() << std::endl;
+      std::cout << "[clap-wrapper] auv2 loaded clap from " << cached->u8string() << std::endl;
     }
     else
     {
-      std::cout << "[ERROR] cannot load clap" << std::endl;
-      return false;
+      auto csp = Clap::getValidCLAPSearchPaths();
+      auto it = std::find_if(csp.begin(), csp.end(),
+                             [this](const auto& cs)
+                             {
+                               auto fp = cs / (_clapname + ".clap");
+                               return fs::is_directory(fp) && _library.load(fp);
+                             });
+
+      if (it != csp.end())
+      {
+        std::cout << "[clap-wrapper] auv2 loaded clap from " << it->u8string() << std::endl;
+        Clap::storeDiscoveryCache(_clapname + ".clap", *it / (_clapname + ".clap"));
+      }
+      else
+      {
+        std::cout << "[ERROR] cannot load clap" << std::endl;
+        return false;
+      }
     }
   }
 
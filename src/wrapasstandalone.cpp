@@ -22,32 +22,56 @@ int main(int argc, char **argv)
   std::string clapName{HOSTED_CLAP_NAME};
   LOG << "Loading " << clapName << std::endl;
 
-  auto pts = Clap::getValidCLAPSearchPaths();
-
   auto lib = Clap::Library();
 
-  for (const auto &searchPaths : pts)
+  // the search paths are only walked if the cached location is gone or has changed
+  auto cached = Clap::lookupDiscoveryCache(clapName + ".clap");
+  if (cached && lib.load(*cached))
+  {
+    entry = lib._pluginEntry;
+  }
+
+  if (!entry)
   {
-    auto clapPath = searchPaths / (clapName + ".clap");
+    auto pts = Clap::getValidCLAPSearchPaths();
 
-    if (fs::exists(clapPath) && !entry)
+    for (const auto &searchPaths : pts)
     {
-      lib.load(clapPath);
-      entry = lib._pluginEntry;
+      auto clapPath = searchPaths / (clapName + ".clap");
+
+      if (fs::exists(clapPath) && !entry)
+      {
+        lib.load(clapPath);
+        entry = lib._pluginEntry;
+        if (entry) Clap::storeDiscoveryCache(clapName + ".clap", clapPath);
+      }
     }
   }
 
 #endif
 
+  // an offline render runs headless, so it is handled before the UI toolkit sees the arguments
+  freeaudio::clap_wrapper::standalone::RenderSettings renderSettings;
+  auto renderCommandLine =
+      freeaudio::clap_wrapper::standalone::parseRenderCommandLine(argc, argv, renderSettings);
+  if (renderCommandLine == freeaudio::clap_wrapper::standalone::RenderCommandLine::Invalid)
+  {
+    return 1;
+  }
+  bool render = renderCommandLine != freeaudio::clap_wrapper::standalone::RenderCommandLine::NoRender;
+
 #if LIN
 #if CLAP_WRAPPER_HAS_GTK3
   freeaudio::clap_wrapper::standalone::linux_standalone::GtkGui gtkGui{};
 
-  if (!gtkGui.parseCommandLine(argc, argv))
+  if (!render)
   {
-    return 1;
+    if (!gtkGui.parseCommandLine(argc, argv))
+    {
+      return 1;
+    }
+    gtkGui.initialize(freeaudio::clap_wrapper::standalone::getStandaloneHost());
   }
-  gtkGui.initialize(freeaudio::clap_wrapper::standalone::getStandaloneHost());
 #endif
 #endif
 
@@ -60,6 +84,17 @@ int main(int argc, char **argv)
   std::string pid{PLUGIN_ID};
   int pindex{PLUGIN_INDEX};
 
+  if (render)
+  {
+    // a render starts from the plugin defaults or --state and leaves the saved settings alone
+    auto plugin = freeaudio::clap_wrapper::standalone::mainCreatePlugin(entry, pid, pindex, 1,
+                                                                       (char **)argv, false);
+    auto res = plugin ? freeaudio::clap_wrapper::standalone::mainRender(renderSettings) : 3;
+    plugin = nullptr;
+    freeaudio::clap_wrapper::standalone::mainFinish(false);
+    return res;
+  }
+
   auto plugin =
       freeaudio::clap_wrapper::standalone::mainCreatePlugin(entry, pid, pindex, 1, (char **)argv);
   freeaudio::clap_wrapper::standalone::mainStartAudio();
@@ -9,6 +9,8 @@
 #include "detail/vst3/process.h"
 #include "detail/vst3/parameter.h"
 #include "detail/clap/fsutil.h"
+#include "detail/shared/audiothread_guard.h"
+#include "detail/shared/denormals.h"
 #include <locale>
 #include <sstream>
 
@@ -62,6 +64,10 @@ tresult PLUGIN_API ClapAsVst3::terminate()
 {
   clearContextMenu();
   vst3HostApplication.reset();
+#if LIN
+  // the plugin is gone after this, so nothing may be dispatched to it any more
+  detachTimers(_iRunLoop);
+#endif
 
   if (_plugin)
   {
@@ -83,6 +89,15 @@ tresult PLUGIN_API ClapAsVst3::setActive(TBool state)
   if (state)
   {
     if (_active) return kResultFalse;
+
+    // bus activations that happened while inactive or could not be applied while processing
+    if (_requestedAudioPortsActivation)
+    {
+      _requestedAudioPortsActivation = false;
+      syncAudioPortsActivation();
+    }
+    _canActivateAudioPortsWhileProcessing = _plugin->canActivateAudioPortsWhileProcessing();
+
     if (!_plugin->activate()) return kResultFalse;
     _active = true;
     _processAdapter = new Clap::ProcessAdapter();
@@ -96,7 +111,8 @@ tresult PLUGIN_API ClapAsVst3::setActive(TBool state)
         _plugin->_plugin, _plugin->_ext._params, this->audioInputs, this->audioOutputs,
         this->_largestBlocksize, this->eventInputs.size(), this->eventOutputs.size(), parameters,
         componentHandler, this, supportsnoteexpression,
-        _expressionmap & clap_supported_note_expressions::AS_VST3_NOTE_EXPRESSION_TUNING);
+        _expressionmap & clap_supported_note_expressions::AS_VST3_NOTE_EXPRESSION_TUNING,
+        _useIMidiMapping, _use64bit);
     updateAudioBusses();
 
     if (_missedLatencyRequest)
@@ -123,23 +139,42 @@ tresult PLUGIN_API ClapAsVst3::setActive(TBool state)
 
 tresult PLUGIN_API ClapAsVst3::process(Vst::ProcessData& data)
 {
+  ClapWrapper::detail::shared::AudioThreadSection audiothread("ClapAsVst3::process");
+  // the host's thread, so the flags are restored once the block is done
+  ClapWrapper::detail::shared::ScopedFlushDenormals denormals;
+
   if (!_active || !_processing)
   {
     return kNotInitialized;
   }
   auto thisFn = _plugin->AlwaysAudioThread();
 
+  if (_requestedAudioPortsActivation && _canActivateAudioPortsWhileProcessing)
+  {
+    _requestedAudioPortsActivation = false;
+    syncAudioPortsActivation();
+  }
+
   this->_processAdapter->process(data);
   return kResultOk;
 }
 
 tresult PLUGIN_API ClapAsVst3::canProcessSampleSize(int32 symbolicSampleSize)
 {
-  if (symbolicSampleSize != Steinberg::Vst::kSample32)
+  if (symbolicSampleSize == Steinberg::Vst::kSample32)
   {
-    return kResultFalse;
+    return kResultOk;
   }
-  return kResultOk;
+  if (symbolicSampleSize == Steinberg::Vst::kSample64 && _supports64bit)
+  {
+    return kResultOk;
+  }
+  return kResultFalse;
+}
+
+uint32 PLUGIN_API ClapAsVst3::getProcessContextRequirements()
+{
+  return _processContextRequirements;
 }
 
 tresult PLUGIN_API ClapAsVst3::setState(IBStream* state)
@@ -187,10 +222,12 @@ uint32 PLUGIN_API ClapAsVst3::getTailSamples()
 
 tresult PLUGIN_API ClapAsVst3::setupProcessing(Vst::ProcessSetup& newSetup)
 {
-  if (newSetup.symbolicSampleSize != Vst::kSample32)
+  if (canProcessSampleSize(newSetup.symbolicSampleSize) != kResultOk)
   {
     return kResultFalse;
   }
+  _use64bit = (newSetup.symbolicSampleSize == Vst::kSample64);
+
   if (_plugin->_ext._render)
   {
     if (_plugin->_ext._render->has_hard_realtime_requirement(_plugin->_plugin) &&
@@ -346,7 +383,29 @@ tresult PLUGIN_API ClapAsVst3::getParamValueByString(Vst::ParamID id, Vst::TChar
 tresult PLUGIN_API ClapAsVst3::activateBus(Vst::MediaType type, Vst::BusDirection dir, int32 index,
                                            TBool state)
 {
-  return super::activateBus(type, dir, index, state);
+  auto result = super::activateBus(type, dir, index, state);
+  if (result == kResultOk && type == Vst::kAudio)
+  {
+    if (_processAdapter)
+    {
+      _processAdapter->activateAudioBus(dir, index, state);
+    }
+
+    if (_plugin->_ext._audioportsactivation)
+    {
+      if (!_active)
+      {
+        // while inactive the plugin can be informed right away on the main thread
+        _plugin->setAudioPortActive(dir == Vst::kInput, index, state, _use64bit ? 64 : 32);
+      }
+      else
+      {
+        // otherwise this happens in process() if the plugin can handle it or on the next activation
+        _requestedAudioPortsActivation = true;
+      }
+    }
+  }
+  return result;
 }
 
 tresult PLUGIN_API ClapAsVst3::setIoMode(Vst::IoMode mode)
@@ -540,7 +599,8 @@ void ClapAsVst3::addAudioBusFrom(const clap_audio_port_info_t* info, bool is_inp
 {
   auto spk = speakerArrFromPortType(info->port_type);
   auto bustype = (info->flags & CLAP_AUDIO_PORT_IS_MAIN) ? Vst::BusTypes::kMain : Vst::BusTypes::kAux;
-  // bool supports64bit = (info->flags & CLAP_AUDIO_PORT_SUPPORTS_64BITS);
+  // 64 bit processing is only offered if all ports support it
+  _supports64bit = _supports64bit && (info->flags & CLAP_AUDIO_PORT_SUPPORTS_64BITS);
   Steinberg::char16 name16[256];
   // str8tostr16 writes to position n to terminate, so don't overflow
   Steinberg::str8ToStr16(&name16[0], info->name, 255);
@@ -591,6 +651,24 @@ void ClapAsVst3::updateAudioBusses()
   }
 }
 
+// [active ? audio-thread : main-thread]
+void ClapAsVst3::syncAudioPortsActivation()
+{
+  // the busses are written on the main thread, while active the adapter holds their state atomically
+  for (auto i = 0U; i < audioInputs.size(); ++i)
+  {
+    auto active = _processAdapter ? _processAdapter->isAudioBusActive(Vst::kInput, i)
+                                  : audioInputs[i]->isActive();
+    _plugin->setAudioPortActive(true, i, active, _use64bit ? 64 : 32);
+  }
+  for (auto i = 0U; i < audioOutputs.size(); ++i)
+  {
+    auto active = _processAdapter ? _processAdapter->isAudioBusActive(Vst::kOutput, i)
+                                  : audioOutputs[i]->isActive();
+    _plugin->setAudioPortActive(false, i, active, _use64bit ? 64 : 32);
+  }
+}
+
 static std::vector<std::string> split(const std::string& s, char delimiter)
 {
   std::vector<std::string> tokens;
@@ -667,6 +745,22 @@ void ClapAsVst3::setupWrapperSpecifics(const clap_plugin_t* plugin)
     _numMidiChannels = _vst3specifics->getNumMIDIChannels(_plugin->_plugin, 0);
     _expressionmap = _vst3specifics->supportedNoteExpressions(_plugin->_plugin);
   }
+
+  // by default the host is asked for everything the ProcessAdapter translates to the clap transport
+  _processContextRequirements =
+      Vst::IProcessContextRequirements::kNeedContinousTimeSamples |
+      Vst::IProcessContextRequirements::kNeedProjectTimeMusic |
+      Vst::IProcessContextRequirements::kNeedBarPositionMusic |
+      Vst::IProcessContextRequirements::kNeedCycleMusic | Vst::IProcessContextRequirements::kNeedTempo |
+      Vst::IProcessContextRequirements::kNeedTimeSignature |
+      Vst::IProcessContextRequirements::kNeedTransportState;
+
+  auto contextspecifics = (clap_plugin_process_context_as_vst3_t*)plugin->get_extension(
+      plugin, CLAP_PLUGIN_PROCESS_CONTEXT_AS_VST3);
+  if (contextspecifics && contextspecifics->getProcessContextRequirements)
+  {
+    _processContextRequirements = contextspecifics->getProcessContextRequirements(plugin);
+  }
 }
 
 bool ClapAsVst3::checkMIDIDialectSupport()
@@ -700,6 +794,8 @@ void ClapAsVst3::setupAudioBusses(const clap_plugin_t* plugin,
 
   fprintf(stderr, "\tAUDIO in: %d, out: %d\n", (int)numAudioInputs, (int)numAudioOutputs);
 
+  _supports64bit = (numAudioInputs + numAudioOutputs) > 0;
+
   for (decltype(numAudioInputs) i = 0; i < numAudioInputs; ++i)
   {
     clap_audio_port_info_t info;
@@ -1034,8 +1130,7 @@ bool ClapAsVst3::register_timer(uint32_t period_ms, clap_id* timer_id)
       // pass the id to the plugin
       *timer_id = to.timer_id;
 #if LIN
-      to.handler.reset();
-      attachTimers(_iRunLoop);
+      if (_dispatcher) _dispatcher->addTimer(this, to.timer_id, to.period);
 #endif
       return true;
     }
@@ -1046,7 +1141,7 @@ bool ClapAsVst3::register_timer(uint32_t period_ms, clap_id* timer_id)
   *timer_id = newid;
   _timersObjects.push_back(f);
 #if LIN
-  attachTimers(_iRunLoop);
+  if (_dispatcher) _dispatcher->addTimer(this, newid, period_ms);
 #endif
 
   return true;
@@ -1060,11 +1155,7 @@ bool ClapAsVst3::unregister_timer(clap_id timer_id)
       to.period = 0;
       to.nexttick = 0;
 #if LIN
-      if (to.handler && _iRunLoop)
-      {
-        _iRunLoop->unregisterTimer(to.handler.get());
-      }
-      to.handler.reset();
+      if (_dispatcher) _dispatcher->removeTimer(this, timer_id);
 #endif
       return true;
     }
@@ -1155,61 +1246,24 @@ void ClapAsVst3::onIdle()
 }
 
 #if LIN
-struct TimerHandler : Steinberg::Linux::ITimerHandler, public Steinberg::FObject
-{
-  ClapAsVst3* _parent{nullptr};
-  clap_id _timerId{0};
-  TimerHandler(ClapAsVst3* parent, clap_id timerId) : _parent(parent), _timerId(timerId)
-  {
-  }
-  void PLUGIN_API onTimer() final
-  {
-    _parent->fireTimer(_timerId);
-  }
-  DELEGATE_REFCOUNT(Steinberg::FObject)
-  DEFINE_INTERFACES
-  DEF_INTERFACE(Steinberg::Linux::ITimerHandler)
-  END_DEFINE_INTERFACES(Steinberg::FObject)
-};
-
-struct IdleHandler : Steinberg::Linux::ITimerHandler, public Steinberg::FObject
-{
-  ClapAsVst3* _parent{nullptr};
-  IdleHandler(ClapAsVst3* parent) : _parent(parent)
-  {
-  }
-  void PLUGIN_API onTimer() final
-  {
-    _parent->onIdle();
-  }
-  DELEGATE_REFCOUNT(Steinberg::FObject)
-  DEFINE_INTERFACES
-  DEF_INTERFACE(Steinberg::Linux::ITimerHandler)
-  END_DEFINE_INTERFACES(Steinberg::FObject)
-};
-
 void ClapAsVst3::attachTimers(Steinberg::Linux::IRunLoop* r)
 {
   if (r)
   {
     _iRunLoop = r;
 
-    if (_idleHandler)
+    if (_dispatcher)
     {
-      _iRunLoop->unregisterTimer(_idleHandler.get());
+      _dispatcher->detach(this);
     }
-    else
-    {
-      _idleHandler = Steinberg::owned(new IdleHandler(this));
-    }
-    _iRunLoop->registerTimer(_idleHandler.get(), 30);
+    _dispatcher = RunLoopDispatcher::forRunLoop(r);
+    _dispatcher->attach(this);
 
     for (auto& t : _timersObjects)
     {
-      if (!t.handler)
+      if (t.period > 0)
       {
-        t.handler = Steinberg::owned(new TimerHandler(this, t.timer_id));
-        _iRunLoop->registerTimer(t.handler.get(), t.period);
+        _dispatcher->addTimer(this, t.timer_id, t.period);
       }
     }
   }
@@ -1217,24 +1271,18 @@ void ClapAsVst3::attachTimers(Steinberg::Linux::IRunLoop* r)
 
 void ClapAsVst3::detachTimers(Steinberg::Linux::IRunLoop* r)
 {
-  if (r && r == _iRunLoop)
+  if (r && r == _iRunLoop && _dispatcher)
   {
-    if (_idleHandler)
-    {
-      _iRunLoop->unregisterTimer(_idleHandler.get());
-      _idleHandler.reset();
-    }
-    for (auto& t : _timersObjects)
-    {
-      if (t.handler)
-      {
-        _iRunLoop->unregisterTimer(t.handler.get());
-        t.handler.reset();
-      }
-    }
+    _dispatcher->detach(this);
+    _dispatcher.reset();
   }
 }
 
+bool ClapAsVst3::hasIdleWork()
+{
+  return !_queueToUI.empty() || _requestedFlush || _requestUICallback;
+}
+
 void ClapAsVst3::fireTimer(clap_id timer_id)
 {
   _plugin->_ext._timer->on_timer(_plugin->_plugin, timer_id);
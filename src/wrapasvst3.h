@@ -32,6 +32,9 @@
 
 #include "detail/os/osutil.h"
 #include "detail/vst3/plugview.h"
+#if LIN
+#include "detail/vst3/runloop_dispatcher.h"
+#endif
 #include "detail/clap/automation.h"
 #include "detail/shared/fixedqueue.h"
 #include "detail/ara/ara.h"
@@ -112,10 +115,14 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
                    public Steinberg::Vst::IMidiMapping,
                    public Steinberg::Vst::INoteExpressionController,
                    public Steinberg::Vst::IContextMenuTarget,
+                   public Steinberg::Vst::IProcessContextRequirements,
                    public ARA::IPlugInEntryPoint,
                    public ARA::IPlugInEntryPoint2,
                    public Clap::IHost,
                    public Clap::IAutomation,
+#if LIN
+                   public RunLoopDispatcher::Client,
+#endif
                    public os::IPlugObject
 {
  public:
@@ -212,6 +219,9 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
   //---IContextMenuTarget ----------------------------------------------------------------
   tresult PLUGIN_API executeMenuItem(int32 tag) override;
 
+  //---IProcessContextRequirements--------------------------------------------------------
+  uint32 PLUGIN_API getProcessContextRequirements() override;
+
   //----from ARA::IPlugInEntryPoint
   ARAFactoryPtr PLUGIN_API getFactory() override;
   ARAPlugInExtensionInstancePtr PLUGIN_API
@@ -263,6 +273,7 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
   //}
 
   DEF_INTERFACE(INoteExpressionController)
+  DEF_INTERFACE(IProcessContextRequirements)
   // tresult PLUGIN_API queryInterface(const TUID iid, void** obj) override;
   END_DEFINE_INTERFACES(SingleComponentEffect)
   REFCOUNT_METHODS(SingleComponentEffect);
@@ -343,6 +354,7 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
   void addAudioBusFrom(const clap_audio_port_info_t* info, bool is_input);
   void addMIDIBusFrom(const clap_note_port_info_t* info, uint32_t index, bool is_input);
   void updateAudioBusses();
+  void syncAudioPortsActivation();
 
   Vst::UnitID getOrCreateUnitInfo(const char* modulename);
   std::map<std::string, Vst::UnitID> _moduleToUnit;
@@ -365,6 +377,10 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
   std::atomic_bool _requestUICallback = false;
   bool _missedLatencyRequest = false;
 
+  // for audio-ports-activation
+  std::atomic_bool _requestedAudioPortsActivation = false;
+  bool _canActivateAudioPortsWhileProcessing = false;
+
   // the queue from audiothread to UI thread
   ClapWrapper::detail::shared::fixedqueue<queueEvent, 8192> _queueToUI;
 
@@ -374,7 +390,10 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
       {};  // 16 MappingIDs for 16 Channels
   bool _IMidiMappingEasy = true;
   uint8_t _numMidiChannels = 16;
+  uint32_t _processContextRequirements = 0;
   uint32_t _largestBlocksize = 0;
+  bool _supports64bit = false;
+  bool _use64bit = false;
 
   // for timer
   struct TimerObject
@@ -382,14 +401,12 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
     uint32_t period = 0;  // if period is 0 the entry is unused (and can be reused)
     uint64_t nexttick = 0;
     clap_id timer_id = 0;
-#if LIN
-    Steinberg::IPtr<Steinberg::Linux::ITimerHandler> handler = nullptr;
-#endif
   };
   std::vector<TimerObject> _timersObjects;
 
 #if LIN
-  Steinberg::IPtr<Steinberg::Linux::ITimerHandler> _idleHandler;
+  // drives the idle work and the timers while there is a run loop
+  std::shared_ptr<RunLoopDispatcher> _dispatcher;
 
   void attachTimers(Steinberg::Linux::IRunLoop*);
   void detachTimers(Steinberg::Linux::IRunLoop*);
@@ -414,7 +431,13 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
 #endif
 
  public:
+#if LIN
+  // from RunLoopDispatcher::Client
+  bool hasIdleWork() override;
+  void fireTimer(clap_id timer_id) override;
+#else
   void fireTimer(clap_id timer_id);
+#endif
   void firePosixFDIsSet(int fd, clap_posix_fd_flags_t flags);
 
  private:
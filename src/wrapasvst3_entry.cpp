@@ -18,6 +18,14 @@
                 {any VST3 Folder}/mevendor/myplugin.vst3 to match {any CLAP folder}/mevendor/myplugin.clap
          c) checks all subfolders in the CLAP folders for a matching .clap.
 
+    The path found in 2) is kept in the discovery cache (see fsutil.h), later scans load it
+    directly while the .clap is unchanged and only search again on a miss.
+
+    Once the CLAP has been loaded the classes of the factory are kept in a snapshot (see
+    classinfo.h). While neither this binary nor the .clap change, the factory is created from
+    the snapshot and the CLAP is only loaded and initialized when the first instance is created,
+    so a host scanning many wrappers doesn't initialize every CLAP.
+
     Valid CLAP search paths are also documented in clap/include/clap/entry.h:
 
     // CLAP plugins standard search path:
@@ -44,10 +52,11 @@
 
 */
 
-#include "detail/shared/sha1.h"
 #include "wrapasvst3.h"
 #include "public.sdk/source/main/pluginfactory.h"
 #include <array>
+#include <memory>
+#include <mutex>
 
 using namespace Steinberg::Vst;
 
@@ -59,17 +68,47 @@ using namespace Steinberg::Vst;
 //------------------------------------------------------------------------
 
 #include "detail/clap/fsutil.h"
-#include "detail/vst3/categories.h"
+#include "detail/shared/sha1.h"
+#include "detail/vst3/classinfo.h"
 #include "clap_proxy.h"
 
+/*
+    The CLAP behind the factory. With a current snapshot the factory registers its classes
+    without it, and it is only loaded and initialized when the host creates the first instance.
+*/
+class ClapBinding
+{
+ public:
+  // the CLAP the snapshot names, which is tried before the search
+  void setKnownPath(const fs::path& path)
+  {
+    _knownPath = path;
+  }
+  // loads the CLAP on the first call, null if there is no usable one
+  Clap::Library* get();
+  // empty if this binary contains the CLAP
+  const fs::path& path() const
+  {
+    return _path;
+  }
+
+ private:
+  void bind();
+
+  std::once_flag _once;
+  std::unique_ptr<Clap::Library> _lib;
+  fs::path _knownPath, _path;
+};
+
 struct CreationContext
 {
-  Clap::Library* lib = nullptr;
+  ClapBinding* binding = nullptr;
   int index = 0;
   PClassInfo2 classinfo;
 };
 
-bool findPlugin(Clap::Library& lib, const std::string& pluginfilename)
+static bool findPluginInSearchPaths(Clap::Library& lib, const std::string& pluginfilename,
+                                    fs::path& found)
 {
   auto parentfolder = os::getParentFolderName();
   auto paths = Clap::getValidCLAPSearchPaths();
@@ -86,6 +125,7 @@ bool findPlugin(Clap::Library& lib, const std::string& pluginfilename)
     {
       if (lib.load(k1))
       {
+        found = k1;
         return true;
       }
     }
@@ -97,6 +137,7 @@ bool findPlugin(Clap::Library& lib, const std::string& pluginfilename)
     {
       if (lib.load(k2))
       {
+        found = k2;
         return true;
       }
     }
@@ -110,6 +151,7 @@ bool findPlugin(Clap::Library& lib, const std::string& pluginfilename)
       {
         if (lib.load(k3))
         {
+          found = k3;
           return true;
         }
       }
@@ -119,213 +161,180 @@ bool findPlugin(Clap::Library& lib, const std::string& pluginfilename)
   return false;
 }
 
-IPluginFactory* GetPluginFactoryEntryPoint()
+bool findPlugin(Clap::Library& lib, const std::string& pluginfilename, fs::path& found)
 {
-#if _DEBUG
-  // MessageBoxA(NULL,"halt","me",MB_OK); // <- enable this on Windows to get a debug attachment to vstscanner.exe (subprocess of cbse)
-#endif
-
-#if SMTG_OS_WINDOWS
-// #pragma comment(linker, "/EXPORT:" __FUNCTION__ "=" __FUNCDNAME__)
-#endif
-
-  // static IPtr<Steinberg::CPluginFactory> gPluginFactory = nullptr;
-  static Clap::Library gClapLibrary;
+  // strategy 2 depends on the folder of this binary, so the cache key does as well
+  auto key = os::getParentFolderName() + "/" + pluginfilename;
+  if (auto cached = Clap::lookupDiscoveryCache(key))
+  {
+    LOGDETAIL("cached binary: {}", cached->u8string().c_str());
+    if (lib.load(*cached))
+    {
+      found = *cached;
+      return true;
+    }
+  }
 
-  static std::vector<std::shared_ptr<CreationContext>> gCreationContexts;
+  if (!findPluginInSearchPaths(lib, pluginfilename, found))
+  {
+    return false;
+  }
+  Clap::storeDiscoveryCache(key, found);
+  return true;
+}
 
-  // if there is no ClapLibrary yet
-  if (!gClapLibrary._pluginFactory)
+void ClapBinding::bind()
+{
+  // the library checks this binary for an entry point itself
+  auto lib = std::make_unique<Clap::Library>();
+  if (!lib->hasEntryPoint())
   {
-    // if this binary does not already contain a CLAP entrypoint
-    if (!gClapLibrary.hasEntryPoint())
-    {
-      // try to find a clap which filename stem matches our own
-      auto kx = os::getParentFolderName();
-      auto plugname = os::getBinaryName();
-      plugname.append(".clap");
+    // try to find a clap which filename stem matches our own
+    auto plugname = os::getBinaryName();
+    plugname.append(".clap");
 
-      if (!findPlugin(gClapLibrary, plugname))
-      {
-        return nullptr;
-      }
+    if (!_knownPath.empty() && lib->load(_knownPath))
+    {
+      _path = _knownPath;
     }
-    else
+    else if (!findPlugin(*lib, plugname, _path))
     {
-      LOGDETAIL("detected entrypoint in this binary");
+      return;
     }
   }
-  if (gClapLibrary.plugins.empty())
+  else
+  {
+    LOGDETAIL("detected entrypoint in this binary");
+  }
+
+  if (lib->plugins.empty())
   {
     // with no plugins there is nothing to do..
     LOGINFO("no plugin has been found");
-    return nullptr;
+    return;
   }
-
-  if (!clap_version_is_compatible(gClapLibrary.plugins[0]->clap_version))
+  if (!clap_version_is_compatible(lib->plugins[0]->clap_version))
   {
     // CLAP version is not compatible -> eject
     LOGINFO("CLAP version is not compatible");
-    return nullptr;
+    return;
   }
+  _lib = std::move(lib);
+}
 
-  if (!gPluginFactory)
-  {
-    // we need at least one plugin to obtain vendor/name etc.
-    auto* factoryvendor = gClapLibrary.plugins[0]->vendor;
-    auto* vendor_url = gClapLibrary.plugins[0]->url;
-    // TODO: extract the domain and prefix with info@
-    auto* contact = "info@";
-
-    // override for VST3 specifics
-    if (gClapLibrary._pluginFactoryVst3Info)
-    {
-      LOGDETAIL("detected extension `{}`", CLAP_PLUGIN_FACTORY_INFO_VST3);
-      auto& v3 = gClapLibrary._pluginFactoryVst3Info;
-      if (v3->vendor) factoryvendor = v3->vendor;
-      if (v3->vendor_url) vendor_url = v3->vendor_url;
-      if (v3->email_contact) contact = v3->email_contact;
-    }
-
-    static PFactoryInfo factoryInfo(factoryvendor, vendor_url, contact, Vst::kDefaultFactoryFlags);
-
-    LOGDETAIL("created factory for vendor '{}'", factoryvendor);
+Clap::Library* ClapBinding::get()
+{
+  std::call_once(_once, [this]() { bind(); });
+  return _lib.get();
+}
 
-    gPluginFactory = new Steinberg::CPluginFactory(factoryInfo);
-    // resize the classInfo vector
-    gCreationContexts.clear();
-    gCreationContexts.reserve(gClapLibrary.plugins.size());
-    int numPlugins = static_cast<int>(gClapLibrary.plugins.size());
-    LOGDETAIL("number of plugins in factory: {}", numPlugins);
-    for (int ctr = 0; ctr < numPlugins; ++ctr)
-    {
-      auto& clapdescr = gClapLibrary.plugins[ctr];
-      auto vst3info = gClapLibrary.get_vst3_info(ctr);
+// the snapshot of this wrapper, named after the hash of its path
+static fs::path getSnapshotFile(const fs::path& modulePath)
+{
+  auto folder = Clap::getCacheFolder();
+  if (folder.empty() || modulePath.empty()) return {};
+  auto p = modulePath.u8string();
+  auto hash = Crypto::sha1(p.c_str(), p.size());
+  std::string name;
+  constexpr char hexchar[] = "0123456789abcdef";
+  for (auto b : hash.bytes)
+  {
+    name.push_back(hexchar[(b >> 4) & 0xF]);
+    name.push_back(hexchar[b & 0xF]);
+  }
+  return folder / "vst3" / (name + ".classes");
+}
 
-      LOGDETAIL("  plugin #{}: '{}'", ctr, clapdescr->name);
+static bool isCurrent(const Vst3FactorySnapshot& snapshot, const fs::path& modulePath)
+{
+  if (snapshot.wrapperStamp == 0 || snapshot.wrapperStamp != Clap::getCacheStamp(modulePath))
+  {
+    return false;
+  }
+  return snapshot.clapPath.empty() || snapshot.clapStamp == Clap::getCacheStamp(snapshot.clapPath);
+}
 
-      std::string n(clapdescr->name);
+IPluginFactory* GetPluginFactoryEntryPoint()
+{
+#if _DEBUG
+  // MessageBoxA(NULL,"halt","me",MB_OK); // <- enable this on Windows to get a debug attachment to vstscanner.exe (subprocess of cbse)
+#endif
 
-#ifdef _DEBUG
-      n.append(" (CLAP->VST3)");
+#if SMTG_OS_WINDOWS
+// #pragma comment(linker, "/EXPORT:" __FUNCTION__ "=" __FUNCDNAME__)
 #endif
-      auto plugname = n.c_str();  //  clapdescr->name;
 
-      // get vendor -------------------------------------
-      auto pluginvendor = clapdescr->vendor;
-      if (pluginvendor == nullptr || *pluginvendor == 0) pluginvendor = "Unspecified Vendor";
-      if (vst3info && vst3info->vendor)
-      {
-        LOGDETAIL("  plugin supports extension '{}'", CLAP_PLUGIN_AS_VST3);
-        pluginvendor = vst3info->vendor;
-      }
+  // static IPtr<Steinberg::CPluginFactory> gPluginFactory = nullptr;
+  static ClapBinding gClapBinding;
 
-      TUID lcid;
-      Crypto::uuid_object g;
+  static std::vector<std::shared_ptr<CreationContext>> gCreationContexts;
 
+  if (!gPluginFactory)
+  {
 #ifdef CLAP_VST3_TUID_STRING
-      Steinberg::FUID f;
-      if (f.fromString(CLAP_VST3_TUID_STRING))
-      {
-        memcpy(&g, f.toTUID(), sizeof(TUID));
-        memcpy(&lcid, &g, sizeof(TUID));
-      }
-      else
+    const char* tuidOverride = CLAP_VST3_TUID_STRING;
+#else
+    const char* tuidOverride = nullptr;
 #endif
+    // a host scanning the wrapper only needs the classes, which the snapshot has
+    auto modulePath = fs::u8path(os::getModulePath());
+    auto snapshotFile = getSnapshotFile(modulePath);
+    Vst3FactorySnapshot snapshot;
+    Vst3FactoryDescription description;
+    if (!snapshotFile.empty() && readVst3Snapshot(snapshotFile, snapshot) &&
+        isCurrent(snapshot, modulePath))
+    {
+      LOGDETAIL("registering classes from snapshot {}", snapshotFile.u8string());
+      gClapBinding.setKnownPath(snapshot.clapPath);
+      description = std::move(snapshot.description);
+    }
+    else
+    {
+      auto* lib = gClapBinding.get();
+      if (!lib)
       {
-        // make id or take it from vst3 info --------------
-        std::string id(clapdescr->id);
-        if (vst3info && vst3info->componentId)
-        {
-          memcpy(&g, vst3info->componentId, sizeof(g));
-        }
-        else
-        {
-          g = Crypto::create_sha1_guid_from_name(id.c_str(), id.size());
-        }
-
-        memcpy(&lcid, &g, sizeof(TUID));
-      }
-
-      // features ----------------------------------------
-      std::string features;
-      if (vst3info && vst3info->features)
-      {
-        features = vst3info->features;
+        return nullptr;
       }
-      else
+      if (lib->_pluginFactoryVst3Info)
       {
-        features = clapCategoriesToVST3(clapdescr->features);
+        LOGDETAIL("detected extension `{}`", CLAP_PLUGIN_FACTORY_INFO_VST3);
       }
+      description = describeVst3Factory(*lib, tuidOverride);
 
-#if CLAP_WRAPPER_LOGLEVEL > 1
+      if (!snapshotFile.empty())
       {
-        const auto* v = reinterpret_cast<const uint8_t*>(&g);
-        char x[sizeof(g) * 2 + 8];
-        char* o = x;
-        constexpr char hexchar[] = "0123456789ABCDEF";
-        for (auto i = 0U; i < sizeof(g); i++)
-        {
-          auto n = v[i];
-          *o++ = hexchar[(n >> 4) & 0xF];
-          *o++ = hexchar[n & 0xF];
-          if (!(i % 4)) *o++ = 32;
-        }
-        *o++ = 0;
-        LOGDETAIL("plugin id: {} -> {}", clapdescr->id, x);
+        snapshot.wrapperStamp = Clap::getCacheStamp(modulePath);
+        snapshot.clapPath = gClapBinding.path();
+        snapshot.clapStamp = snapshot.clapPath.empty() ? 0 : Clap::getCacheStamp(snapshot.clapPath);
+        snapshot.description = description;
+        writeVst3Snapshot(snapshotFile, snapshot);
       }
-#endif
+    }
+
+    static PFactoryInfo factoryInfo(description.vendor.c_str(), description.url.c_str(),
+                                    description.email.c_str(), Vst::kDefaultFactoryFlags);
+
+    LOGDETAIL("created factory for vendor '{}'", description.vendor);
+
+    gPluginFactory = new Steinberg::CPluginFactory(factoryInfo);
+    // resize the classInfo vector
+    gCreationContexts.clear();
+    gCreationContexts.reserve(description.classes.size());
+    LOGDETAIL("number of classes in factory: {}", description.classes.size());
+    for (auto& c : description.classes)
+    {
+      LOGDETAIL("  {} #{}: '{}' id {}", c.category, c.index, c.name, vst3ClassIdString(c.cid));
+
+      // the only class flag is usually Vst:kDistributable, but CLAPs aren't distributable
       auto ptr = std::make_shared<CreationContext>();
-      *ptr = {&gClapLibrary, ctr,
-              PClassInfo2(
-                  lcid, PClassInfo::kManyInstances, kVstAudioEffectClass, plugname,
-                  0 /* the only flag is usually Vst:kDistributable, but CLAPs aren't distributable */,
-                  features.c_str(), pluginvendor, clapdescr->version, kVstVersionString)};
+      *ptr = {&gClapBinding, c.index,
+              PClassInfo2(c.cid, PClassInfo::kManyInstances, c.category.c_str(), c.name.c_str(), 0,
+                          c.subCategories.c_str(), c.vendor.c_str(), c.version.c_str(),
+                          kVstVersionString)};
       gCreationContexts.push_back(ptr);
       gPluginFactory->registerClass(&gCreationContexts.back()->classinfo, ClapAsVst3::createInstance,
                                     gCreationContexts.back().get());
     }
-
-    if (gClapLibrary._pluginFactoryARAInfo)
-    {
-      LOGINFO("creating ARA companion factories");
-      auto factory = gClapLibrary._pluginFactoryARAInfo;
-      auto count = factory->get_factory_count(factory);
-      for (decltype(count) i = 0; i < count; ++i)
-      {
-        auto matching_plugin = factory->get_plugin_id(factory, i);
-        LOGDETAIL("number of ARA plugins: {}", numPlugins);
-        for (int ctr = 0; ctr < numPlugins; ++ctr)
-        {
-          auto& clapdescr = gClapLibrary.plugins[ctr];
-          if (!strcmp(clapdescr->id, matching_plugin))
-          {
-            std::string extended_id(matching_plugin);
-            extended_id.append("-ARA");
-            auto g = Crypto::create_sha1_guid_from_name(extended_id.c_str(), extended_id.size());
-            TUID lcid;
-            memcpy(&lcid, &g, sizeof(TUID));
-
-            std::string n(clapdescr->name);
-#ifdef _DEBUG
-            n.append(" (CLAP->VST3)");
-#endif
-            auto plugname = n.c_str();  //  clapdescr->name;
-            auto ptr = std::make_shared<CreationContext>();
-            *ptr = {&gClapLibrary, (int)i,
-                    PClassInfo2(lcid, PClassInfo::kManyInstances, kARAMainFactoryClass, plugname, 0,
-                                "", /* not used in this context */
-                                "", /* not used in this context */
-                                clapdescr->version, kVstVersionString)};
-            gCreationContexts.push_back(ptr);
-            gPluginFactory->registerClass(&gCreationContexts.back()->classinfo,
-                                          ClapAsVst3::createInstance, gCreationContexts.back().get());
-
-            break;
-          }
-        }
-      }
-    }
   }
   else
     gPluginFactory->addRef();
@@ -368,23 +377,30 @@ DEF_CLASS_IID(ARA::IMainFactory)
 FUnknown* ClapAsVst3::createInstance(void* context)
 {
   auto ctx = static_cast<CreationContext*>(context);
+  // with a factory from the snapshot the CLAP is loaded here, for the first instance
+  auto lib = ctx->binding->get();
+  if (!lib)
+  {
+    LOGINFO("no CLAP for {}", ctx->classinfo.name);
+    return nullptr;
+  }
 
   if (!strcmp(ctx->classinfo.category, kVstAudioEffectClass))
   {
     LOGINFO("creating plugin {} (#{})", ctx->classinfo.name, ctx->index);
-    if (ctx->lib->hasEntryPoint())
+    if (lib->hasEntryPoint() && ctx->index < (int)lib->plugins.size())
     {
       // MessageBoxA(NULL, "create ClapAsVst3", "create", MB_OK);
-      return (IAudioProcessor*)new ClapAsVst3(ctx->lib, ctx->index, context);
+      return (IAudioProcessor*)new ClapAsVst3(lib, ctx->index, context);
     }
   }
 
   if (!strcmp(ctx->classinfo.category, kARAMainFactoryClass))
   {
     LOGINFO("creating ARAMainFactory {} (#{})", ctx->classinfo.name, ctx->index);
-    if (ctx->lib->hasEntryPoint())
+    if (lib->hasEntryPoint() && lib->_pluginFactoryARAInfo)
     {
-      const auto ara_factory = ctx->lib->_pluginFactoryARAInfo;
+      const auto ara_factory = lib->_pluginFactoryARAInfo;
       return static_cast<FUnknown*>(new ARAMainFactory(
           ara_factory->get_ara_factory(ara_factory, ctx->index), Steinberg::FUID(ctx->classinfo.cid)));
     }